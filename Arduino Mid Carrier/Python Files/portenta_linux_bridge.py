@@ -4,10 +4,11 @@ import serial
 import os
 import threading
 import copy  # Needed for deep copying templates
-from msgpackrpc import Address as RpcAddress, Client as RpcClient, error as RpcError
+from msgpackrpc import Address as RpcAddress, Client as RpcClient, Server as RpcServer, error as RpcError
 import socket
 import hashlib
 import struct
+import zlib
 import csv
 from dataclasses import dataclass
 from threading import Timer
@@ -35,7 +36,7 @@ os.makedirs(os.path.dirname(LOG_FILE_PATH), exist_ok=True)
 log_file = open(LOG_FILE_PATH, "a", newline="", buffering=1)  # line-buffered
 csv_writer = csv.writer(log_file)
 if log_file.tell() == 0:
-    csv_writer.writerow(["time_ms", "set_current", "duty"])
+    csv_writer.writerow(["time_ms", "set_current", "duty", "error"])
 print(f"[LOG] Writing CSV to: {LOG_FILE_PATH}")
 
 # Store latest RPC results by name (e.g. "rpc_result_volt_set" -> value)
@@ -279,6 +280,452 @@ def poll_m4_signals_temp():
         update_and_broadcast("internal_temperature", round(temp, 2), src="rpc")
         
 
+# get_telemetry wire format (version 1, little-endian):
+#   u8 version, u8 size, u16 flags, u32 seq, u64 timestamp_us,
+#   f32 volt_act, f32 curr_act, f32 volt_set, f32 curr_set, f32 temperature
+TELEMETRY_FMT = "<BBHIQfffff"
+TELEMETRY_SIZE = struct.calcsize(TELEMETRY_FMT)
+LAST_TELEMETRY_SEQ = None
+LAST_TELEMETRY_FLAGS = None
+TLM_FLAG_FAST_TRIP = 1 << 11
+TLM_FLAG_WAVE_REJECTED = 1 << 12  # Newest waveform upload rejected, old profile armed
+TLM_FLAG_SIGNALS = {  # Flag bit -> signal, for the bits the bridge mirrors
+    0: "extern_enable", 1: "igbt_fault", 2: "scr_trig", 3: "scr_inhib", 4: "run_current_wave",
+}
+TRIP_REASONS = {0x1: "hw_overvoltage", 0x2: "hw_overcurrent", 0x4: "sw_overvoltage"}
+LAST_FAST_TRIP = False
+LAST_WAVE_REJECTED = False
+
+
+def report_fast_trip() -> None:
+    """Log the latched M4 trip reasons (cleared with the trip_clear RPC)."""
+    bits = call_m4_rpc("trip_status", retries=0, timeout=0.5)
+    if not isinstance(bits, int):
+        return
+    reasons = [name for bit, name in TRIP_REASONS.items() if bits & bit] or [hex(bits)]
+    print(f"[Trip] M4 fast trip latched: {', '.join(reasons)}")
+
+
+def apply_telemetry_frame(blob, edges: int = 0) -> bool:
+    """
+    Publish one telemetry frame (get_telemetry / m4_notify wire format).
+    `edges` are flag bits the M4 saw change since its previous notification;
+    a bit that changed and came back is broadcast as a pulse so the display
+    still sees it. Returns False if the blob is not a version-1 frame.
+    """
+    global LAST_TELEMETRY_SEQ, LAST_TELEMETRY_FLAGS, LAST_FAST_TRIP, LAST_WAVE_REJECTED
+    if not isinstance(blob, (bytes, bytearray)) or len(blob) < TELEMETRY_SIZE:
+        return False
+
+    (version, size, flags, seq, t_us,
+     volt, curr, volt_set, curr_set, temp) = struct.unpack_from(TELEMETRY_FMT, blob)
+    if version != 1 or size < TELEMETRY_SIZE:
+        return False
+
+    with DATA_LOCK:
+        if seq == LAST_TELEMETRY_SEQ:
+            return True  # No new control tick since the last frame
+        LAST_TELEMETRY_SEQ = seq
+        prev_flags = LAST_TELEMETRY_FLAGS
+        LAST_TELEMETRY_FLAGS = flags
+
+    tripped = bool(flags & TLM_FLAG_FAST_TRIP)
+    if tripped and not LAST_FAST_TRIP:
+        report_fast_trip()
+    LAST_FAST_TRIP = tripped
+
+    rejected = bool(flags & TLM_FLAG_WAVE_REJECTED)
+    if rejected != LAST_WAVE_REJECTED:
+        print("[Wave] M4 rejected the newest waveform; the previous profile stays armed"
+              if rejected else "[Wave] M4 accepted the waveform")
+    LAST_WAVE_REJECTED = rejected
+
+    if prev_flags is not None:
+        pulsed = edges & ~(flags ^ prev_flags)
+        for bit, name in TLM_FLAG_SIGNALS.items():
+            if pulsed & (1 << bit):
+                print(f"[Notify] {name} pulsed between notifications")
+                update_and_broadcast(name, int(((flags >> bit) & 0x1) ^ 1), src="rpc")
+
+    ext_en = (flags >> 0) & 0x1
+    for bit, name in TLM_FLAG_SIGNALS.items():
+        update_and_broadcast(name, int((flags >> bit) & 0x1), src="rpc")
+
+    inter_val = get_signal_value("inter_enable")
+    out = 1 if inter_val and ext_en else 0
+    update_and_broadcast("output_enable", out, src="logic")
+
+    update_and_broadcast("volt_act", round(volt, 2), src="rpc")
+    update_and_broadcast("curr_act", round(curr, 2), src="rpc")
+    update_and_broadcast("internal_temperature", round(temp, 2), src="rpc")
+    return True
+
+
+def poll_m4_telemetry() -> bool:
+    """
+    Poll the coherent per-tick snapshot (all values from the same control tick).
+    Returns False when the firmware does not provide it, so the caller can
+    fall back to the legacy get_poll_data / get_poll_data_temp pair.
+    """
+    blob = call_m4_rpc("get_telemetry", retries=0, timeout=0.5)
+    return apply_telemetry_frame(blob)
+
+
+# get_pi_log record: u32 time_us, f32 curr_set, f32 error, f32 duty
+PI_LOG_FMT = "<Ifff"
+PI_LOG_SIZE = struct.calcsize(PI_LOG_FMT)
+PI_LOG_RPC_MAX = 64  # Samples per get_pi_log call (SerialComms.h)
+
+
+def poll_m4_pi_log(max_calls: int = 4) -> int:
+    """Drain the M4 current-regulator debug tap into pid_log.csv."""
+    total = 0
+    for _ in range(max_calls):
+        blob = call_m4_rpc("get_pi_log", retries=0, timeout=0.5)
+        if not isinstance(blob, (bytes, bytearray)) or len(blob) < PI_LOG_SIZE:
+            break
+        n = len(blob) // PI_LOG_SIZE
+        for t_us, set_curr, err, duty in struct.iter_unpack(PI_LOG_FMT, blob[:n * PI_LOG_SIZE]):
+            log_pid_sample(t_us // 1000, round(set_curr, 3), round(duty, 5), round(err, 3))
+        total += n
+        if n < PI_LOG_RPC_MAX:
+            break
+    return total
+
+
+# --- M4 event journal ----------------------------------------------------
+# event_log_read(cursor): u8 version, u8 record size, u16 count, u32 first
+# seq, u32 next cursor, then records of u32 seq, u32 time_us, u16 code,
+# u16 arg, f32 value, f32 volt, f32 curr. See EventLog.h.
+EVENT_HEADER_FMT = "<BBHII"
+EVENT_HEADER_SIZE = struct.calcsize(EVENT_HEADER_FMT)
+EVENT_RECORD_FMT = "<IIHHfff"
+EVENT_RECORD_SIZE = struct.calcsize(EVENT_RECORD_FMT)
+EVENT_LOG_RPC_MAX = 32  # Entries per event_log_read call (SerialComms.h)
+EVENT_NAMES = {
+    1: "hw_trip", 2: "trip_clear", 3: "sw_overvoltage", 4: "sw_overvoltage_end",
+    5: "igbt_fault", 6: "igbt_fault_end", 7: "output_enable", 8: "wave_start",
+    9: "wave_end", 10: "wave_abort", 11: "scr_fire", 12: "tick_late",
+}
+EVENT_CAUSES = {1, 3, 5}  # Reaction times are reported relative to these
+EVENT_LOG_PATH = os.getenv("EVENT_LOG_PATH", "/home/fio/portenta_linux_bridge/m4_events.csv")
+EVENT_STATE = {"cursor": 0, "cause": None, "file": None}
+
+
+def _event_log_writer():
+    if EVENT_STATE["file"] is None:
+        os.makedirs(os.path.dirname(EVENT_LOG_PATH), exist_ok=True)
+        f = open(EVENT_LOG_PATH, "a", newline="", buffering=1)
+        if f.tell() == 0:
+            csv.writer(f).writerow(["seq", "time_us", "event", "arg", "value", "volt_act",
+                                    "curr_act", "after_cause_us"])
+        EVENT_STATE["file"] = f
+    return csv.writer(EVENT_STATE["file"])
+
+
+def poll_m4_events(max_calls: int = 4) -> int:
+    """Drain the M4 event journal from the last cursor into m4_events.csv."""
+    total = 0
+    for _ in range(max_calls):
+        blob = call_m4_rpc("event_log_read", EVENT_STATE["cursor"], retries=0, timeout=0.5)
+        if not isinstance(blob, (bytes, bytearray)) or len(blob) < EVENT_HEADER_SIZE:
+            break
+        version, size, count, first, nxt = struct.unpack_from(EVENT_HEADER_FMT, blob)
+        if version != 1 or size != EVENT_RECORD_SIZE:
+            break
+        if first > EVENT_STATE["cursor"]:
+            print(f"[Event] {first - EVENT_STATE['cursor']} M4 events were overwritten before being read")
+        elif first < EVENT_STATE["cursor"]:
+            print("[Event] M4 journal restarted")
+            EVENT_STATE["cause"] = None
+
+        body = blob[EVENT_HEADER_SIZE:EVENT_HEADER_SIZE + count * EVENT_RECORD_SIZE]
+        for seq, t_us, code, arg, value, volt, curr in struct.iter_unpack(EVENT_RECORD_FMT, body):
+            name = EVENT_NAMES.get(code, f"0x{code:X}")
+            cause = EVENT_STATE["cause"]
+            after = (t_us - cause[1]) & 0xFFFFFFFF if cause else None
+            if code in EVENT_CAUSES:
+                EVENT_STATE["cause"] = (name, t_us)
+            suffix = f" (+{after} us after {cause[0]})" if after is not None and after < 1_000_000 else ""
+            print(f"[Event] #{seq} {name} arg=0x{arg:X} value={value:.2f} "
+                  f"V={volt:.1f} I={curr:.1f}{suffix}")
+            with LOG_LOCK:
+                _event_log_writer().writerow([seq, t_us, name, arg, round(value, 3), round(volt, 2),
+                                              round(curr, 2), "" if after is None else after])
+        EVENT_STATE["cursor"] = nxt
+        total += count
+        if count < EVENT_LOG_RPC_MAX:
+            break
+    return total
+
+
+# --- On-device scope -----------------------------------------------------
+# scope_status: u8 version, u8 state, u8 record size, u8 trigger that fired,
+# u32 capture, u16 pre, u16 post, u16 decimation, u16 reserved, u32 rate_hz,
+# u64 trigger_us. scope_read record: f32 volt, f32 curr, f32 curr_set,
+# u16 duty (65535 = 100 %), u16 flags (TLM_FLAG_*). See Scope.h.
+SCOPE_STATUS_FMT = "<BBBBIHHHHIQ"
+SCOPE_STATUS_SIZE = struct.calcsize(SCOPE_STATUS_FMT)
+SCOPE_RECORD_FMT = "<fffHH"
+SCOPE_RECORD_SIZE = struct.calcsize(SCOPE_RECORD_FMT)
+SCOPE_FROZEN = 3
+SCOPE_TRIGGERS = {"run_wave": 0x1, "igbt_fault": 0x2, "fast_trip": 0x4, "manual": 0x8}
+SCOPE_DIR = os.getenv("SCOPE_DIR", "/home/fio/portenta_linux_bridge/scope")
+SCOPE_PAGE_SAMPLES = 128   # Records per "scope_data" datagram to the web clients
+SCOPE_STATE = {"cfg": {}, "capture": None, "worker": None}
+
+
+def read_m4_scope_status():
+    """Decoded scope_status as a dict, or None if the M4 has no scope."""
+    blob = call_m4_rpc("scope_status", retries=0, timeout=0.5)
+    if not isinstance(blob, (bytes, bytearray)) or len(blob) < SCOPE_STATUS_SIZE:
+        return None
+    (version, state, size, fired, capture, pre, post,
+     decimation, _, rate_hz, trigger_us) = struct.unpack_from(SCOPE_STATUS_FMT, blob)
+    if version != 1 or size != SCOPE_RECORD_SIZE:
+        return None
+    return {"state": state, "trigger": fired, "capture": capture, "pre": pre, "post": post,
+            "decimation": decimation, "rate_hz": rate_hz, "trigger_us": trigger_us}
+
+
+def arm_m4_scope() -> bool:
+    """(Re-)arm the M4 scope with the "m4_scope" settings of config.json."""
+    cfg = SCOPE_STATE["cfg"]
+    mask = 0
+    for name in cfg.get("triggers", list(SCOPE_TRIGGERS)):
+        mask |= SCOPE_TRIGGERS.get(name, 0)
+    rc = call_m4_rpc("scope_arm", mask, int(cfg.get("pre", 512)), int(cfg.get("post", 1536)),
+                     int(cfg.get("decimation", 1)), retries=1, timeout=0.3)
+    if rc != 1:
+        print(f"[Scope] M4 rejected scope_arm ({rc}).")
+        return False
+    return True
+
+
+def trigger_m4_scope() -> bool:
+    """Manual trigger; False unless the scope is armed for it."""
+    return call_m4_rpc("scope_trigger", retries=0, timeout=0.3) == 1
+
+
+def download_m4_scope(status: dict):
+    """Records of a frozen capture, or None if it was re-armed meanwhile."""
+    total = status["pre"] + status["post"]
+    data = bytearray()
+    while len(data) < total * SCOPE_RECORD_SIZE:
+        offset = len(data) // SCOPE_RECORD_SIZE
+        blob = call_m4_rpc("scope_read", status["capture"], offset, retries=1, timeout=0.5)
+        if not isinstance(blob, (bytes, bytearray)) or len(blob) < SCOPE_RECORD_SIZE:
+            return None
+        data += blob[:len(blob) - len(blob) % SCOPE_RECORD_SIZE]
+    after = read_m4_scope_status()
+    if not after or after["capture"] != status["capture"] or after["state"] != SCOPE_FROZEN:
+        return None
+    return list(struct.iter_unpack(SCOPE_RECORD_FMT, bytes(data[:total * SCOPE_RECORD_SIZE])))
+
+
+def send_m4_scope(status: dict, records, trigger, dt_ms: float) -> None:
+    """Stream a capture to the web clients as "scope_data" pages of
+    SCOPE_PAGE_SAMPLES records: measured and commanded current and the
+    measured voltage. Each page carries the capture geometry, so the
+    Client Interface can assemble it without the "scope_capture" notice."""
+    total_pages = max(1, -(-len(records) // SCOPE_PAGE_SAMPLES))
+    for page in range(total_pages):
+        chunk = records[page * SCOPE_PAGE_SAMPLES:(page + 1) * SCOPE_PAGE_SAMPLES]
+        packet = json.dumps({
+            "type": "scope_data", "capture": status["capture"], "trigger": trigger,
+            "samples": len(records), "pre": status["pre"], "dt_ms": dt_ms,
+            "page": page, "total_pages": total_pages, "offset": page * SCOPE_PAGE_SAMPLES,
+            "curr_act": [round(r[1], 1) for r in chunk],
+            "curr_set": [round(r[2], 1) for r in chunk],
+            "volt_act": [round(r[0], 1) for r in chunk],
+        }, separators=(",", ":")).encode()
+        for client in list(WEB_CLIENTS):
+            try:
+                udp_sock.sendto(packet, client)
+            except Exception as e:
+                print(f"[Scope] Failed to send capture page to {client}: {e}")
+    print(f"[Scope] Capture {status['capture']} sent to {len(WEB_CLIENTS)} clients "
+          f"in {total_pages} pages")
+
+
+def save_m4_scope(status: dict) -> None:
+    """Download a frozen M4 capture, save it to CSV, send it to the web
+    clients and re-arm. Runs in the "m4-scope" worker thread."""
+    records = download_m4_scope(status)
+    if records is None:
+        print(f"[Scope] Capture {status['capture']} changed during download; skipped.")
+        return
+    SCOPE_STATE["capture"] = status["capture"]
+
+    dt_ms = status["decimation"] * 1000.0 / status["rate_hz"]
+    trigger = [n for n, bit in SCOPE_TRIGGERS.items() if status["trigger"] & bit]
+    path = os.path.join(SCOPE_DIR, f"scope_{time.strftime('%Y%m%d_%H%M%S')}_{status['capture']}.csv")
+    os.makedirs(SCOPE_DIR, exist_ok=True)
+    with open(path, "w", newline="") as f:
+        w = csv.writer(f)
+        w.writerow(["t_ms", "volt_act", "curr_act", "curr_set", "duty", "flags"])
+        for i, (volt, curr, curr_set, duty, flags) in enumerate(records):
+            w.writerow([round((i - status["pre"]) * dt_ms, 3), round(volt, 2), round(curr, 2),
+                        round(curr_set, 2), round(duty / 65535.0, 5), flags])
+    print(f"[Scope] Capture {status['capture']} ({'+'.join(trigger) or '?'}, "
+          f"{len(records)} samples) saved to {path}")
+
+    broadcast_to_web_clients({"type": "scope_capture", "capture": status["capture"],
+                              "trigger": trigger, "file": path, "samples": len(records),
+                              "pre": status["pre"], "dt_ms": dt_ms})
+    send_m4_scope(status, records, trigger, dt_ms)
+    arm_m4_scope()
+
+
+def poll_m4_scope() -> None:
+    """Hand a newly frozen M4 capture to the download worker. A capture is
+    SCOPE_DEPTH / SCOPE_RPC_MAX scope_read calls; each takes RPC_LOCK on
+    its own, so the main loop's polls interleave with the download."""
+    if not SCOPE_STATE["cfg"].get("enabled", False):
+        return
+    worker = SCOPE_STATE["worker"]
+    if worker is not None and worker.is_alive():
+        return
+    status = read_m4_scope_status()
+    if not status or status["state"] != SCOPE_FROZEN or status["capture"] == SCOPE_STATE["capture"]:
+        return
+    worker = threading.Thread(target=save_m4_scope, args=(status,), daemon=True, name="m4-scope")
+    SCOPE_STATE["worker"] = worker
+    worker.start()
+
+
+def start_m4_scope(cfg: dict) -> bool:
+    """Arm the M4 scope at start-up if "m4_scope" enables it."""
+    SCOPE_STATE["cfg"] = cfg
+    if not cfg.get("enabled", False):
+        return False
+    return arm_m4_scope()
+
+
+# sched_jitter: u8 version, u8 bins, u16 reserved, u32 budget_ns, u32 ticks,
+# u32 latency min/max/mean ns, u32 complete_max_ns, u32 over_budget,
+# u32 missed, u32 hist[bins] (bin i: ticks entered [2^i, 2^(i+1)) ns late)
+SCHED_JITTER_VERSION = 2
+SCHED_JITTER_FMT = "<BBHIIIIIIII"
+SCHED_JITTER_SIZE = struct.calcsize(SCHED_JITTER_FMT)
+LAST_OVER_BUDGET = None
+LAST_MISSED = None
+
+
+def read_m4_jitter():
+    """Control-tick timing as a dict, or None if the M4 does not report it."""
+    blob = call_m4_rpc("sched_jitter", retries=0, timeout=0.5)
+    if not isinstance(blob, (bytes, bytearray)) or len(blob) < SCHED_JITTER_SIZE:
+        return None
+    (version, bins, _, budget, ticks, lat_min, lat_max, lat_mean,
+     complete_max, over, missed) = struct.unpack_from(SCHED_JITTER_FMT, blob)
+    if version != SCHED_JITTER_VERSION or len(blob) < SCHED_JITTER_SIZE + 4 * bins:
+        return None
+    hist = struct.unpack_from(f"<{bins}I", blob, SCHED_JITTER_SIZE)
+    return {"budget_ns": budget, "ticks": ticks, "latency_min_ns": lat_min,
+            "latency_max_ns": lat_max, "latency_mean_ns": lat_mean,
+            "complete_max_ns": complete_max, "over_budget": over, "missed": missed,
+            "hist": hist}
+
+
+def poll_m4_jitter() -> None:
+    """Report control ticks the M4 entered later than its latency budget,
+    and ticks it skipped altogether."""
+    global LAST_OVER_BUDGET, LAST_MISSED
+    j = read_m4_jitter()
+    if not j:
+        return
+    if LAST_OVER_BUDGET is not None and j["over_budget"] > LAST_OVER_BUDGET:
+        print(f"[Jitter] {j['over_budget'] - LAST_OVER_BUDGET} control ticks over the "
+              f"{j['budget_ns']} ns budget; latency max {j['latency_max_ns']} ns, "
+              f"mean {j['latency_mean_ns']} ns, tick done by {j['complete_max_ns']} ns")
+    if LAST_MISSED is not None and j["missed"] > LAST_MISSED:
+        print(f"[Jitter] {j['missed'] - LAST_MISSED} control ticks missed")
+    LAST_OVER_BUDGET = j["over_budget"]
+    LAST_MISSED = j["missed"]
+
+
+def poll_m4_temperature_rate() -> None:
+    """Poll the M4's filtered temperature rate of change (degC/s)."""
+    rate = call_m4_rpc("temp_rate", retries=0, timeout=0.5)
+    if isinstance(rate, (int, float)):
+        update_and_broadcast("internal_temperature_rate", round(float(rate), 3), src="rpc")
+
+
+# --- M4 change notifications -------------------------------------------
+# The M4 pushes a telemetry frame ("m4_notify") on flag edges, on analog
+# moves beyond a deadband and as a heartbeat. m4-proxy forwards calls from
+# the M4 to services that registered their names on its registration port.
+M4_PROXY_REGISTER_PORT = 5000
+NOTIFY_CHANNELS = {"volt": 0, "curr": 1, "temp": 2}  # NotifyAnalog in Notify.h
+NOTIFY_STALE_HEARTBEATS = 3   # Fall back to polling after this many missed
+NOTIFY_RESUBSCRIBE_S = 5.0
+NOTIFY_STATE = {"listening": False, "heartbeat_s": 0.0, "last_rx": 0.0,
+                "last_subscribe": 0.0, "cfg": {}}
+
+
+class M4NotifyHandler:
+    """msgpack-rpc methods the M4 calls through m4-proxy."""
+
+    def m4_notify(self, frame, reason, edges):
+        NOTIFY_STATE["last_rx"] = time.time()
+        try:
+            apply_telemetry_frame(frame, int(edges))
+        except Exception as exc:
+            print(f"[Notify] Bad frame (reason=0x{int(reason):X}): {exc}")
+        return True
+
+
+def subscribe_m4_notify() -> bool:
+    """Turn M4 notifications on with the configured heartbeat and deadbands."""
+    cfg = NOTIFY_STATE["cfg"]
+    NOTIFY_STATE["last_subscribe"] = time.time()
+    for name, band in cfg.get("deadband", {}).items():
+        if name in NOTIFY_CHANNELS:
+            call_m4_rpc("notify_deadband", NOTIFY_CHANNELS[name], float(band), retries=0, timeout=0.3)
+    heartbeat_ms = int(cfg.get("heartbeat_ms", 1000))
+    if call_m4_rpc("notify_config", heartbeat_ms, retries=1, timeout=0.3) != 1:
+        print("[Notify] M4 did not accept notify_config; staying on polling.")
+        return False
+    NOTIFY_STATE["heartbeat_s"] = max(heartbeat_ms, 100) / 1000.0
+    return True
+
+
+def start_m4_notify_listener(cfg: dict) -> bool:
+    """
+    Serve m4_notify, register it with m4-proxy and subscribe on the M4.
+    Returns False (bridge keeps polling) if any step fails.
+    """
+    NOTIFY_STATE["cfg"] = cfg
+    if not cfg.get("enabled", False):
+        return False
+    port = int(cfg.get("port", 5005))
+    try:
+        server = RpcServer(M4NotifyHandler())
+        server.listen(RpcAddress("0.0.0.0", port))
+        threading.Thread(target=server.start, daemon=True, name="m4-notify").start()
+
+        client = RpcClient(RpcAddress(M4_PROXY_ADDRESS, M4_PROXY_REGISTER_PORT), timeout=1)
+        try:
+            client.call("register", port, ["m4_notify"])
+        finally:
+            client.close()
+    except Exception as exc:
+        print(f"[Notify] Listener setup failed ({exc}); staying on polling.")
+        return False
+
+    NOTIFY_STATE["listening"] = True
+    print(f"[Notify] Listening on port {port} for M4 notifications.")
+    return subscribe_m4_notify()
+
+
+def m4_notify_live(now: float) -> bool:
+    """True while notifications arrive at least every few heartbeats."""
+    hb = NOTIFY_STATE["heartbeat_s"]
+    return (NOTIFY_STATE["listening"] and hb > 0.0
+            and now - NOTIFY_STATE["last_rx"] < NOTIFY_STALE_HEARTBEATS * hb)
+
+
 def verify_m4_rpc_bindings():
     """Print a simple PASS/FAIL table for key M4 RPC bindings."""
     # Build a truth-table payload that doesn't change state (uses current values)
@@ -298,8 +745,22 @@ def verify_m4_rpc_bindings():
 
     checks = [
         ("get_poll_data",      ()),
+        ("get_telemetry",      ()),
+        ("get_pi_log",         ()),
+        ("trip_status",        ()),
+        ("scr_fire_log",       ()),
+        ("scope_status",       ()),
+        ("event_log_head",     ()),
+        ("sched_jitter",       ()),
+        ("temp_rate",          ()),
+        ("filter_delay_us",    (0,)),
+        ("notify_deadband",    (-1, 0.0)),
         ("has_sync_completed", ()),
         ("process_event_in_uc",(noop_evt,)),
+        ("param_set_many",     (build_param_batch([]),)),
+        ("param_get_many",     (b"",)),
+        ("param_hash",         (b"",)),
+        ("param_store_seq",    ()),
         ("set_truth_table",    (truth_json,)),
         ("volt_act",           ()),
         ("curr_act",           ()),
@@ -338,10 +799,10 @@ print = print_ts
 local_uid = os.urandom(4)
 
 
-def log_pid_sample(time_ms: int, set_current: float, duty: float) -> None:
-    """Append a PID sample to the CSV log."""
+def log_pid_sample(time_ms: int, set_current: float, duty: float, error=None) -> None:
+    """Append a PID sample to the CSV log (error is blank when unknown)."""
     with LOG_LOCK:
-        csv_writer.writerow([time_ms, set_current, duty])
+        csv_writer.writerow([time_ms, set_current, duty, "" if error is None else error])
         log_file.flush()
 
 # Signals that represent boolean values. When a toggle operation is requested
@@ -384,6 +845,11 @@ POLY_KEYS = {
 # UDP-facing duration signals are expressed in milliseconds
 TIME_MS_SIGNALS = {"t1", "th", "t2"}
 
+# load_waveform blob (see CurrWaveform.h): header, 24-byte segments, CRC-32
+WAVEFORM_MAGIC = 0x5746
+WAVEFORM_VERSION = 1
+WAVE_SEG_HOLD, WAVE_SEG_LINEAR, WAVE_SEG_CUBIC = 0, 1, 2
+
 CALIBRATION_KEYS = [
     "curr_scale",
     "curr_offset",
@@ -393,6 +859,9 @@ CALIBRATION_KEYS = [
     "min_load_res_ohm",
     "igbt_min_duty_pct",
     "igbt_max_duty_pct",
+    "pi_kp",
+    "pi_ki",
+    "pi_kaw",
     "current_limit_max",
     "over_voltage_limit",
     "warn_voltage_threshold",
@@ -421,11 +890,17 @@ def set_signal_value(name: str, value: float, src: str = "unknown") -> None:
             if abs(delta) < 1e-9: # Don't send updates if the value hasn't changed
                 return
 
+            if name in POLY_KEYS:
+                # Waveform parameters go up as one consistent profile, once
+                # the rest of the batch they arrived with is in
+                schedule_m4_waveform_upload()
+                return
+
             payload_value = int(valf) if name in BOOL_NAMES else valf
-            payload = json.dumps({"display_event": {"name": name, "value": payload_value}})
-            
             print(f"[Forward] Sending '{name}' -> {payload_value} to M4...")
-            call_m4_rpc("process_event_in_uc", payload)
+            send_params_to_m4([(name, payload_value)])
+            if name in CALIBRATION_KEYS:
+                schedule_m4_param_save()
 
 
 
@@ -438,35 +913,227 @@ def get_signal_value(name: str):
         return TRUE_VALUES.get(name)
 
 
+def build_waveform_blob(segments) -> bytes:
+    """Pack (type, duration_s, a, b, c, d) segments into a load_waveform blob."""
+    body = struct.pack("<HBB", WAVEFORM_MAGIC, WAVEFORM_VERSION, len(segments))
+    for seg_type, duration, a, b, c, d in segments:
+        body += struct.pack("<B3xfffff", seg_type, duration, a, b, c, d)
+    return body + struct.pack("<I", zlib.crc32(body) & 0xFFFFFFFF)
+
+
+def legacy_waveform_segments() -> list:
+    """Rise cubic / hold / fall cubic profile built from the POLY_KEYS values."""
+    with DATA_LOCK:
+        v = {k: float(TRUE_VALUES.get(k, 0.0) or 0.0) for k in POLY_KEYS}
+    a1, b1, c1, d1 = v["a1"], v["b1"], v["c1"], v["d1"]
+    hold_val = a1 + b1 + c1 + d1  # rise polynomial evaluated at s = 1
+    return [
+        (WAVE_SEG_CUBIC, max(0.0, v["t1"]), a1, b1, c1, d1),
+        (WAVE_SEG_HOLD,  max(0.0, v["th"]), hold_val, 0.0, 0.0, 0.0),
+        (WAVE_SEG_CUBIC, max(0.0, v["t2"]), v["a2"], v["b2"], v["c2"], v["d2"]),
+    ]
+
+
+# A profile edit arrives as up to eleven separate values; upload once they
+# stop coming rather than once per value
+WAVEFORM_UPLOAD_DELAY_S = 0.2
+WAVEFORM_UPLOAD_DUE = None  # time.time() at which to upload, None = nothing pending
+
+
+def schedule_m4_waveform_upload(delay: float = WAVEFORM_UPLOAD_DELAY_S) -> None:
+    global WAVEFORM_UPLOAD_DUE
+    WAVEFORM_UPLOAD_DUE = time.time() + delay
+
+
+def flush_m4_waveform_upload(now: float) -> None:
+    """Upload the edited profile once no edit has come for WAVEFORM_UPLOAD_DELAY_S."""
+    global WAVEFORM_UPLOAD_DUE
+    if WAVEFORM_UPLOAD_DUE is None or now < WAVEFORM_UPLOAD_DUE:
+        return
+    WAVEFORM_UPLOAD_DUE = None
+    send_polynomial_values_to_m4(repeat=1, delay=0.0)
+
+
+def send_waveform_to_m4(segments=None):
+    """Upload a whole profile in one load_waveform call.
+
+    The M4 compiles it into its shadow table and swaps it in between runs.
+    Returns the armed generation ID, or None if the firmware rejected the
+    blob or does not support the RPC.
+    """
+    blob = build_waveform_blob(segments if segments is not None else legacy_waveform_segments())
+    gen = call_m4_rpc("load_waveform", blob, retries=1, timeout=0.5)
+    if isinstance(gen, int) and gen > 0:
+        print(f"[Wave] Profile armed on M4, generation {gen}")
+        return gen
+    print(f"[Wave] load_waveform failed (result={gen})")
+    return None
+
+
+# Parameter batch (XC_SW/ParamRegistry.h), both directions: u8 version,
+# u8 count, then count x (u8 signal_id, u8 type, 4-byte value)
+PARAM_BATCH_VERSION = 1
+PARAM_BATCH_MAX = 255
+PARAM_WIRE_F32 = 0
+PARAM_WIRE_I32 = 1
+PARAM_BATCH_SUPPORTED = None  # Unknown until the first param_set_many call
+PARAM_ERR_WAVEFORM = -2       # Stored, but the legacy waveform they make was rejected
+PARAM_ERR_HARDWARE = -3       # IGBT PWM setting the M4 timer rejected; not stored
+
+
+def build_param_batch(values) -> bytes:
+    """Pack (name, value) pairs that have a signal id into a param_set_many blob."""
+    records = []
+    for name, value in values:
+        sid = SIGNAL_IDS.get(name)
+        if sid is None:
+            continue
+        if name in BOOL_NAMES or isinstance(value, (bool, int)):
+            records.append(struct.pack("<BBi", sid, PARAM_WIRE_I32, int(value)))
+        else:
+            records.append(struct.pack("<BBf", sid, PARAM_WIRE_F32, float(value)))
+    return struct.pack("<BB", PARAM_BATCH_VERSION, len(records)) + b"".join(records)
+
+
+def parse_param_batch(blob) -> dict:
+    """Decode a param_get_many reply into {name: value}."""
+    if not isinstance(blob, (bytes, bytearray)) or len(blob) < 2 or blob[0] != PARAM_BATCH_VERSION:
+        return {}
+    out = {}
+    for i in range(min(blob[1], (len(blob) - 2) // 6)):
+        sid, wire = struct.unpack_from("<BB", blob, 2 + 6 * i)
+        fmt = "<f" if wire == PARAM_WIRE_F32 else "<i"
+        (value,) = struct.unpack_from(fmt, blob, 4 + 6 * i)
+        name = SIGNAL_ID_TO_NAME.get(sid)
+        if name is not None:
+            out[name] = value
+    return out
+
+
+def read_m4_params(names=None) -> dict:
+    """Read parameters from the M4 in one round trip (all when names is None)."""
+    ids = bytes(SIGNAL_IDS[n] for n in (names or []) if n in SIGNAL_IDS)
+    if names and not ids:
+        return {}
+    return parse_param_batch(call_m4_rpc("param_get_many", ids, retries=1, timeout=0.3))
+
+
+def send_params_to_m4(values) -> bool:
+    """Apply several parameters on the M4 in one param_set_many call.
+
+    Falls back to one process_event_in_uc JSON message per value when the
+    firmware rejects the batch or predates it. Returns True if the batch
+    path was used.
+    """
+    global PARAM_BATCH_SUPPORTED
+    values = [(n, v) for n, v in values if v is not None]
+    batched = [(n, v) for n, v in values if n in SIGNAL_IDS][:PARAM_BATCH_MAX]
+    if batched and PARAM_BATCH_SUPPORTED is not False:
+        res = call_m4_rpc("param_set_many", build_param_batch(batched), retries=1, timeout=0.3)
+        if res is None and PARAM_BATCH_SUPPORTED is None:
+            print("[Batch] param_set_many unavailable; using JSON events")
+            PARAM_BATCH_SUPPORTED = False
+        if res == PARAM_ERR_WAVEFORM:
+            print("[Batch] M4 stored the values but rejected the waveform they make")
+            return True
+        if res == PARAM_ERR_HARDWARE:
+            print("[Batch] M4 rejected the IGBT PWM settings; the previous ones stay")
+            return True
+        if isinstance(res, int) and res >= 0:
+            PARAM_BATCH_SUPPORTED = True
+            if res != len(batched):
+                print(f"[Batch] M4 applied {res}/{len(batched)} signals")
+            done = {n for n, _ in batched}
+            for name, value in values:
+                if name not in done:
+                    call_m4_rpc("process_event_in_uc",
+                                json.dumps({"display_event": {"name": name, "value": value}}))
+            return True
+
+    for name, value in values:
+        call_m4_rpc("process_event_in_uc", json.dumps({"display_event": {"name": name, "value": value}}))
+    return False
+
+
 def send_polynomial_values_to_m4(repeat: int = 3, delay: float = 0.05) -> None:
-    """Send stored polynomial parameters to the M4 multiple times.
+    """Send stored polynomial parameters to the M4.
 
-    The current values for all keys in ``POLY_KEYS`` are retrieved from the
-    ``TRUE_VALUES`` store and sent to the microcontroller via
-    ``process_event_in_uc``.  Each coefficient is transmitted ``repeat`` times
-    with an optional ``delay`` in seconds between messages to improve
-    reliability.
+    Uses a single atomic ``load_waveform`` upload. If that fails the keys in
+    ``POLY_KEYS`` go as one ``param_set_many`` batch, and only on firmware
+    without either are they sent one at a time via ``process_event_in_uc``,
+    each transmitted ``repeat`` times with ``delay`` seconds between messages.
 
     Args:
-        repeat: Number of times each value should be transmitted.
-        delay:  Pause (in seconds) between transmissions.
+        repeat: Number of times each value should be transmitted (fallback).
+        delay:  Pause (in seconds) between transmissions (fallback).
     """
+    if send_waveform_to_m4() is not None:
+        return
+
     coeffs = []
     with DATA_LOCK:
         for key in POLY_KEYS:
             if key in TRUE_VALUES:
                 coeffs.append((key, TRUE_VALUES[key]))
 
-    for _ in range(max(1, repeat)):
+    if send_params_to_m4(coeffs):
+        return
+
+    for _ in range(repeat - 1):
+        time.sleep(delay)
         for name, val in coeffs:
             payload = json.dumps({"display_event": {"name": name, "value": val}})
             call_m4_rpc("process_event_in_uc", payload)
             time.sleep(delay)
 
 
+# Flash parameter store (XC_SW/ParamStore.h). Saves are deferred so a run
+# of UI edits costs one flash write, and retried while the M4 refuses them
+# because the output is active.
+PARAM_STORE_ERR_BUSY = -1
+PARAM_SAVE_DELAY_S = 5.0
+PARAM_SAVE_TIMEOUT_S = 5.0  # A sector erase blocks the M4 for up to ~2 s
+PARAM_SAVE_DUE = None       # time.time() at which to save, None = nothing pending
+
+
+def m4_param_hash(entries) -> int:
+    """The param_hash the M4 reports once it holds these (name, value) pairs.
+
+    crc32 over (u8 signal_id, f32 value) per entry in order, as computed by
+    param_store_hash() on the M4. Entries without a signal id are left out.
+    """
+    body = b"".join(struct.pack("<Bf", SIGNAL_IDS[name], float(value))
+                    for name, value in entries if name in SIGNAL_IDS)
+    return zlib.crc32(body) & 0xFFFFFFFF
+
+
+def schedule_m4_param_save(delay: float = PARAM_SAVE_DELAY_S) -> None:
+    global PARAM_SAVE_DUE
+    PARAM_SAVE_DUE = time.time() + delay
+
+
+def save_m4_params() -> None:
+    """Ask the M4 to write its calibration and limits to flash."""
+    global PARAM_SAVE_DUE
+    res = call_m4_rpc("param_save", retries=1, timeout=PARAM_SAVE_TIMEOUT_S)
+    if res == PARAM_STORE_ERR_BUSY:
+        schedule_m4_param_save()  # Output active; try again once it is idle
+        return
+    PARAM_SAVE_DUE = None
+    if res == 1:
+        seq = call_m4_rpc("param_store_seq", retries=1, timeout=0.3)
+        print(f"[Cal] M4 parameters saved to flash (record {seq}).")
+    elif res is not None:
+        print(f"[Cal] M4 parameter save failed ({res}).")
+
+
 def send_calibration_values_to_m4(repeat: int = 2, delay: float = 0.05) -> None:
     """Transmit calibration constants from TRUE_VALUES to the M4.
 
+    Nothing is sent when the M4 reports the same param_hash as these values,
+    i.e. it booted with them from its flash store. Otherwise they are sent
+    and a flash save is scheduled.
+
     Args:
         repeat: Number of times each calibration value should be sent.
         delay:  Pause in seconds between transmissions of individual values.
@@ -482,8 +1149,28 @@ def send_calibration_values_to_m4(repeat: int = 2, delay: float = 0.05) -> None:
         print("[Cal] No calibration values found in TRUE_VALUES; skipping send.")
         return
 
+    if all(name in SIGNAL_IDS for name, _ in entries):
+        ids = bytes(SIGNAL_IDS[name] for name, _ in entries)
+        expected = m4_param_hash(entries)
+        stored = call_m4_rpc("param_hash", ids, retries=1, timeout=0.3)
+        if stored == expected:
+            print(f"[Cal] M4 already holds these {len(entries)} values (hash {expected:08X}); not sending.")
+            return
+
     print(f"[Cal] Sending {len(entries)} calibration values to M4 via RPC...")
-    for _ in range(max(1, repeat)):
+    if send_params_to_m4(entries):
+        schedule_m4_param_save(0.0)
+        # Read back in one call: shows what the M4 clamped
+        applied = read_m4_params([name for name, _ in entries])
+        for name, value in entries:
+            got = applied.get(name)
+            if got is None or abs(float(got) - float(value)) > 1e-3 * max(1.0, abs(float(value))):
+                print(f"[Cal]   {name}: sent {value}, M4 has {got}")
+        print(f"[Cal] Calibration applied ({len(applied)}/{len(entries)} read back).")
+        return
+
+    for _ in range(max(1, repeat) - 1):
+        time.sleep(delay)
         for name, value in entries:
             payload = json.dumps({"display_event": {"name": name, "value": value}})
             try:
@@ -493,6 +1180,35 @@ def send_calibration_values_to_m4(repeat: int = 2, delay: float = 0.05) -> None:
                 print(f"[Cal]   Failed to send '{name}': {exc}")
             time.sleep(delay)
 
+# Ids as in XC_SW/SignalFilter.h
+M4_FILTER_CHANNELS = {"volt_fast": 0, "volt": 1, "curr": 2}
+M4_FILTER_TYPES = {"bypass": 0, "biquad": 1, "moving_avg": 2}
+
+
+def send_filter_config_to_m4(filters: list) -> None:
+    """Apply the ``m4_filters`` section of config.json on the M4.
+
+    Each entry names a channel and a filter type; ``biquad`` takes
+    ``cutoff_hz`` and ``order``, ``moving_avg`` takes ``length``. Channels
+    left out keep the firmware defaults.
+    """
+    for entry in filters:
+        channel = entry.get("channel")
+        ftype = entry.get("type", "bypass")
+        if channel not in M4_FILTER_CHANNELS or ftype not in M4_FILTER_TYPES:
+            print(f"[Filter] Skipping invalid entry: {entry}")
+            continue
+        ch = M4_FILTER_CHANNELS[channel]
+        n = int(entry.get("order", 0)) if ftype == "biquad" else int(entry.get("length", 0))
+        res = call_m4_rpc("set_filter", ch, M4_FILTER_TYPES[ftype],
+                          float(entry.get("cutoff_hz", 0.0)), n)
+        if res != 1:
+            print(f"[Filter] {channel}: rejected ({res})")
+            continue
+        delay = call_m4_rpc("filter_delay_us", ch, retries=1, timeout=0.3)
+        delay_txt = f"{delay:.0f} us" if isinstance(delay, (int, float)) else "?"
+        print(f"[Filter] {channel}: {ftype}, group delay {delay_txt}")
+
 # Binary UDP protocol constants
 DEFAULT_SIGN_KEY = bytes.fromhex(('57 4F 4F 44 52 55 46 46 ' * 16).replace(' ', ''))
 CONFIG_KEY = bytes([0x3A, 0x7F, 0x0C, 0xD5])
@@ -1271,12 +1987,15 @@ def process_giga_event(event_data):
             new_val = apply_math_operation(current_val, value, op=op)
             print(f"[Logic] Applied {op} on '{name}': {current_val} -> {new_val}")
 
-            payload = json.dumps({"display_event": {"name": name, "value": new_val}})
-            call_m4_rpc("process_event_in_uc", payload)
+            send_params_to_m4([(name, new_val)])
             update_and_broadcast(name, new_val, src="uc")
             return
 
         elif event_dest == "linux":
+            if name == "scope_trigger":
+                print(f"[Logic] Manual scope trigger: {'armed' if trigger_m4_scope() else 'not armed'}")
+                return
+
             if name == "SW_GET_VERSION":
                 # Always return the correct version and block overwrites
                 print(f"[Logic] SW_GET_VERSION = {SIG_VERSION} ({version_int_to_ascii(SIG_VERSION)})")
@@ -1352,6 +2071,9 @@ if __name__ == "__main__":
     build_poll_name_map(m4_polls_config)
     verify_m4_rpc_bindings()
     send_calibration_values_to_m4()
+    send_filter_config_to_m4(config_data.get("m4_filters", []))
+    start_m4_notify_listener(config_data.get("m4_notify", {}))
+    start_m4_scope(config_data.get("m4_scope", {}))
     
     # --- Step 5: Start network listeners and serial port ---
     udp_thread = threading.Thread(target=udp_listener, daemon=True)
@@ -1374,8 +2096,11 @@ if __name__ == "__main__":
     print("[Init] Starting main loop...")
     last_broadcast_time = 0
     last_poll_time = 0
+    last_slow_poll_time = 0
+    pi_log_pending = False
     BROADCAST_INTERVAL = 0.2  # 5 Hz
     POLL_INTERVAL = 0.05      # 20 Hz
+    SLOW_POLL_INTERVAL = 0.5  # 2 Hz, values the M4 updates at 10 Hz or slower
 
     try:
         while True:
@@ -1385,11 +2110,31 @@ if __name__ == "__main__":
             if giga_event:
                 process_giga_event(giga_event)
 
+            # While the M4 pushes notifications, only the PI debug tap is
+            # polled, and only while a shot is running or it still has data
+            notify_live = m4_notify_live(current_time)
             if current_time - last_poll_time > POLL_INTERVAL:
-                poll_m4_signals() 
-                poll_m4_signals_temp()
+                if not notify_live:
+                    if not poll_m4_telemetry():
+                        poll_m4_signals() 
+                        poll_m4_signals_temp()
+                poll_m4_events()
+                flush_m4_waveform_upload(current_time)
+                if not notify_live or pi_log_pending or get_signal_value("run_current_wave"):
+                    pi_log_pending = poll_m4_pi_log() > 0
                 last_poll_time = current_time
 
+            if current_time - last_slow_poll_time > SLOW_POLL_INTERVAL:
+                poll_m4_temperature_rate()
+                poll_m4_scope()
+                poll_m4_jitter()
+                if PARAM_SAVE_DUE is not None and current_time >= PARAM_SAVE_DUE:
+                    save_m4_params()
+                if (NOTIFY_STATE["listening"] and not notify_live and
+                        current_time - NOTIFY_STATE["last_subscribe"] > NOTIFY_RESUBSCRIBE_S):
+                    subscribe_m4_notify()  # M4 restarted or dropped the subscription
+                last_slow_poll_time = current_time
+
             if current_time - last_broadcast_time > BROADCAST_INTERVAL:
                 broadcast_all_values()
                 last_broadcast_time = current_time
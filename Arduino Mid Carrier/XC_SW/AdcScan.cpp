@@ -0,0 +1,361 @@
+#include "AdcScan.h"
+#include "Config.h"
+#include <Arduino.h>
+#include "stm32h7xx_hal.h"
+
+// ----- Scan units -----
+// ADC1 converts voltage + current, ADC3 converts the internal temperature
+// (PC2_C is only routed to ADC3). Both are triggered by TIM6 TRGO so every
+// frame in the buffers is one hardware-oversampled sample per channel.
+// ADC2 converts the current probe again, once per IGBT period on TIM3 TRGO.
+struct ScanUnit {
+  ADC_HandleTypeDef adc;
+  DMA_HandleTypeDef dma;
+  volatile uint16_t* buf;   // ADC_SCAN_DEPTH frames of nch samples
+  uint8_t            nch;
+  bool               running;
+};
+
+static TIM_HandleTypeDef s_tim6 = {};
+
+__attribute__((aligned(32))) static volatile uint16_t s_adc1_buf[ADC_SCAN_DEPTH * 2];
+__attribute__((aligned(32))) static volatile uint16_t s_adc3_buf[ADC_SCAN_DEPTH * 1];
+__attribute__((aligned(32))) static volatile uint16_t s_adc2_buf[ADC_SCAN_DEPTH * 1];
+
+static ScanUnit s_adc1 = { {}, {}, s_adc1_buf, 2, false };
+static ScanUnit s_adc3 = { {}, {}, s_adc3_buf, 1, false };
+static ScanUnit s_adc2 = { {}, {}, s_adc2_buf, 1, false };
+
+static const uint32_t s_adc1_channels[] = { ADC_CHANNEL_2, ADC_CHANNEL_1 };
+static const uint32_t s_adc3_channels[] = { ADC_CHANNEL_0 };
+static const uint32_t s_adc2_channels[] = { ADC_CHANNEL_1 };
+
+// ----- ADC1 analog watchdogs -----
+// AWD1 on the voltage rank, AWD2 and AWD3 on the current rank. Channel and
+// mode are set once before the scan starts; afterwards only LTRx/HTRx and
+// the interrupt enables are written, which the ADC accepts mid-scan.
+#define AWD_COUNT  3U
+
+static const uint32_t s_awd_number[AWD_COUNT]  = { ADC_ANALOGWATCHDOG_1, ADC_ANALOGWATCHDOG_2, ADC_ANALOGWATCHDOG_3 };
+static const uint32_t s_awd_channel[AWD_COUNT] = { ADC_CHANNEL_2, ADC_CHANNEL_1, ADC_CHANNEL_1 };
+static const uint32_t s_awd_flag[AWD_COUNT]    = { ADC_FLAG_AWD1, ADC_FLAG_AWD2, ADC_FLAG_AWD3 };
+static uint8_t        s_awd_shift = 0;   // Raw count -> LTRx/HTRx, as the HAL encodes it
+
+// --- Helpers --------------------------------------------------------------
+
+// Right-shift that brings a 12-bit oversampled sum back to 12-bit counts
+static constexpr uint32_t oversample_shift(uint32_t ratio) {
+  return (ratio >= 1024U) ? ADC_RIGHTBITSHIFT_10 :
+         (ratio >=  512U) ? ADC_RIGHTBITSHIFT_9  :
+         (ratio >=  256U) ? ADC_RIGHTBITSHIFT_8  :
+         (ratio >=  128U) ? ADC_RIGHTBITSHIFT_7  :
+         (ratio >=   64U) ? ADC_RIGHTBITSHIFT_6  :
+         (ratio >=   32U) ? ADC_RIGHTBITSHIFT_5  :
+         (ratio >=   16U) ? ADC_RIGHTBITSHIFT_4  :
+         (ratio >=    8U) ? ADC_RIGHTBITSHIFT_3  :
+         (ratio >=    4U) ? ADC_RIGHTBITSHIFT_2  :
+         (ratio >=    2U) ? ADC_RIGHTBITSHIFT_1  :
+                            ADC_RIGHTBITSHIFT_NONE;
+}
+
+static bool start_trigger_timer() {
+  __HAL_RCC_TIM6_CLK_ENABLE();
+
+  const uint32_t timer_clock_hz = 200000000U; // Same APB1 timer clock as TIM3
+  uint32_t total_ticks = timer_clock_hz / ADC_SCAN_RATE_HZ;
+
+  uint32_t psc = 0, arr = 0;
+  while (1) {
+    arr = (total_ticks / (psc + 1U)) - 1U;
+    if (arr <= 65535U) break;
+    if (++psc > 65535U) return false;
+  }
+
+  s_tim6.Instance               = TIM6;
+  s_tim6.Init.Prescaler         = psc;
+  s_tim6.Init.CounterMode       = TIM_COUNTERMODE_UP;
+  s_tim6.Init.Period            = arr;
+  s_tim6.Init.AutoReloadPreload = TIM_AUTORELOAD_PRELOAD_ENABLE;
+  if (HAL_TIM_Base_Init(&s_tim6) != HAL_OK) return false;
+
+  TIM_MasterConfigTypeDef mcfg = {};
+  mcfg.MasterOutputTrigger = TIM_TRGO_UPDATE;
+  mcfg.MasterSlaveMode     = TIM_MASTERSLAVEMODE_DISABLE;
+  if (HAL_TIMEx_MasterConfigSynchronization(&s_tim6, &mcfg) != HAL_OK) return false;
+
+  return HAL_TIM_Base_Start(&s_tim6) == HAL_OK;
+}
+
+// Bind the three watchdogs to their channels, window wide open and
+// interrupt masked. The threshold encoding (resolution and oversampling
+// shift) is read back from what the HAL wrote for a 1-count threshold.
+static bool setup_watchdogs(ADC_HandleTypeDef* h) {
+  ADC_AnalogWDGConfTypeDef awd = {};
+  awd.WatchdogMode  = ADC_ANALOGWATCHDOG_SINGLE_REG;
+  awd.ITMode        = DISABLE;
+  awd.LowThreshold  = 0U;
+  awd.HighThreshold = 1U;
+  awd.WatchdogNumber = s_awd_number[0];
+  awd.Channel        = s_awd_channel[0];
+  if (HAL_ADC_AnalogWDGConfig(h, &awd) != HAL_OK) return false;
+  const uint32_t one = h->Instance->HTR1;
+  s_awd_shift = (one != 0U) ? (uint8_t)__builtin_ctz(one) : 0U;
+
+  awd.HighThreshold = 4095U;
+  for (uint32_t n = 0; n < AWD_COUNT; ++n) {
+    awd.WatchdogNumber = s_awd_number[n];
+    awd.Channel        = s_awd_channel[n];
+    if (HAL_ADC_AnalogWDGConfig(h, &awd) != HAL_OK) return false;
+  }
+  return true;
+}
+
+static bool init_unit(ScanUnit& u, ADC_TypeDef* adc, DMA_Stream_TypeDef* stream,
+                      uint32_t dma_request, const uint32_t* channels,
+                      uint32_t trigger, uint32_t oversample, bool watchdogs) {
+  // --- DMA: ADC data register -> circular frame buffer ---
+  u.dma.Instance                 = stream;
+  u.dma.Init.Request             = dma_request;
+  u.dma.Init.Direction           = DMA_PERIPH_TO_MEMORY;
+  u.dma.Init.PeriphInc           = DMA_PINC_DISABLE;
+  u.dma.Init.MemInc              = DMA_MINC_ENABLE;
+  u.dma.Init.PeriphDataAlignment = DMA_PDATAALIGN_HALFWORD;
+  u.dma.Init.MemDataAlignment    = DMA_MDATAALIGN_HALFWORD;
+  u.dma.Init.Mode                = DMA_CIRCULAR;
+  u.dma.Init.Priority            = DMA_PRIORITY_HIGH;
+  u.dma.Init.FIFOMode            = DMA_FIFOMODE_DISABLE;
+  if (HAL_DMA_Init(&u.dma) != HAL_OK) return false;
+  __HAL_LINKDMA(&u.adc, DMA_Handle, u.dma);
+
+  // --- ADC: 12-bit, scan, one (oversampled) frame per trigger ---
+  u.adc.Instance                      = adc;
+  u.adc.Init.ClockPrescaler           = ADC_CLOCK_ASYNC_DIV4;
+  u.adc.Init.Resolution               = ADC_RESOLUTION_12B;
+  u.adc.Init.ScanConvMode             = (u.nch > 1) ? ADC_SCAN_ENABLE : ADC_SCAN_DISABLE;
+  u.adc.Init.EOCSelection             = ADC_EOC_SEQ_CONV;
+  u.adc.Init.LowPowerAutoWait         = DISABLE;
+  u.adc.Init.ContinuousConvMode       = DISABLE;
+  u.adc.Init.NbrOfConversion          = u.nch;
+  u.adc.Init.DiscontinuousConvMode    = DISABLE;
+  u.adc.Init.ExternalTrigConv         = trigger;
+  u.adc.Init.ExternalTrigConvEdge     = ADC_EXTERNALTRIGCONVEDGE_RISING;
+  u.adc.Init.ConversionDataManagement = ADC_CONVERSIONDATA_DMA_CIRCULAR;
+  u.adc.Init.Overrun                  = ADC_OVR_DATA_OVERWRITTEN;
+  u.adc.Init.LeftBitShift             = ADC_LEFTBITSHIFT_NONE;
+  u.adc.Init.OversamplingMode         = (oversample > 1U) ? ENABLE : DISABLE;
+  u.adc.Init.Oversampling.Ratio                 = oversample;
+  u.adc.Init.Oversampling.RightBitShift         = oversample_shift(oversample);
+  u.adc.Init.Oversampling.TriggeredMode         = ADC_TRIGGEREDMODE_SINGLE_TRIGGER;
+  u.adc.Init.Oversampling.OversamplingStopReset = ADC_REGOVERSAMPLING_CONTINUED_MODE;
+  if (HAL_ADC_Init(&u.adc) != HAL_OK) return false;
+
+  if (HAL_ADCEx_Calibration_Start(&u.adc, ADC_CALIB_OFFSET, ADC_SINGLE_ENDED) != HAL_OK) return false;
+
+  static const uint32_t ranks[] = { ADC_REGULAR_RANK_1, ADC_REGULAR_RANK_2, ADC_REGULAR_RANK_3 };
+  ADC_ChannelConfTypeDef ch = {};
+  ch.SamplingTime = ADC_SAMPLETIME_16CYCLES_5;
+  ch.SingleDiff   = ADC_SINGLE_ENDED;
+  ch.OffsetNumber = ADC_OFFSET_NONE;
+  ch.Offset       = 0;
+  for (uint8_t i = 0; i < u.nch; ++i) {
+    ch.Channel = channels[i];
+    ch.Rank    = ranks[i];
+    if (HAL_ADC_ConfigChannel(&u.adc, &ch) != HAL_OK) return false;
+  }
+
+  if (watchdogs && !setup_watchdogs(&u.adc)) return false;
+
+  if (HAL_ADC_Start_DMA(&u.adc, (uint32_t*)u.buf, ADC_SCAN_DEPTH * u.nch) != HAL_OK) return false;
+  // Circular DMA with DR overwritten: an overrun loses nothing we read, so
+  // it must not hold ADC_IRQn (which HAL_ADC_Start_DMA() enables it on)
+  __HAL_ADC_DISABLE_IT(&u.adc, ADC_IT_OVR);
+  __HAL_ADC_CLEAR_FLAG(&u.adc, ADC_FLAG_OVR);
+
+  u.running = true;
+  return true;
+}
+
+// Index of the newest fully written frame. The DMA counter tells us where the
+// next element lands; the frame before that one is complete.
+static inline uint16_t latest_sample(const ScanUnit& u, uint8_t rank) {
+  const uint32_t len = (uint32_t)ADC_SCAN_DEPTH * u.nch;
+  const uint32_t pos = len - __HAL_DMA_GET_COUNTER(&u.dma);
+  const uint32_t frame = ((pos / u.nch) + ADC_SCAN_DEPTH - 1U) % ADC_SCAN_DEPTH;
+  return u.buf[frame * u.nch + rank];
+}
+
+// --- Public API -----------------------------------------------------------
+
+void init_adc_scan() {
+  __HAL_RCC_GPIOA_CLK_ENABLE();
+  __HAL_RCC_GPIOC_CLK_ENABLE();
+  __HAL_RCC_GPIOF_CLK_ENABLE();
+  __HAL_RCC_SYSCFG_CLK_ENABLE();
+  __HAL_RCC_ADC12_CLK_ENABLE();
+  __HAL_RCC_ADC3_CLK_ENABLE();
+  __HAL_RCC_DMA2_CLK_ENABLE();
+
+  // PF11 -> ADC1_INP2 (voltage probe)
+  GPIO_InitTypeDef gpio = {};
+  gpio.Pin  = GPIO_PIN_11;
+  gpio.Mode = GPIO_MODE_ANALOG;
+  gpio.Pull = GPIO_NOPULL;
+  HAL_GPIO_Init(GPIOF, &gpio);
+
+  // PA1_C / PC2_C are dedicated analog pads behind the SYSCFG switches
+  HAL_SYSCFG_AnalogSwitchConfig(SYSCFG_SWITCH_PA1, SYSCFG_SWITCH_PA1_OPEN);
+  HAL_SYSCFG_AnalogSwitchConfig(SYSCFG_SWITCH_PC2, SYSCFG_SWITCH_PC2_OPEN);
+
+  // Start triggering only once both DMA streams are armed; on any failure the
+  // readers fall back to analogRead()
+  if (!init_unit(s_adc1, ADC1, DMA2_Stream0, DMA_REQUEST_ADC1, s_adc1_channels,
+                 ADC_EXTERNALTRIG_T6_TRGO, ADC_SCAN_OVERSAMPLE, true) ||
+      !init_unit(s_adc3, ADC3, DMA2_Stream1, DMA_REQUEST_ADC3, s_adc3_channels,
+                 ADC_EXTERNALTRIG_T6_TRGO, ADC_SCAN_OVERSAMPLE, false) ||
+      !start_trigger_timer()) {
+    s_adc1.running = false;
+    s_adc3.running = false;
+  }
+}
+
+bool adc_scan_running() {
+  return s_adc1.running && s_adc3.running;
+}
+
+int adc_scan_read(AdcScanChannel ch, AnalogReadFunc reader, uint8_t pin) {
+  if (reader) return reader(pin);
+
+  switch (ch) {
+    case ADC_SCAN_VOLTAGE:     if (s_adc1.running) return latest_sample(s_adc1, 0); break;
+    case ADC_SCAN_CURRENT:     if (s_adc1.running) return latest_sample(s_adc1, 1); break;
+    case ADC_SCAN_TEMPERATURE: if (s_adc3.running) return latest_sample(s_adc3, 0); break;
+    default: break;
+  }
+  return analogRead(pin);
+}
+
+float adc_scan_average(AdcScanChannel ch, AnalogReadFunc reader, uint8_t pin) {
+  const ScanUnit* u = nullptr;
+  uint8_t rank = 0;
+  switch (ch) {
+    case ADC_SCAN_VOLTAGE:     u = &s_adc1; rank = 0; break;
+    case ADC_SCAN_CURRENT:     u = &s_adc1; rank = 1; break;
+    case ADC_SCAN_TEMPERATURE: u = &s_adc3; rank = 0; break;
+    default: break;
+  }
+  if (reader || u == nullptr || !u->running) return (float)adc_scan_read(ch, reader, pin);
+
+  // Frames may be overwritten while we sum; each one is a complete sample
+  uint32_t sum = 0;
+  for (uint32_t f = 0; f < ADC_SCAN_DEPTH; ++f) sum += u->buf[f * u->nch + rank];
+  return (float)sum * (1.0f / (float)ADC_SCAN_DEPTH);
+}
+
+bool adc_scan_start_pwm_sync() {
+  if (s_adc2.running) return true;
+  __HAL_RCC_ADC12_CLK_ENABLE();
+  __HAL_RCC_DMA2_CLK_ENABLE();
+
+  // Not oversampled: the conversion has to finish well inside the flat
+  // middle of the on-pulse, even at the top of the PWM frequency range
+  if (!init_unit(s_adc2, ADC2, DMA2_Stream2, DMA_REQUEST_ADC2, s_adc2_channels,
+                 ADC_EXTERNALTRIG_T3_TRGO, 1U, false)) {
+    s_adc2.running = false;
+    return false;
+  }
+  __HAL_ADC_CLEAR_FLAG(&s_adc2.adc, ADC_FLAG_EOS);
+  return true;
+}
+
+bool adc_scan_pwm_sync_running() { return s_adc2.running; }
+
+bool adc_scan_take_pwm_sample(uint16_t& raw) {
+  // DMA reads of DR clear EOC but not EOS, so EOS marks a fresh conversion
+  ADC_HandleTypeDef* h = &s_adc2.adc;
+  if (!s_adc2.running || !__HAL_ADC_GET_FLAG(h, ADC_FLAG_EOS)) return false;
+  __HAL_ADC_CLEAR_FLAG(h, ADC_FLAG_EOS);
+  raw = latest_sample(s_adc2, 0);
+  return true;
+}
+
+// New window straight into LTRx/HTRx while ADC1 keeps converting. The
+// interrupt is masked across the two writes so no conversion is judged
+// against half of the old window and half of the new one; afterwards it
+// is enabled if `arm`, else left as it was.
+static bool write_watchdog(uint32_t n, uint16_t low, uint16_t high, bool arm) {
+  if (!s_adc1.running) return false;
+  ADC_HandleTypeDef* h = &s_adc1.adc;
+  ADC_TypeDef* adc = h->Instance;
+  volatile uint32_t* const ltr[AWD_COUNT] = { &adc->LTR1, &adc->LTR2, &adc->LTR3 };
+  volatile uint32_t* const htr[AWD_COUNT] = { &adc->HTR1, &adc->HTR2, &adc->HTR3 };
+
+  // IER is also written from ADC_IRQn
+  const uint32_t primask = __get_PRIMASK();
+  __disable_irq();
+  const bool armed = arm || __HAL_ADC_GET_IT_SOURCE(h, s_awd_flag[n]);
+  __HAL_ADC_DISABLE_IT(h, s_awd_flag[n]);
+  *ltr[n] = (uint32_t)low << s_awd_shift;
+  *htr[n] = (uint32_t)high << s_awd_shift;
+  __HAL_ADC_CLEAR_FLAG(h, s_awd_flag[n]);
+  if (armed) __HAL_ADC_ENABLE_IT(h, s_awd_flag[n]);
+  __set_PRIMASK(primask);
+  return true;
+}
+
+bool adc_scan_set_watchdog(AdcScanChannel ch, uint16_t low, uint16_t high) {
+  if (ch != ADC_SCAN_VOLTAGE && ch != ADC_SCAN_CURRENT) return false;
+  return write_watchdog((ch == ADC_SCAN_VOLTAGE) ? 0U : 1U, low, high, true);
+}
+
+bool adc_scan_set_scr_watchdog(uint16_t low, uint16_t high) {
+  return write_watchdog(2U, low, high, false);
+}
+
+void adc_scan_arm_scr_watchdog(bool armed) {
+  ADC_HandleTypeDef* h = &s_adc1.adc;
+  if (h->Instance == nullptr) return;
+  // IER is also written from ADC_IRQn
+  const uint32_t primask = __get_PRIMASK();
+  __disable_irq();
+  if (armed) {
+    __HAL_ADC_CLEAR_FLAG(h, ADC_FLAG_AWD3);
+    __HAL_ADC_ENABLE_IT(h, ADC_IT_AWD3);
+  } else {
+    __HAL_ADC_DISABLE_IT(h, ADC_IT_AWD3);
+  }
+  __set_PRIMASK(primask);
+}
+
+// ADC1 and ADC2 share ADC_IRQn: an overrun flagged with its interrupt
+// still enabled would re-enter the handler for ever
+static void clear_overrun(ADC_HandleTypeDef* h) {
+  if (h->Instance == nullptr) return;
+  if (__HAL_ADC_GET_IT_SOURCE(h, ADC_IT_OVR)) __HAL_ADC_DISABLE_IT(h, ADC_IT_OVR);
+  if (__HAL_ADC_GET_FLAG(h, ADC_FLAG_OVR)) __HAL_ADC_CLEAR_FLAG(h, ADC_FLAG_OVR);
+}
+
+uint32_t adc_scan_take_watchdog_events() {
+  clear_overrun(&s_adc1.adc);
+  clear_overrun(&s_adc2.adc);
+
+  ADC_HandleTypeDef* h = &s_adc1.adc;
+  if (h->Instance == nullptr) return 0;
+
+  uint32_t events = 0;
+  if (__HAL_ADC_GET_IT_SOURCE(h, ADC_IT_AWD1) && __HAL_ADC_GET_FLAG(h, ADC_FLAG_AWD1)) {
+    __HAL_ADC_DISABLE_IT(h, ADC_IT_AWD1);
+    __HAL_ADC_CLEAR_FLAG(h, ADC_FLAG_AWD1);
+    events |= 1U << ADC_SCAN_VOLTAGE;
+  }
+  if (__HAL_ADC_GET_IT_SOURCE(h, ADC_IT_AWD2) && __HAL_ADC_GET_FLAG(h, ADC_FLAG_AWD2)) {
+    __HAL_ADC_DISABLE_IT(h, ADC_IT_AWD2);
+    __HAL_ADC_CLEAR_FLAG(h, ADC_FLAG_AWD2);
+    events |= 1U << ADC_SCAN_CURRENT;
+  }
+  if (__HAL_ADC_GET_IT_SOURCE(h, ADC_IT_AWD3) && __HAL_ADC_GET_FLAG(h, ADC_FLAG_AWD3)) {
+    __HAL_ADC_DISABLE_IT(h, ADC_IT_AWD3);
+    __HAL_ADC_CLEAR_FLAG(h, ADC_FLAG_AWD3);
+    events |= ADC_SCAN_EVENT_SCR;
+  }
+  return events;
+}
@@ -0,0 +1,68 @@
+#ifndef ADC_SCAN_H
+#define ADC_SCAN_H
+
+#include "Config.h"
+
+typedef int (*AnalogReadFunc)(uint8_t);
+
+// Channels covered by the timer-triggered DMA scan
+enum AdcScanChannel : uint8_t {
+  ADC_SCAN_VOLTAGE = 0,   // ADC1 rank 1 (PF11)
+  ADC_SCAN_CURRENT,       // ADC1 rank 2 (PA1_C)
+  ADC_SCAN_TEMPERATURE,   // ADC3 rank 1 (PC2_C)
+  ADC_SCAN_NUM_CHANNELS
+};
+
+// Configure ADC1/ADC3 for hardware-oversampled scans triggered by TIM6 and
+// streamed by DMA into circular buffers. Call after the pinMode() calls in the
+// measurement init functions so the pins end up in analog mode.
+void init_adc_scan();
+
+// True once both ADCs are converting into their DMA buffers
+bool adc_scan_running();
+
+// Latest decimated 12-bit sample for a channel.
+// A non-null reader takes precedence (host/test injection); without a running
+// scan this falls back to a blocking analogRead(pin).
+int adc_scan_read(AdcScanChannel ch, AnalogReadFunc reader, uint8_t pin);
+
+// Mean of every frame in the circular buffer for a channel
+// (ADC_SCAN_DEPTH x ADC_SCAN_OVERSAMPLE conversions), in 12-bit counts.
+// Same reader/fallback rules as adc_scan_read().
+float adc_scan_average(AdcScanChannel ch, AnalogReadFunc reader, uint8_t pin);
+
+// ADC2: one conversion of the current probe (PA1_C) per IGBT PWM period,
+// triggered by TIM3 TRGO and streamed by DMA into its own circular buffer.
+// Called by igbt_enable_trgo_from_pwm() once the trigger is routed.
+bool adc_scan_start_pwm_sync();
+bool adc_scan_pwm_sync_running();
+
+// Newest PWM-synchronous current sample in 12-bit counts. False if no
+// conversion has completed since the previous call (the IGBT period is
+// longer than the control tick): the caller holds the previous one.
+bool adc_scan_take_pwm_sample(uint16_t& raw);
+
+// Arm the ADC1 analog watchdog for the voltage (AWD1) or current (AWD2)
+// rank: any conversion outside [low, high] raw counts raises ADC_IRQn.
+// Writes the threshold registers while the scan runs, so it is safe from
+// any thread. Returns false if the scan is not running.
+bool adc_scan_set_watchdog(AdcScanChannel ch, uint16_t low, uint16_t high);
+
+// ADC1 AWD3 on the current rank, for the SCR fire threshold (see
+// ScrPulse.h). Same rules as adc_scan_set_watchdog(), except that the
+// interrupt keeps its masked/armed state.
+bool adc_scan_set_scr_watchdog(uint16_t low, uint16_t high);
+
+// Unmask (clearing a stale event) or mask AWD3, keeping its window
+void adc_scan_arm_scr_watchdog(bool armed);
+
+// Event bit of AWD3 in adc_scan_take_watchdog_events()
+#define ADC_SCAN_EVENT_SCR  (1U << ADC_SCAN_NUM_CHANNELS)
+
+// From ADC_IRQn: bitmask of (1 << AdcScanChannel) for each watchdog that
+// fired, plus ADC_SCAN_EVENT_SCR. Clears the flags and masks those
+// watchdogs until they are re-armed. Also clears (and masks) an ADC1/ADC2
+// overrun, which shares the interrupt.
+uint32_t adc_scan_take_watchdog_events();
+
+#endif // ADC_SCAN_H
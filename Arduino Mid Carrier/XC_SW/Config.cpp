@@ -4,10 +4,10 @@
 // --- Define Calibration Constants ---
 //
 // initially bringing the system up.
-float VScale_V = 1113.0f;
-float VOffset_V = -322.0f;
-float VScale_C = 0.0f;
-float VOffset_C = 0.0f;
+float VScale_V = DEFAULT_VSCALE_V;
+float VOffset_V = DEFAULT_VOFFSET_V;
+float VScale_C = DEFAULT_VSCALE_C;
+float VOffset_C = DEFAULT_VOFFSET_C;
 
 float VOLTAGE_PWM_FULL_SCALE = 400.0f; // Default full-scale voltage for measured PWM output
 
@@ -23,9 +23,20 @@ float OVER_VOLTAGE_LIMIT = 285.0f;  // Disable if output exceeds this
 
 // --- IGBT PWM configuration ---
 float  IGBT_PWM_FREQ_HZ = 500.0f;; // Global PWM frequency (Hz)
+bool   IGBT_PWM_DITHER  = false;   // Sigma-delta duty dither on TIM3 CH2
 const uint8_t IGBT_PWM_RESOLUTION_BITS = 12;      // 12-bit resolution 
 
 // Load model / IGBT guard rails
 float MIN_LOAD_RES_OHM   = 0.010f;  // Ω
 float IGBT_MIN_DUTY_PCT  = 5.0f;    // %
-float IGBT_MAX_DUTY_PCT  = 95.0f;   // %
\ No newline at end of file
+float IGBT_MAX_DUTY_PCT  = 95.0f;   // %
+
+// Current regulator
+float PI_KP  = 0.00012f;  // duty / A
+float PI_KI  = 0.001f;    // duty / (A*s)
+float PI_KAW = 2000.0f;   // 1/s
+
+// SCR crowbar
+float SCR_FIRE_CURRENT_A = 4000.0f;   // A
+float SCR_PULSE_DELAY_US = 0.0f;      // µs
+float SCR_PULSE_WIDTH_US = 50.0f;     // µs
\ No newline at end of file
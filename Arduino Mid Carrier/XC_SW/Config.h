@@ -29,15 +29,50 @@
 
 
 // PWM parameters (defined in Config.cpp)
+#define DISPLAY_PWM_FREQ_HZ  10000.0f  // TIM1 measured-value outputs
 extern float  IGBT_PWM_FREQ_HZ;        // e.g. 85000.0
+extern bool   IGBT_PWM_DITHER;         // Dithered duty: +4 bits, for 50-100 kHz
 extern const uint8_t IGBT_PWM_RESOLUTION_BITS; // 12-bit 
 
+// --- ADC scan (TIM6-triggered, DMA circular, hardware oversampling) ---
+#define ADC_SCAN_RATE_HZ      20000U  // Scan frames per second
+#define ADC_SCAN_OVERSAMPLE   16U     // Hardware oversampling ratio (result stays 12-bit)
+#define ADC_SCAN_DEPTH        8U      // Frames held in each circular buffer
+
+// --- Scheduler (TIM7 base tick, tasks run from its interrupt) ---
+#define CONTROL_RATE_HZ       20000U  // Base tick: control + measurement
+#define TEMPERATURE_RATE_HZ   10U     // Internal temperature task
+#define OUTPUTS_RATE_HZ       1000U   // Lamp/relay/SCR digital outputs
+
+// --- Interrupt priorities (NVIC preemption level, 0 = most urgent) ---
+// Protection first, then the control tick. Host traffic sits below both, so
+// RPC and JSON work (RPC thread) delays the tick only by its critical
+// sections. Those are short (register writes, snapshot copies) except in
+// param_store_save(), which stops the M4 with interrupts off for its flash
+// erase/program and is therefore refused while the output is enabled.
+#define IRQ_PRIO_FAST_TRIP    0U      // ADC_IRQn: watchdog trips, SCR pulse
+#define IRQ_PRIO_CONTROL      1U      // TIM7_IRQn: scheduler tick
+#define IRQ_PRIO_COMMS        8U      // HSEM2_IRQn: RPC doorbell from the M7
+#define CONTROL_LATENCY_BUDGET_NS  2000U  // Tick entry later than this is journaled
+
+// --- Loop profiling (DWT cycle counter); 0 compiles it out entirely ---
+#ifndef XC_LOOP_PROFILE
+#define XC_LOOP_PROFILE       0
+#endif
+
 
 // --- Input Logic (Adjust if using active-low sensors) ---
 #define HW_INPUT_ACTIVE_STATE HIGH
 #define HW_INPUT_PIN_MODE     INPUT_PULLDOWN // Or INPUT_PULLUP if active-low
 
 // --- Calibration Constants (!!! REPLACE WITH ACTUAL VALUES !!!) ---
+// Power-on defaults; the runtime values below start from these and are
+// changed over RPC. Call sensor_conv_update() after changing any of them.
+constexpr float DEFAULT_VSCALE_V  = 1113.0f;
+constexpr float DEFAULT_VOFFSET_V = -322.0f;
+constexpr float DEFAULT_VSCALE_C  = 0.0f;
+constexpr float DEFAULT_VOFFSET_C = 0.0f;
+
 extern float VScale_V;
 extern float VOffset_V;
 extern float VScale_C;
@@ -61,6 +96,16 @@ extern float MIN_LOAD_RES_OHM;     // e.g. 0.010 Ω (cold)
 extern float IGBT_MIN_DUTY_PCT;    // e.g. 5 %  (too-short ON guard)
 extern float IGBT_MAX_DUTY_PCT;    // e.g. 95 % (too-short OFF guard)
 
+// --- Current regulator (PI on top of the V/R feedforward) ---
+extern float PI_KP;                // duty per amp of error
+extern float PI_KI;                // duty per amp-second
+extern float PI_KAW;               // back-calculation anti-windup gain (1/s)
+
+// --- SCR crowbar (hardware-timed pulse, see ScrPulse.h) ---
+extern float SCR_FIRE_CURRENT_A;   // Probe current that fires the SCR
+extern float SCR_PULSE_DELAY_US;   // Watchdog event to start of gate pulse
+extern float SCR_PULSE_WIDTH_US;   // Gate pulse length
+
 
 
 // Centralized power state manager
@@ -0,0 +1,11 @@
+#ifndef CRC32_H
+#define CRC32_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// IEEE 802.3 CRC-32 (same result as Python's zlib.crc32).
+// Pass a previous result as `crc` to continue over several buffers.
+uint32_t crc32(const uint8_t* data, size_t len, uint32_t crc = 0);
+
+#endif // CRC32_H
@@ -1,16 +1,195 @@
 #include "CurrWaveform.h"
 #include "Config.h"
 #include "PowerState.h"
+#include "Crc32.h"
+#include "EventLog.h"
 #include <Arduino.h>
+#include "stm32h7xx_hal.h"
+
+// ----- Profiles -----
+// Segments are evaluated once per control tick from the TIM7 interrupt, so
+// the setpoint is timed by the scheduler and a profile of WAVE_MAX_TICKS
+// costs no more RAM than a short one. Uploads always go to the shadow slot;
+// the scheduler swaps it in only while no run is in progress, so a shot
+// never mixes two profiles.
+struct WaveProfile {
+    WaveSegment segs[WAVE_MAX_SEGMENTS];
+    uint32_t    ticks[WAVE_MAX_SEGMENTS];   // Control ticks per segment
+    float       inv_ticks[WAVE_MAX_SEGMENTS];
+    uint8_t     count;
+    uint32_t    generation;
+};
+
+static WaveProfile       s_profiles[2] = {};
+static volatile uint8_t  s_active = 0;
+static volatile bool     s_shadow_ready = false;
+static uint32_t          s_next_generation = 1;
+static volatile bool     s_running = false;
+static volatile bool     s_rejected = false;
+
+// ----- Playback position (control tick only) -----
+static uint8_t           s_seg = 0;
+static uint32_t          s_seg_tick = 0;
+static uint32_t          s_play_tick = 0;
 
 // cubic helper
 static inline float poly3(float A, float B, float C, float D, float s) {
     return ((D * s + C) * s + B) * s + A;
 }
 
-void update_curr_waveform(float dt) {
-    static float t = 0.0f;
-    static bool running = false;
+static inline float segment_value(const WaveSegment& g, float s) {
+    switch (g.type) {
+        case WAVE_SEG_LINEAR: return g.a + (g.b - g.a) * s;
+        case WAVE_SEG_CUBIC:  return poly3(g.a, g.b, g.c, g.d, s);
+        default:              return g.a;
+    }
+}
+
+static inline uint32_t segment_ticks(const WaveSegment& g) {
+    return (uint32_t)lroundf(g.duration_s * (float)CONTROL_RATE_HZ);
+}
+
+static inline uint32_t get_le32(const uint8_t* p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static inline float get_lef(const uint8_t* p) {
+    const uint32_t u = get_le32(p);
+    float f;
+    memcpy(&f, &u, sizeof(f));
+    return f;
+}
+
+// Setpoint at the current playback position; false once past the end
+static bool playback_value(const WaveProfile& p, float& y) {
+    while (s_seg < p.count && s_seg_tick >= p.ticks[s_seg]) {
+        ++s_seg;
+        s_seg_tick = 0;
+    }
+    if (s_seg >= p.count) return false;
+
+    y = segment_value(p.segs[s_seg], (float)s_seg_tick * p.inv_ticks[s_seg]);
+    if (y < 0.0f) y = 0.0f;
+    return true;
+}
+
+// --- Public API -----------------------------------------------------------
+
+void init_curr_waveform() {
+    const uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    s_profiles[0].count = s_profiles[1].count = 0;
+    s_shadow_ready = false;
+    s_running = false;
+    __set_PRIMASK(primask);
+}
+
+// Valid segment list no longer than WAVE_MAX_TICKS
+static bool profile_valid(const WaveSegment* segs, uint8_t count) {
+    if (segs == nullptr || count == 0 || count > WAVE_MAX_SEGMENTS) return false;
+
+    uint32_t total = 0;
+    for (uint8_t i = 0; i < count; ++i) {
+        if (segs[i].type > WAVE_SEG_CUBIC || !(segs[i].duration_s >= 0.0f)) return false;
+        if (segs[i].duration_s > WAVE_MAX_DURATION_S) return false;
+        total += segment_ticks(segs[i]);
+        if (total > WAVE_MAX_TICKS) return false;
+    }
+    return true;
+}
+
+uint32_t curr_waveform_load(const WaveSegment* segs, uint8_t count) {
+    // Validate and size first so a rejected profile changes nothing
+    if (!profile_valid(segs, count)) {
+        s_rejected = true;
+        return 0;
+    }
+
+    // Take the shadow slot away from the scheduler while it is rewritten
+    const uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    s_shadow_ready = false;
+    WaveProfile& p = s_profiles[s_active ^ 1U];
+    __set_PRIMASK(primask);
+
+    for (uint8_t i = 0; i < count; ++i) {
+        const uint32_t n = segment_ticks(segs[i]);
+        p.segs[i]      = segs[i];
+        p.ticks[i]     = n;
+        p.inv_ticks[i] = (n > 0) ? 1.0f / (float)n : 0.0f;
+    }
+    p.count      = count;
+    p.generation = s_next_generation++;
+
+    s_shadow_ready = true;
+    s_rejected = false;
+    return p.generation;
+}
+
+static int32_t parse_blob(const uint8_t* data, size_t len) {
+    const size_t header = 4, seg_size = 24, trailer = 4;
+    if (data == nullptr || len < header + trailer) return WAVE_ERR_FORMAT;
+
+    const uint16_t magic = (uint16_t)(data[0] | (data[1] << 8));
+    const uint8_t  count = data[3];
+    if (magic != WAVE_BLOB_MAGIC || data[2] != WAVE_BLOB_VERSION) return WAVE_ERR_FORMAT;
+    if (count == 0 || count > WAVE_MAX_SEGMENTS) return WAVE_ERR_FORMAT;
+    if (len != header + (size_t)count * seg_size + trailer) return WAVE_ERR_FORMAT;
+
+    if (crc32(data, len - trailer) != get_le32(data + len - trailer)) return WAVE_ERR_CRC;
+
+    WaveSegment segs[WAVE_MAX_SEGMENTS];
+    for (uint8_t i = 0; i < count; ++i) {
+        const uint8_t* p = data + header + (size_t)i * seg_size;
+        segs[i].type       = p[0];
+        segs[i].duration_s = get_lef(p + 4);
+        segs[i].a          = get_lef(p + 8);
+        segs[i].b          = get_lef(p + 12);
+        segs[i].c          = get_lef(p + 16);
+        segs[i].d          = get_lef(p + 20);
+    }
+
+    const uint32_t gen = curr_waveform_load(segs, count);
+    return gen ? (int32_t)gen : WAVE_ERR_PROFILE;
+}
+
+int32_t curr_waveform_load_blob(const uint8_t* data, size_t len) {
+    const int32_t res = parse_blob(data, len);
+    if (res < 0) s_rejected = true;
+    return res;
+}
+
+int32_t curr_waveform_load_legacy() {
+    float t1     = PowerState::currT1;     if (t1     < 0.0f) t1     = 0.0f;
+    float t_hold = PowerState::currTHold;  if (t_hold < 0.0f) t_hold = 0.0f;
+    float t2     = PowerState::currT2;     if (t2     < 0.0f) t2     = 0.0f;
+
+    const float a1 = PowerState::currA1, b1 = PowerState::currB1;
+    const float c1 = PowerState::currC1, d1 = PowerState::currD1;
+
+    // Rise cubic, hold at its end value, fall cubic
+    const WaveSegment segs[3] = {
+        { WAVE_SEG_CUBIC, t1,     a1, b1, c1, d1 },
+        { WAVE_SEG_HOLD,  t_hold, poly3(a1, b1, c1, d1, 1.0f), 0.0f, 0.0f, 0.0f },
+        { WAVE_SEG_CUBIC, t2,     PowerState::currA2, PowerState::currB2,
+                                  PowerState::currC2, PowerState::currD2 },
+    };
+    const uint32_t gen = curr_waveform_load(segs, 3);
+    return gen ? (int32_t)gen : WAVE_ERR_PROFILE;
+}
+
+bool curr_waveform_rejected() { return s_rejected; }
+
+uint32_t curr_waveform_generation() {
+    const uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    const uint32_t gen = s_shadow_ready ? s_profiles[s_active ^ 1U].generation
+                                        : s_profiles[s_active].generation;
+    __set_PRIMASK(primask);
+    return gen;
+}
+
+void update_curr_waveform() {
     static bool prevOutputEnabled = false;
     static bool prevChargeRelayOn = false;
 
@@ -21,78 +200,63 @@ void update_curr_waveform(float dt) {
     // relay is OFF. Also allow starting when the charge relay transitions from
     // ON→OFF while the output remains enabled.
     const bool chargeRelayJustDisabled = prevChargeRelayOn && !chargeRelayOn;
-    if (outEn && !chargeRelayOn && !running &&
+
+    // Between runs: adopt a freshly uploaded profile
+    if (!s_running && s_shadow_ready) {
+        s_active ^= 1U;
+        s_shadow_ready = false;
+    }
+
+    if (outEn && !chargeRelayOn && !s_running &&
         (!prevOutputEnabled || chargeRelayJustDisabled)) {
-        t = 0.0f;
-        running = true;
+        s_running = true;
+        s_seg = 0;
+        s_seg_tick = 0;
+        s_play_tick = 0;
+        float first = 0.0f;
+        playback_value(s_profiles[s_active], first);
+        event_log_add(EVT_WAVE_START, 0, first);
     }
 
+    prevOutputEnabled = outEn;
+    prevChargeRelayOn = chargeRelayOn;
+
     // Abort immediately if output is disabled mid-run
     // or if the charge relay turns ON while a waveform is executing.
-    if ((!outEn || chargeRelayOn) && running) {
-        running = false;
+    if ((!outEn || chargeRelayOn) && s_running) {
+        event_log_add(EVT_WAVE_ABORT,
+                      (uint16_t)((!outEn ? EVT_ABORT_OUTPUT_OFF : 0U) |
+                                 (chargeRelayOn ? EVT_ABORT_CHARGER_ON : 0U)),
+                      PowerState::setCurrent);
+        s_running = false;
         PowerState::setCurrent = 0.0f;
         PowerState::runCurrentWave = false; // status only
-        prevOutputEnabled = outEn;
-        prevChargeRelayOn = chargeRelayOn;
         return;
     }
 
     // Publish status flag (status, not a control)
-    PowerState::runCurrentWave = running;
+    PowerState::runCurrentWave = s_running;
 
-    if (!running) {
+    if (!s_running) {
         PowerState::setCurrent = 0.0f;
-        prevOutputEnabled = outEn;
-        prevChargeRelayOn = chargeRelayOn;
         return;
     }
 
-    // --- segment timing ---
-    float t1     = PowerState::currT1;     if (t1     < 0.0f) t1     = 0.0f;
-    float t_hold = PowerState::currTHold;  if (t_hold < 0.0f) t_hold = 0.0f;
-    float t2     = PowerState::currT2;     if (t2     < 0.0f) t2     = 0.0f;
-
-    const float T2_EPS = 1e-6f;                  // ensure we enter ramp-down branch
-    const float t2_eff = (t2 <= 0.0f) ? T2_EPS : t2;
-
-    const float t2_start = t1 + t_hold;
-    const float t_end    = t2_start + t2_eff;
-
-    // --- evaluate waveform (NO locals named D1/D2!) ---
-    float y_raw = 0.0f;
-
-    if (t < t1) {
-        const float s = (t1 > 0.0f) ? (t / t1) : 1.0f;
-        y_raw = poly3(PowerState::currA1, PowerState::currB1,
-                      PowerState::currC1, PowerState::currD1, s);
-    } else if (t < t2_start) {
-        // Hold: end value of the first polynomial
-        y_raw = poly3(PowerState::currA1, PowerState::currB1,
-                      PowerState::currC1, PowerState::currD1, 1.0f);
-    } else if (t < t_end) {
-        const float s = (t - t2_start) / t2_eff;
-        y_raw = poly3(PowerState::currA2, PowerState::currB2,
-                      PowerState::currC2, PowerState::currD2, s);
-    } else {
-        // Finished
-        running = false;
+    // Finished (also covers an empty profile)
+    float y;
+    if (!playback_value(s_profiles[s_active], y)) {
+        event_log_add(EVT_WAVE_END, 0, (float)s_play_tick);
+        s_running = false;
         PowerState::runCurrentWave = false; // status
         PowerState::setCurrent = 0.0f;
-        prevOutputEnabled = outEn;
-        prevChargeRelayOn = chargeRelayOn;
         return;
     }
 
-    // Clamp and publish
-    float y = y_raw;
-    if (y < 0.0f) y = 0.0f;
+    // Clamp and publish (the limit can change after the upload)
     if (y > CURRENT_LIMIT_MAX) y = CURRENT_LIMIT_MAX;
     PowerState::setCurrent = y;
 
     // Advance time base
-    if (dt < 0.0f) dt = 0.0f;
-    t += dt;
-    prevOutputEnabled = outEn;
-    prevChargeRelayOn = chargeRelayOn;
+    ++s_seg_tick;
+    ++s_play_tick;
 }
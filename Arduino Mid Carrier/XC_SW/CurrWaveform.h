@@ -1,6 +1,62 @@
 #ifndef CURR_WAVEFORM_H
 #define CURR_WAVEFORM_H
 
-void update_curr_waveform(float dt);
+#include "Config.h"
 
-#endif // CURR_WAVEFORM_H
\ No newline at end of file
+#define WAVE_MAX_SEGMENTS    64
+#define WAVE_MAX_DURATION_S  10.0f   // Covers three 3000 ms legacy segments
+#define WAVE_MAX_TICKS       ((uint32_t)(WAVE_MAX_DURATION_S * CONTROL_RATE_HZ))
+
+// load_waveform blob: u16 magic, u8 version, u8 count,
+// count x { u8 type, u8 pad[3], f32 duration_s, f32 a, b, c, d },
+// then u32 CRC-32 of everything before it (all little-endian)
+#define WAVE_BLOB_MAGIC    0x5746   // "FW"
+#define WAVE_BLOB_VERSION  1
+
+// Negative results of curr_waveform_load_blob()
+#define WAVE_ERR_FORMAT   (-1)
+#define WAVE_ERR_CRC      (-2)
+#define WAVE_ERR_PROFILE  (-3)
+
+enum WaveSegType : uint8_t {
+  WAVE_SEG_HOLD   = 0,   // y = a
+  WAVE_SEG_LINEAR = 1,   // y = a + (b - a) * s
+  WAVE_SEG_CUBIC  = 2    // y = a + b*s + c*s^2 + d*s^3
+};
+
+// One piece of the current profile; s runs 0 → 1 over duration_s
+struct WaveSegment {
+  uint8_t type;          // WaveSegType
+  float   duration_s;
+  float   a, b, c, d;
+};
+
+// Reset both profile slots (nothing armed)
+void init_curr_waveform();
+
+// Validate segments into the shadow profile. The shadow is swapped in at
+// the next idle tick, never during a run. Returns the new generation ID,
+// or 0 if the profile is invalid or longer than WAVE_MAX_TICKS (nothing
+// is armed).
+uint32_t curr_waveform_load(const WaveSegment* segs, uint8_t count);
+
+// Validate and load a load_waveform blob.
+// Returns the generation ID (> 0) or a WAVE_ERR_* code.
+int32_t curr_waveform_load_blob(const uint8_t* data, size_t len);
+
+// Rebuild from the legacy PowerState::curr* rise/hold/fall coefficients.
+// Returns the generation ID (> 0) or WAVE_ERR_PROFILE.
+int32_t curr_waveform_load_legacy();
+
+// True while the newest upload (blob or legacy) was rejected; the profile
+// armed before it is still the one that plays. Cleared by the next load
+// that is accepted.
+bool curr_waveform_rejected();
+
+// Generation of the profile the next run will play
+uint32_t curr_waveform_generation();
+
+// Advance the waveform by one control tick (1 / CONTROL_RATE_HZ)
+void update_curr_waveform();
+
+#endif // CURR_WAVEFORM_H
@@ -13,6 +13,11 @@ void init_current();
 // Reads ADC, scales, and updates the global actual_current
 void update_current();
 
+// Current samples taken since boot: one per IGBT period while phase-locked
+// (held in between), one per tick otherwise. The regulator steps once per
+// new sample.
+uint32_t current_sample_count();
+
 // RPC getter function
 float get_curr_act();
 
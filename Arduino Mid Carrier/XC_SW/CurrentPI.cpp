@@ -0,0 +1,123 @@
+#include "CurrentPI.h"
+#include <Arduino.h>
+#include <string.h>
+#include "stm32h7xx_hal.h"
+
+// ----- Regulator state -----
+// Gains are held in fixed point so a step is a handful of 32x32->64 MACs.
+// The integrator keeps 16 extra fraction bits (1.0 duty == 2^32) so that
+// small errors at up to 20 kHz still accumulate instead of rounding away.
+static int32_t s_kp_q31     = 0;   // Kp, duty per amp
+static int32_t s_ki_dt_q31  = 0;   // Ki * dt, duty per amp per step
+static int32_t s_kaw_dt_q31 = 0;   // Kaw * dt, back-calculation per step
+static int64_t s_integ      = 0;   // Q32.32 duty
+
+static const int64_t INTEG_LIMIT = 2LL << 32;   // +/- 2.0 duty
+
+// ----- Debug tap -----
+// Single producer (scheduler interrupt), single consumer (RPC thread)
+struct PiLogSample {
+  uint32_t time_us;
+  float    curr_set;
+  float    error;
+  float    duty;
+};
+
+static PiLogSample       s_log[PI_LOG_DEPTH];
+static volatile uint32_t s_log_head = 0;
+static volatile uint32_t s_log_tail = 0;
+static volatile uint32_t s_log_dropped = 0;
+static uint32_t          s_log_div = 0;
+static volatile uint32_t s_log_decimation = 1;   // Steps per logged sample
+
+static inline int32_t gain_to_q31(float gain) {
+  if (!(gain > 0.0f)) return 0;
+  if (gain >= 0.999f) gain = 0.999f;
+  return (int32_t)(gain * 2147483648.0f);
+}
+
+static inline q16_t clamp_q16(q16_t x, q16_t lo, q16_t hi) {
+  return x < lo ? lo : (x > hi ? hi : x);
+}
+
+static void log_sample(q16_t i_set, q16_t err, q16_t duty) {
+  if (++s_log_div < s_log_decimation) return;
+  s_log_div = 0;
+
+  const uint32_t head = s_log_head;
+  if (head - s_log_tail >= PI_LOG_DEPTH) { s_log_dropped++; return; }
+
+  PiLogSample& s = s_log[head & (PI_LOG_DEPTH - 1U)];
+  s.time_us  = micros();
+  s.curr_set = q16_to_float(i_set);
+  s.error    = q16_to_float(err);
+  s.duty     = q16_to_float(duty);
+  s_log_head = head + 1U;
+}
+
+// --- Public API -----------------------------------------------------------
+
+void current_pi_apply_gains() {
+  // The regulator steps once per IGBT period when that is longer than a tick
+  const float rate = (IGBT_PWM_FREQ_HZ > 0.0f && IGBT_PWM_FREQ_HZ < (float)CONTROL_RATE_HZ)
+                         ? IGBT_PWM_FREQ_HZ : (float)CONTROL_RATE_HZ;
+  const float dt = 1.0f / rate;
+  const uint32_t log_decimation = (rate > (float)PI_LOG_RATE_HZ) ? (uint32_t)(rate / (float)PI_LOG_RATE_HZ) : 1U;
+
+  // Kp in Q31 too: at Q16 the 1.2e-4 duty/A default would be 7 codes
+  const int32_t kp_q31     = gain_to_q31(PI_KP);
+  const int32_t ki_dt_q31  = gain_to_q31(PI_KI * dt);
+  const int32_t kaw_dt_q31 = gain_to_q31(PI_KAW * dt);
+
+  // Called from the RPC thread: the tick sees the old set or the new one
+  const uint32_t primask = __get_PRIMASK();
+  __disable_irq();
+  s_kp_q31     = kp_q31;
+  s_ki_dt_q31  = ki_dt_q31;
+  s_kaw_dt_q31 = kaw_dt_q31;
+  s_log_decimation = log_decimation;
+  __set_PRIMASK(primask);
+}
+
+void current_pi_reset() {
+  s_integ = 0;
+}
+
+q16_t current_pi_update(q16_t i_set, q16_t i_meas, q16_t ff_duty) {
+  const q16_t err = i_set - i_meas;
+
+  int64_t p = ((int64_t)err * s_kp_q31) >> 31;
+  if (p >  4 * Q16_ONE) p =  4 * Q16_ONE;
+  if (p < -4 * Q16_ONE) p = -4 * Q16_ONE;
+
+  const q16_t u = ff_duty + (q16_t)p + (q16_t)(s_integ >> 16);
+  const q16_t u_sat = clamp_q16(u, 0, Q16_ONE);
+
+  // Integrate the error, and bleed off whatever the actuator could not deliver
+  s_integ += ((int64_t)err * s_ki_dt_q31) >> 15;
+  s_integ += ((int64_t)(u_sat - u) * s_kaw_dt_q31) >> 15;
+  if (s_integ >  INTEG_LIMIT) s_integ =  INTEG_LIMIT;
+  if (s_integ < -INTEG_LIMIT) s_integ = -INTEG_LIMIT;
+
+  log_sample(i_set, err, u_sat);
+  return u_sat;
+}
+
+std::vector<uint8_t> current_pi_log_drain(uint16_t max_samples) {
+  const uint32_t head = s_log_head;
+  uint32_t tail = s_log_tail;
+  uint32_t n = head - tail;
+  if (n > max_samples) n = max_samples;
+
+  std::vector<uint8_t> out(n * sizeof(PiLogSample));
+  for (uint32_t i = 0; i < n; ++i, ++tail) {
+    // Cortex-M and the bridge are both little-endian
+    memcpy(&out[i * sizeof(PiLogSample)], &s_log[tail & (PI_LOG_DEPTH - 1U)], sizeof(PiLogSample));
+  }
+  s_log_tail = tail;
+  return out;
+}
+
+uint32_t current_pi_log_dropped() {
+  return s_log_dropped;
+}
@@ -0,0 +1,39 @@
+#ifndef CURRENT_PI_H
+#define CURRENT_PI_H
+
+#include "Config.h"
+#include <vector>
+
+// Q16.16 fixed point: 1.0 == 65536
+typedef int32_t q16_t;
+#define Q16_ONE  65536
+
+#define PI_LOG_DEPTH       256   // Samples held for the bridge (power of two)
+#define PI_LOG_RATE_HZ     1000  // Debug tap rate (every step when the regulator is slower)
+
+// Recompute the fixed-point gains from PI_KP / PI_KI / PI_KAW for the
+// regulator rate, min(CONTROL_RATE_HZ, IGBT_PWM_FREQ_HZ). Call after
+// changing any of them or the IGBT frequency.
+void current_pi_apply_gains();
+
+// Clear the integrator (output inhibited or waveform idle)
+void current_pi_reset();
+
+// One regulator step (once per new current sample, see update_igbt()).
+// All arguments in Q16.16:
+// setpoint and measurement in amps, feedforward as normalized duty.
+// Returns the duty (0..Q16_ONE) with back-calculation anti-windup applied.
+q16_t current_pi_update(q16_t i_set, q16_t i_meas, q16_t ff_duty);
+
+// Drain the debug tap: little-endian records of
+//   u32 time_us, f32 curr_set, f32 error, f32 duty
+// oldest first, at most max_samples per call.
+std::vector<uint8_t> current_pi_log_drain(uint16_t max_samples);
+
+// Samples dropped because the bridge did not drain in time
+uint32_t current_pi_log_dropped();
+
+static inline q16_t float_to_q16(float x) { return (q16_t)(x * (float)Q16_ONE); }
+static inline float q16_to_float(q16_t x) { return (float)x * (1.0f / (float)Q16_ONE); }
+
+#endif // CURRENT_PI_H
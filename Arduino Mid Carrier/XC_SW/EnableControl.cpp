@@ -1,5 +1,7 @@
 #include "EnableControl.h"
 #include "PowerState.h"
+#include "ScrPulse.h"
+#include "EventLog.h"
 
 void init_enable_control() {
   pinMode(DPIN_ENABLE_IN, HW_INPUT_PIN_MODE);    // External enable input
@@ -28,7 +30,9 @@ void update_enable_inputs() {
   PowerState::externalEnable = (digitalRead(DPIN_ENABLE_IN) == HW_INPUT_ACTIVE_STATE);
 
   // Combined logic: both internal and external must be true
-  PowerState::outputEnabled = PowerState::externalEnable && PowerState::internalEnable;
+  const bool enabled = PowerState::externalEnable && PowerState::internalEnable;
+  if (enabled != PowerState::outputEnabled) event_log_add(EVT_OUTPUT_ENABLE, enabled ? 1U : 0U);
+  PowerState::outputEnabled = enabled;
 }
 
 void update_enable_outputs() {
@@ -56,7 +60,9 @@ void update_enable_outputs() {
   digitalWrite(DPIN_DUMP_FAN,      PowerState::DumpFan      ? LOW : HIGH);
   digitalWrite(DPIN_DUMP_RELAY,    PowerState::DumpRelay    ? LOW : HIGH);
   digitalWrite(DPIN_CHARGER_RELAY, PowerState::ChargerRelay ? LOW : HIGH); 
-  digitalWrite(DPIN_SCR_TRIG,      PowerState::ScrTrig      ? LOW : HIGH);
+  if (!scr_pulse_ready()) {   // Otherwise PF6 belongs to TIM16
+    digitalWrite(DPIN_SCR_TRIG,    PowerState::ScrTrig      ? LOW : HIGH);
+  }
   digitalWrite(DPIN_SCR_INHIB,     PowerState::ScrInhib     ? LOW : HIGH);
 
 }
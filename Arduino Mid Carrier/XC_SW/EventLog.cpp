@@ -0,0 +1,82 @@
+#include "EventLog.h"
+#include "PowerState.h"
+#include <Arduino.h>
+#include <string.h>
+#include "stm32h7xx_hal.h"
+
+static_assert((EVENT_LOG_DEPTH & (EVENT_LOG_DEPTH - 1U)) == 0, "depth must be a power of two");
+static_assert(sizeof(EventRecord) == 24, "event record is 24 bytes on the wire");
+
+// ----- Journal -----
+// tag == seq + 1 once an entry is complete, 0 while it is being written
+struct EventSlot {
+  volatile uint32_t tag;
+  EventRecord       rec;
+};
+
+static EventSlot         s_slots[EVENT_LOG_DEPTH];
+static volatile uint32_t s_head = 0;   // Next seq to hand out
+
+// --- Public API -----------------------------------------------------------
+
+void event_log_add(EventCode code, uint16_t arg, float value) {
+  // LDREX/STREX loop on the M4: a preempting producer just takes the next slot
+  const uint32_t seq = __atomic_fetch_add(&s_head, 1U, __ATOMIC_RELAXED);
+  EventSlot& s = s_slots[seq & (EVENT_LOG_DEPTH - 1U)];
+
+  s.tag = 0U;
+  __DMB();
+  s.rec.seq     = seq;
+  s.rec.time_us = micros();
+  s.rec.code    = (uint16_t)code;
+  s.rec.arg     = arg;
+  s.rec.value   = value;
+  s.rec.volt    = PowerState::probeVoltageOutput;
+  s.rec.curr    = PowerState::probeCurrent;
+  __DMB();
+  s.tag = seq + 1U;
+}
+
+uint32_t event_log_head() { return s_head; }
+
+std::vector<uint8_t> event_log_read(uint32_t cursor, uint16_t max_records) {
+  // Entries more than a ring behind the head are gone; a cursor past the
+  // head comes from before a restart
+  uint32_t head = s_head;
+  if (head - cursor > EVENT_LOG_DEPTH) cursor = (head > EVENT_LOG_DEPTH) ? head - EVENT_LOG_DEPTH : 0U;
+  uint32_t first = cursor;
+
+  std::vector<uint8_t> out(12U);
+  uint16_t n = 0;
+  while (n < max_records && cursor != head) {
+    const EventSlot& s = s_slots[cursor & (EVENT_LOG_DEPTH - 1U)];
+    const uint32_t tag = s.tag;
+    if (tag != cursor + 1U) {
+      // Still being written (the next call picks it up), or lapped since
+      // `head` was read: then skip to the oldest entry left
+      if (tag == 0U || (int32_t)(tag - (cursor + 1U)) < 0 || n) break;
+      head = s_head;
+      cursor = first = head - EVENT_LOG_DEPTH;
+      continue;
+    }
+
+    EventRecord r;
+    __DMB();
+    memcpy(&r, (const void*)&s.rec, sizeof(r));
+    __DMB();
+    if (s.tag != tag) break;   // Overwritten during the copy
+
+    const size_t at = out.size();
+    out.resize(at + sizeof(r));
+    memcpy(&out[at], &r, sizeof(r));   // Cortex-M and the bridge are both little-endian
+    ++n;
+    ++cursor;
+  }
+
+  out[0] = EVENT_LOG_VERSION;
+  out[1] = (uint8_t)sizeof(EventRecord);
+  memcpy(&out[2], &n, 2);
+  memcpy(&out[4], &first, 4);
+  memcpy(&out[8], &cursor, 4);
+  return out;
+}
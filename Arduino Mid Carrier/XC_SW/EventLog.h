@@ -0,0 +1,59 @@
+#ifndef EVENT_LOG_H
+#define EVENT_LOG_H
+
+#include "Config.h"
+#include <vector>
+
+// Journal of faults and interlock changes, written from the control tick
+// and from ADC_IRQn. A producer claims a slot with one atomic increment
+// and publishes it by writing its sequence tag last, so no producer waits
+// for another and interrupts stay enabled. The oldest entries are
+// overwritten once EVENT_LOG_DEPTH are outstanding.
+#define EVENT_LOG_DEPTH    256U   // Entries kept (power of two)
+#define EVENT_LOG_VERSION  1
+
+enum EventCode : uint16_t {
+  EVT_HW_TRIP = 1,        // arg: TRIP_HW_* bits, value: trips since boot
+  EVT_TRIP_CLEAR,         // arg: TRIP_* bits that were latched
+  EVT_SW_OVERVOLTAGE,     // update_igbt() inhibit set, value: probeVoltageFast
+  EVT_SW_OVERVOLTAGE_END,
+  EVT_IGBT_FAULT,         // Gate-driver fault input asserted
+  EVT_IGBT_FAULT_END,
+  EVT_OUTPUT_ENABLE,      // arg: new outputEnabled (both enables)
+  EVT_WAVE_START,         // value: first setpoint, A
+  EVT_WAVE_END,           // Played to the end, value: ticks played
+  EVT_WAVE_ABORT,         // arg: EVT_ABORT_* bits, value: setCurrent at abort
+  EVT_SCR_FIRE,           // value: firings since boot
+  EVT_TICK_LATE           // Control tick entered over budget, value: latency ns
+};
+
+#define EVT_ABORT_OUTPUT_OFF  (1U << 0)   // outputEnabled dropped mid-run
+#define EVT_ABORT_CHARGER_ON  (1U << 1)   // Charger relay closed mid-run
+
+// One entry, as sent to the host (little-endian, 24 bytes). volt and curr
+// are probeVoltageOutput and probeCurrent when the event was logged.
+struct EventRecord {
+  uint32_t seq;       // Entries logged before this one
+  uint32_t time_us;   // micros()
+  uint16_t code;      // EventCode
+  uint16_t arg;
+  float    value;
+  float    volt;
+  float    curr;
+};
+
+// Log one event; callable from any context, including ADC_IRQn
+void event_log_add(EventCode code, uint16_t arg = 0, float value = 0.0f);
+
+// Entries logged since boot (the next seq)
+uint32_t event_log_head();
+
+// Entries from `cursor` on, at most max_records, as a blob of
+//   u8 version, u8 record size, u16 count, u32 first seq returned,
+//   u32 next cursor, then count EventRecords
+// first > cursor means the entries in between were overwritten, first <
+// cursor that the M4 restarted. Stops at an entry still being written;
+// the next call picks it up.
+std::vector<uint8_t> event_log_read(uint32_t cursor, uint16_t max_records);
+
+#endif // EVENT_LOG_H
@@ -0,0 +1,104 @@
+#include "FastTrip.h"
+#include "AdcScan.h"
+#include "IGBT.h"
+#include "ScrPulse.h"
+#include "EventLog.h"
+#include "SensorConv.h"
+#include <Arduino.h>
+#include "stm32h7xx_hal.h"
+
+// ----- Trip latch -----
+// Written from ADC_IRQn (priority 0, above the scheduler) and read from the
+// control task and RPC thread.
+static volatile uint32_t s_status = 0;
+static volatile uint32_t s_count = 0;
+
+// --- Helpers --------------------------------------------------------------
+
+// Thresholds go through the same coefficients as the measurements; an
+// uncalibrated (zero-gain) probe leaves its watchdog window wide open
+static void arm_voltage() {
+  uint16_t high = 4095U;
+  if (VScale_V > 0.0f) high = sensor_units_to_raw(SENSOR_VOLTAGE, OVER_VOLTAGE_LIMIT, 4095U);
+  adc_scan_set_watchdog(ADC_SCAN_VOLTAGE, 0U, high);
+}
+
+static void arm_current() {
+  // Bidirectional probe: trip on either side of the window
+  uint16_t low = 0U, high = 4095U;
+  if (VScale_C > 0.0f) {
+    const float limit = CURRENT_LIMIT_MAX * FAST_TRIP_CURRENT_MARGIN;
+    low  = sensor_units_to_raw(SENSOR_CURRENT, -limit, 0U);
+    high = sensor_units_to_raw(SENSOR_CURRENT,  limit, 4095U);
+  }
+  adc_scan_set_watchdog(ADC_SCAN_CURRENT, low, high);
+}
+
+// --- Public API -----------------------------------------------------------
+
+void init_fast_trip() {
+  NVIC_SetVector(ADC_IRQn, (uint32_t)(uintptr_t)&fast_trip_isr);
+  HAL_NVIC_SetPriority(ADC_IRQn, IRQ_PRIO_FAST_TRIP, 0);
+  HAL_NVIC_EnableIRQ(ADC_IRQn);
+  fast_trip_apply_thresholds();
+}
+
+void fast_trip_apply_thresholds() {
+  // A latched watchdog stays masked until fast_trip_clear()
+  const uint32_t st = s_status;
+  if (!(st & TRIP_HW_OVERVOLTAGE)) arm_voltage();
+  if (!(st & TRIP_HW_OVERCURRENT)) arm_current();
+  // The SCR fire window uses the same current calibration
+  scr_pulse_apply_threshold();
+}
+
+void fast_trip_isr() {
+  const uint32_t events = adc_scan_take_watchdog_events();
+  uint32_t reason = 0;
+  if (events & (1U << ADC_SCAN_VOLTAGE)) reason |= TRIP_HW_OVERVOLTAGE;
+  if (events & (1U << ADC_SCAN_CURRENT)) reason |= TRIP_HW_OVERCURRENT;
+
+  // Kill the gate first, then start the crowbar pulse, bookkeeping last
+  if (reason) igbt_force_off();
+  const bool fired = (events & ADC_SCAN_EVENT_SCR) && scr_pulse_fire();
+
+  if (reason) {
+    s_status |= reason;
+    s_count++;
+    event_log_add(EVT_HW_TRIP, (uint16_t)reason, (float)s_count);
+  }
+  if (fired) scr_pulse_log_fire();
+}
+
+bool fast_trip_active() {
+  return (s_status & TRIP_HW_MASK) != 0;
+}
+
+void fast_trip_note(uint32_t reason) {
+  const uint32_t primask = __get_PRIMASK();
+  __disable_irq();
+  s_status |= reason;
+  __set_PRIMASK(primask);
+}
+
+uint32_t fast_trip_status() { return s_status; }
+uint32_t fast_trip_count()  { return s_count; }
+
+uint32_t fast_trip_clear() {
+  const uint32_t primask = __get_PRIMASK();
+  __disable_irq();
+  const uint32_t was = s_status;
+  s_status = 0;
+  __set_PRIMASK(primask);
+  if (was) event_log_add(EVT_TRIP_CLEAR, (uint16_t)was);
+
+  // Re-arm first: if the fault is still present the watchdog fires again
+  // straight away and the output never comes back
+  if (was & TRIP_HW_OVERVOLTAGE) arm_voltage();
+  if (was & TRIP_HW_OVERCURRENT) arm_current();
+
+  __disable_irq();
+  if (!fast_trip_active()) igbt_release_force_off();
+  __set_PRIMASK(primask);
+  return was;
+}
@@ -0,0 +1,43 @@
+#ifndef FAST_TRIP_H
+#define FAST_TRIP_H
+
+#include "Config.h"
+
+// Latched trip reasons (fast_trip_status())
+#define TRIP_HW_OVERVOLTAGE   (1U << 0)   // ADC1 AWD1 on the voltage probe
+#define TRIP_HW_OVERCURRENT   (1U << 1)   // ADC1 AWD2 on the current probe
+#define TRIP_SW_OVERVOLTAGE   (1U << 2)   // update_igbt() filtered check (informational)
+
+// Hardware trips block the IGBT until fast_trip_clear()
+#define TRIP_HW_MASK          (TRIP_HW_OVERVOLTAGE | TRIP_HW_OVERCURRENT)
+
+// Overcurrent trips this far above CURRENT_LIMIT_MAX so regulator overshoot
+// does not trip the hardware path
+#define FAST_TRIP_CURRENT_MARGIN  1.10f
+
+// Install the ADC watchdog interrupt and arm the thresholds.
+// Call after init_adc_scan() and init_igbt().
+void init_fast_trip();
+
+// Recompute the watchdog windows from OVER_VOLTAGE_LIMIT, CURRENT_LIMIT_MAX
+// and the voltage/current calibration, and the SCR fire window with them.
+// Call whenever any of them changes.
+void fast_trip_apply_thresholds();
+
+// ADC_IRQn entry (installed by init_fast_trip()); also hands AWD3 events
+// to scr_pulse_fire(). Order: gate off, SCR pulse, then logging.
+void fast_trip_isr();
+
+// True while a hardware trip is latched
+bool fast_trip_active();
+
+// Record a software-layer trip reason
+void fast_trip_note(uint32_t reason);
+
+uint32_t fast_trip_status();     // TRIP_* bits latched since the last clear
+uint32_t fast_trip_count();      // Hardware trips since boot
+
+// Clear the latch and re-arm the watchdogs. Returns the bits that were set.
+uint32_t fast_trip_clear();
+
+#endif // FAST_TRIP_H
@@ -0,0 +1,91 @@
+#include "Firmware.h"
+#include "PowerState.h"
+#include "Voltage.h"
+#include "Current.h"
+#include "Temperature.h"
+#include "EnableControl.h"
+#include "IGBT.h"
+#include "CurrWaveform.h"
+#include "AdcScan.h"
+#include "Scheduler.h"
+#include "LoopProfile.h"
+#include "CurrentPI.h"
+#include "FastTrip.h"
+#include "ScrPulse.h"
+#include "SignalFilter.h"
+#include "Notify.h"
+#include "Scope.h"
+#include "Telemetry.h"
+#include "ParamStore.h"
+#if !defined(XC_SIM_SERIAL_COMMS) || XC_SIM_SERIAL_COMMS
+#include "SerialComms.h"
+#endif
+
+// --- Scheduler tasks (run from the TIM7 interrupt) ---
+static void measure_task() {
+  PROFILE_STAGE(PROF_VOLTAGE, update_voltage());
+  PROFILE_STAGE(PROF_CURRENT, update_current());
+}
+
+static void control_task() {
+  power_state_apply_requests();
+  PROFILE_STAGE(PROF_ENABLE_INPUTS, update_enable_inputs());
+  PROFILE_STAGE(PROF_WAVEFORM,      update_curr_waveform());
+  PROFILE_STAGE(PROF_IGBT,          update_igbt());
+  // One flag word per tick for both taps
+  const PowerSnapshot& snap = power_state_publish();
+  const uint16_t flags = telemetry_flags(snap);
+  notify_sample(flags);
+  scope_sample(snap, flags);
+}
+
+static void temperature_task() {
+  PROFILE_STAGE(PROF_TEMPERATURE, update_temperature());
+}
+
+static void outputs_task() {
+  PROFILE_STAGE(PROF_OUTPUTS, update_enable_outputs());
+}
+
+// --- Public API -----------------------------------------------------------
+
+void init_firmware() {
+#if XC_LOOP_PROFILE
+  init_loop_profile();
+#endif
+
+  // Stored calibration and limits first: the inits below read them
+  init_param_store();
+
+#if !defined(XC_SIM_SERIAL_COMMS) || XC_SIM_SERIAL_COMMS
+  init_serial_comms();
+#endif
+
+  init_filters();
+  init_notify();
+  init_scope();
+
+  init_voltage();
+  init_current();
+  init_temperature();
+  init_enable_control();
+
+  // Must follow the measurement inits: puts the probe pins back in analog mode
+  init_adc_scan();
+
+  PROFILE_STAGE(PROF_IGBT_INIT, init_igbt());
+  current_pi_apply_gains();
+  init_fast_trip();
+  init_scr_pulse();
+
+  init_curr_waveform();
+  // A rejected profile is reported in the telemetry flags (TLM_FLAG_WAVE_REJECTED)
+  curr_waveform_load_legacy();
+
+  // Registration order is execution order within a tick
+  sched_add_task("measure",     1,                                      measure_task);
+  sched_add_task("control",     1,                                      control_task);
+  sched_add_task("temperature", CONTROL_RATE_HZ / TEMPERATURE_RATE_HZ,  temperature_task);
+  sched_add_task("outputs",     CONTROL_RATE_HZ / OUTPUTS_RATE_HZ,      outputs_task);
+  init_scheduler();
+}
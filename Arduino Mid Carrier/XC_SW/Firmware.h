@@ -0,0 +1,13 @@
+#ifndef FIRMWARE_H
+#define FIRMWARE_H
+
+#include "Config.h"
+
+// Bring-up shared by setup() and the host sim (XC_SW_Sim), so both run
+// the same modules in the same order: the stored parameters, every
+// module's init, the default waveform, then the scheduler task table
+// (measure, control, temperature, outputs) started on TIM7.
+// init_serial_comms() is skipped in a sim built without ArduinoJson.
+void init_firmware();
+
+#endif // FIRMWARE_H
@@ -1,13 +1,24 @@
 #include "IGBT.h"
 #include "Config.h"
 #include "PowerState.h"
+#include "CurrentPI.h"
+#include "Current.h"
+#include "FastTrip.h"
+#include "EventLog.h"
 #include <Arduino.h>
-#include "stm32h7xx_hal.h"
+#include "TimerManager.h"
+#include "AdcScan.h"
 #include <math.h>
 
 // ----- TIM3 (PC7 / CH2) state -----
-static TIM_HandleTypeDef s_tim3 = {};
-static bool              s_pwm_started = false; 
+static PwmChannel    s_pwm = {};   // ccr == nullptr until the timer runs
+static PwmChannel    s_adc_trig = {};   // CH4: ADC2 trigger
+static volatile bool s_forced_off = false;
+static volatile float s_duty = 0.0f;   // Last duty put on CH2 (0..1)
+static bool          s_fault_prev = false;
+static bool          s_ov_prev = false;
+static uint32_t      s_pi_sample = 0;   // current_sample_count() at the last PI step
+static float         s_min_residual = 0.0f;   // Duty owed below the minimum pulse
 
 // --- Helpers --------------------------------------------------------------
 
@@ -23,119 +34,116 @@ static inline float clamp_with_deadbands_0to1(float x) {
   return x;
 }
 
-static inline uint32_t duty_to_ccr(float duty_norm) {
-  if (duty_norm <= 0.0f) return 0U;
-  uint32_t arr = __HAL_TIM_GET_AUTORELOAD(&s_tim3);
-  uint32_t ccr = (uint32_t)(duty_norm * (float)(arr + 1U) + 0.5f);
-  if (ccr > arr) ccr = arr;
-  return ccr;
+// Dither on/off as configured; a failed start leaves the plain CCR drive
+static int apply_drive_mode() {
+  if (!IGBT_PWM_DITHER) {
+    pwm_dither_stop(s_pwm);
+    return 1;
+  }
+  return pwm_dither_start(s_pwm);
 }
 
 static inline void pwm_off() {
-  if (s_pwm_started) __HAL_TIM_SET_COMPARE(&s_tim3, TIM_CHANNEL_2, 0U);
+  s_duty = 0.0f;
+  pwm_set_ccr(s_pwm, 0U);
 }
 
 static inline void pwm_full_on() {
-  if (!s_pwm_started) return;
-  const uint32_t arr = __HAL_TIM_GET_AUTORELOAD(&s_tim3);
-  __HAL_TIM_SET_COMPARE(&s_tim3, TIM_CHANNEL_2, arr);
+  s_duty = 1.0f;
+  pwm_set_ccr(s_pwm, pwm_period_ticks(s_pwm));
+}
+
+void igbt_force_off() {
+  s_forced_off = true;
+  pwm_force_inactive(s_pwm, true);
+  pwm_off();
+}
+
+void igbt_release_force_off() {
+  pwm_off();
+  pwm_force_inactive(s_pwm, false);
+  s_forced_off = false;
 }
 
 bool igbt_fault_active() {
   return (digitalRead(DPIN_GATE_FAULT) == LOW);
 }
 
+float igbt_applied_duty() { return s_duty; }
+
 bool igbt_drive_is_low() {
-  if (!s_pwm_started) {
+  if (!s_pwm.ccr) {
     return true;
   }
 
   return (HAL_GPIO_ReadPin(GPIOC, GPIO_PIN_7) == GPIO_PIN_RESET);
 }
 
+bool igbt_enable_trgo_from_pwm() {
+  if (!s_pwm.ccr) return false;
+  s_adc_trig = pwm_claim(PWM_OUT_IGBT_ADC_TRIG);
+  if (!s_adc_trig.ccr) return false;
+
+  // PWM1, center-aligned: OC4REF is high only while CNT < 1, so it rises
+  // once per period as the counter reaches 0, regardless of the gate duty
+  pwm_set_ccr(s_adc_trig, 1U);
+
+  TIM_MasterConfigTypeDef mcfg = {};
+  mcfg.MasterOutputTrigger = TIM_TRGO_OC4REF;
+  mcfg.MasterSlaveMode     = TIM_MASTERSLAVEMODE_DISABLE;
+  if (HAL_TIMEx_MasterConfigSynchronization(pwm_timer_handle(PWM_TIM3), &mcfg) != HAL_OK) return false;
+
+  return adc_scan_start_pwm_sync();
+}
+
 void init_igbt() {
   // Fault input
   pinMode(DPIN_GATE_FAULT, INPUT_PULLUP);
 
-  // Clocks & GPIO for TIM3_CH2 on PC7 (AF2)
-  __HAL_RCC_GPIOC_CLK_ENABLE();
-  __HAL_RCC_TIM3_CLK_ENABLE();
-
-  GPIO_InitTypeDef gpio = {};
-  gpio.Pin       = GPIO_PIN_7;
-  gpio.Mode      = GPIO_MODE_AF_PP;
-  gpio.Pull      = GPIO_NOPULL;
-  gpio.Speed     = GPIO_SPEED_FREQ_HIGH;
-  gpio.Alternate = GPIO_AF2_TIM3;
-  HAL_GPIO_Init(GPIOC, &gpio);
-
-  // --- NEW: DYNAMIC FREQUENCY CALCULATION ---
-  if (IGBT_PWM_FREQ_HZ <= 0.0f) {
-    s_pwm_started = false;
-    return; // Cannot configure with zero or negative frequency
-  }
-
-  const uint32_t timer_clock_hz = 200000000; // Known TIM3 clock on Portenta
-  // For center-aligned mode, the total period ticks = clock / (2 * frequency)
-  uint32_t total_period_ticks = (uint32_t)(timer_clock_hz / (2.0f * IGBT_PWM_FREQ_HZ));
+  // Center-aligned TIM3 at IGBT_PWM_FREQ_HZ; CH2 drives PC7
+  if (pwm_timer_start(PWM_TIM3, IGBT_PWM_FREQ_HZ) != 1) return;
+  s_pwm = pwm_claim(PWM_OUT_IGBT_HS);
+  apply_drive_mode();
+  igbt_enable_trgo_from_pwm();
 
-  uint32_t psc = 0;
-  uint32_t arr = 0;
+  // Keep a latched trip in force
+  if (s_forced_off) pwm_force_inactive(s_pwm, true);
+}
 
-  // TIM3 is a 16-bit timer, so ARR and PSC must be <= 65535.
-  // This loop finds the smallest prescaler (psc) that allows the
-  // auto-reload register (arr) to fit within the 16-bit limit.
-  while (true) {
-    arr = (total_period_ticks / (psc + 1)) - 1;
-    if (arr <= 65535) {
-      break; // Found a valid combination
-    }
-    psc++;
-    // If psc is also too large, the requested frequency is too low to be possible.
-    if (psc > 65535) {
-      s_pwm_started = false;
-      return;
-    }
+int igbt_apply_config() {
+  if (!pwm_timer_running(PWM_TIM3)) {
+    init_igbt();
+    return pwm_timer_running(PWM_TIM3) ? 1 : PWM_ERR_FREQ;
   }
-  // --- END OF DYNAMIC CALCULATION ---
-
-  s_tim3.Instance               = TIM3;
-  s_tim3.Init.Prescaler         = psc; // Use calculated prescaler
-  s_tim3.Init.CounterMode       = TIM_COUNTERMODE_CENTERALIGNED1;
-  s_tim3.Init.Period            = arr; // Use calculated period
-  s_tim3.Init.ClockDivision     = TIM_CLOCKDIVISION_DIV1;
-  s_tim3.Init.RepetitionCounter = 0;
-  s_tim3.Init.AutoReloadPreload = TIM_AUTORELOAD_PRELOAD_DISABLE;
-  if (HAL_TIM_PWM_Init(&s_tim3) != HAL_OK) { s_pwm_started = false; return; }
-
-  TIM_OC_InitTypeDef oc = {};
-  oc.OCMode       = TIM_OCMODE_PWM1;
-  oc.Pulse        = 0U;
-  oc.OCPolarity   = TIM_OCPOLARITY_LOW;
-  oc.OCFastMode   = TIM_OCFAST_DISABLE;
-  oc.OCIdleState  = TIM_OCIDLESTATE_RESET;
-  if (HAL_TIM_PWM_ConfigChannel(&s_tim3, &oc, TIM_CHANNEL_2) != HAL_OK) { s_pwm_started = false; return; }
-
-  if (HAL_TIM_PWM_Start(&s_tim3, TIM_CHANNEL_2) != HAL_OK) { s_pwm_started = false; return; }
-
-  __HAL_TIM_SET_PRESCALER(&s_tim3, psc);
-  __HAL_TIM_SET_AUTORELOAD(&s_tim3, arr);
-  __HAL_TIM_SET_COMPARE(&s_tim3, TIM_CHANNEL_2, 0U);
-
-  s_pwm_started = true;
+  const int rc = pwm_timer_retune(PWM_TIM3, IGBT_PWM_FREQ_HZ);
+  if (rc != 1) return rc;
+  pwm_set_ccr(s_adc_trig, 1U);   // The retune rescales it with the rest
+  return apply_drive_mode();
 }
 
 // --- UPDATED FOR TESTING ---
 void update_igbt() {
-  if (!s_pwm_started) return;
+  if (!s_pwm.ccr) return;
 
   // Latch and publish the gate-driver fault
   const bool fault = igbt_fault_active();
   PowerState::IgbtFaultState = fault;
+  if (fault != s_fault_prev) event_log_add(fault ? EVT_IGBT_FAULT : EVT_IGBT_FAULT_END);
+  s_fault_prev = fault;
+
+  // Software layer behind the ADC watchdog trip: same limit on the protection channel
+  const bool over_voltage = (PowerState::probeVoltageFast >= OVER_VOLTAGE_LIMIT);
+  if (over_voltage) fast_trip_note(TRIP_SW_OVERVOLTAGE);
+  if (over_voltage != s_ov_prev) {
+    event_log_add(over_voltage ? EVT_SW_OVERVOLTAGE : EVT_SW_OVERVOLTAGE_END, 0,
+                  PowerState::probeVoltageFast);
+  }
+  s_ov_prev = over_voltage;
 
-  // Hard inhibits: fault, not enabled, or over-voltage
-  if (fault || !PowerState::outputEnabled ||
-      (PowerState::probeVoltageOutput >= OVER_VOLTAGE_LIMIT)) {
+  // Hard inhibits: hardware trip, fault, not enabled, or over-voltage
+  if (s_forced_off || fault || !PowerState::outputEnabled || over_voltage) {
+    current_pi_reset();
+    s_min_residual = 0.0f;
     pwm_off();
     return;
   }
@@ -143,10 +151,19 @@ void update_igbt() {
   // “Running” if waveform is armed/running OR a non-zero set current exists
   const bool running = (PowerState::runCurrentWave || (PowerState::setCurrent > 0.0f));
   if (!running) {
+    current_pi_reset();
+    s_min_residual = 0.0f;
     pwm_off();
     return;
   }
 
+  // One regulator step per new current sample. Below CONTROL_RATE_HZ the
+  // sample and the duty both change once per IGBT period, so stepping every
+  // tick would only integrate the same error again.
+  const uint32_t samples = current_sample_count();
+  if (samples == s_pi_sample) return;
+  s_pi_sample = samples;
+
   // Predict maximum deliverable current at 100% duty
   float v_bank = PowerState::probeVoltageOutput;
   if (v_bank < 0.0f) v_bank = 0.0f;
@@ -156,6 +173,7 @@ void update_igbt() {
 
   // No headroom → don’t drive
   if (I_pred_max <= 0.0f) {
+    current_pi_reset();
     pwm_off();
     return;
   }
@@ -165,22 +183,32 @@ void update_igbt() {
   if (I_set < 0.0f)              I_set = 0.0f;
   if (I_set > CURRENT_LIMIT_MAX) I_set = CURRENT_LIMIT_MAX;
 
-  // Upper duty limit from available headroom (0..1)
-  float duty_upper = I_set / I_pred_max;
-  duty_upper = clamp01(duty_upper);
+  // Feedforward from the V/R model: duty that would deliver I_set into R_min
+  const q16_t ff = float_to_q16(clamp01(I_set / I_pred_max));
 
-  // If measured current already exceeds the setpoint, stop pushing
-  const bool above_target = (PowerState::probeCurrent > I_set);
-  float duty_preset = above_target ? 0.0f : duty_upper;   // normalized 0..1
+  // PI trims the feedforward toward the measured current
+  const q16_t duty_q16 = current_pi_update(float_to_q16(I_set),
+                                           float_to_q16(PowerState::probeCurrent), ff);
 
   // Safety windows
-  const float preset_pct = duty_preset * 100.0f;
+  const float preset_pct = q16_to_float(duty_q16) * 100.0f;
 
   if (preset_pct < IGBT_MIN_DUTY_PCT) {
-    // Avoid too-short ON pulses near zero
-    pwm_off();
+    // Avoid too-short ON pulses near zero: deliver the average as whole
+    // minimum-width pulses (first-order sigma-delta), so a small request
+    // is neither lost nor left for the integrator to wind up on
+    const float min_duty = IGBT_MIN_DUTY_PCT * 0.01f;
+    s_min_residual += q16_to_float(duty_q16);
+    if (s_min_residual >= min_duty) {
+      s_min_residual -= min_duty;
+      s_duty = min_duty;
+      pwm_set_duty(s_pwm, min_duty);
+    } else {
+      pwm_off();
+    }
     return;
   }
+  s_min_residual = 0.0f;
 
   if (preset_pct > IGBT_MAX_DUTY_PCT) {
     // Force 100% (still respects center-aligned PWM)
@@ -189,7 +217,8 @@ void update_igbt() {
   }
 
   // Normal drive (optionally apply soft deadbands)
-  float duty_norm = clamp_with_deadbands_0to1(duty_preset);
-  __HAL_TIM_SET_COMPARE(&s_tim3, TIM_CHANNEL_2, duty_to_ccr(duty_norm)); 
+  float duty_norm = clamp_with_deadbands_0to1(q16_to_float(duty_q16));
+  s_duty = duty_norm;
+  pwm_set_duty(s_pwm, duty_norm);
  
 }
\ No newline at end of file
@@ -11,19 +11,37 @@
 void init_igbt();
 
 
+// Apply a changed IGBT_PWM_FREQ_HZ or IGBT_PWM_DITHER: retuned in place
+// while TIM3 runs (no re-init of the live output). Returns 1 or a
+// PWM_ERR_* code.
+int igbt_apply_config();
+
+
 // Update IGBT HI PWM with clamping and fault inhibit
 void update_igbt();
 
 
+// Force TIM3 CH2 to its inactive level right now (interrupt-safe). The
+// output stays off, even across init_igbt(), until igbt_release_force_off().
+void igbt_force_off();
+void igbt_release_force_off();
+
+
 // Read the (active‑low) IGBT gate fault input
 bool igbt_fault_active();
 
 
+// Duty last applied to the gate (0..1), after the safety windows
+float igbt_applied_duty();
+
+
 // NEW: true when the actual gate drive pin is logic LOW
 bool igbt_drive_is_low();
 
 
-// NEW: expose a one‑time setup that makes TIM3 publish OC2REF on TRGO
+// Make TIM3 publish OC4REF on TRGO, one rising edge per period at the
+// counter valley (the middle of the gate on-pulse), and start the ADC2
+// current conversion it triggers. Done by init_igbt(); true once running.
 bool igbt_enable_trgo_from_pwm();
 
 
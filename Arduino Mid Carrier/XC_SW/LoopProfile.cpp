@@ -0,0 +1,85 @@
+#include "LoopProfile.h"
+
+#if XC_LOOP_PROFILE
+
+#include <Arduino.h>
+#include <string.h>
+
+struct StageStats {
+  uint32_t count;
+  uint32_t min;
+  uint32_t max;
+  uint64_t sum;
+  uint32_t hist[PROF_HIST_BINS];
+};
+
+static StageStats s_stats[PROF_NUM_STAGES];
+
+static void clear_stats() {
+  memset(s_stats, 0, sizeof(s_stats));
+  for (uint8_t i = 0; i < PROF_NUM_STAGES; ++i) s_stats[i].min = 0xFFFFFFFFu;
+}
+
+static inline void put_u32(std::vector<uint8_t>& out, uint32_t v) {
+  out.push_back((uint8_t)(v));
+  out.push_back((uint8_t)(v >> 8));
+  out.push_back((uint8_t)(v >> 16));
+  out.push_back((uint8_t)(v >> 24));
+}
+
+void init_loop_profile() {
+  CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+  DWT->CYCCNT = 0;
+  DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+  clear_stats();
+}
+
+void loop_profile_record(ProfileStage stage, uint32_t cycles) {
+  if (stage >= PROF_NUM_STAGES) return;
+  StageStats& s = s_stats[stage];
+
+  s.count++;
+  s.sum += cycles;
+  if (cycles < s.min) s.min = cycles;
+  if (cycles > s.max) s.max = cycles;
+
+  uint32_t bin = 31U - (uint32_t)__builtin_clz(cycles | 1U);
+  if (bin >= PROF_HIST_BINS) bin = PROF_HIST_BINS - 1;
+  s.hist[bin]++;
+}
+
+void reset_loop_profile() {
+  // Stages are recorded from the scheduler interrupt; keep it out while clearing
+  const uint32_t primask = __get_PRIMASK();
+  __disable_irq();
+  clear_stats();
+  __set_PRIMASK(primask);
+}
+
+std::vector<uint8_t> get_loop_profile() {
+  StageStats copy[PROF_NUM_STAGES];
+  const uint32_t primask = __get_PRIMASK();
+  __disable_irq();
+  memcpy(copy, s_stats, sizeof(copy));
+  __set_PRIMASK(primask);
+
+  std::vector<uint8_t> out;
+  out.reserve(8 + PROF_NUM_STAGES * (4 + PROF_HIST_BINS) * 4);
+  out.push_back(1);                 // version
+  out.push_back(PROF_NUM_STAGES);
+  out.push_back(PROF_HIST_BINS);
+  out.push_back(0);
+  put_u32(out, SystemCoreClock);
+
+  for (uint8_t i = 0; i < PROF_NUM_STAGES; ++i) {
+    const StageStats& s = copy[i];
+    put_u32(out, s.count);
+    put_u32(out, s.count ? s.min : 0U);
+    put_u32(out, s.max);
+    put_u32(out, s.count ? (uint32_t)(s.sum / s.count) : 0U);
+    for (uint8_t b = 0; b < PROF_HIST_BINS; ++b) put_u32(out, s.hist[b]);
+  }
+  return out;
+}
+
+#endif // XC_LOOP_PROFILE
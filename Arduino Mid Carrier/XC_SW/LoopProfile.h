@@ -0,0 +1,57 @@
+#ifndef LOOP_PROFILE_H
+#define LOOP_PROFILE_H
+
+#include "Config.h"
+
+// Stages timed with the DWT cycle counter
+enum ProfileStage : uint8_t {
+  PROF_ENABLE_INPUTS = 0,
+  PROF_VOLTAGE,
+  PROF_CURRENT,
+  PROF_TEMPERATURE,
+  PROF_WAVEFORM,
+  PROF_IGBT,
+  PROF_OUTPUTS,
+  PROF_TICK,          // Whole scheduler interrupt
+  PROF_IGBT_INIT,     // init_igbt() and PWM frequency/mode changes from RPC
+  PROF_RPC_POLL,      // get_poll_data
+  PROF_RPC_EVENT,     // process_event_in_uc
+  PROF_RPC_GETTER,    // Scalar getters bound in init_serial_comms()
+  PROF_NUM_STAGES
+};
+
+#define PROF_HIST_BINS  20  // Bin i counts samples in [2^i, 2^(i+1)) cycles
+
+#if XC_LOOP_PROFILE
+
+#include <vector>
+#include "stm32h7xx_hal.h"
+
+// Enable the DWT cycle counter and clear all statistics
+void init_loop_profile();
+
+void loop_profile_record(ProfileStage stage, uint32_t cycles);
+void reset_loop_profile();
+
+// Packed little-endian blob:
+//   u8 version, u8 stages, u8 bins, u8 reserved, u32 cpu_hz,
+//   then per stage: u32 count, u32 min, u32 max, u32 mean, u32 hist[bins]
+std::vector<uint8_t> get_loop_profile();
+
+static inline uint32_t loop_profile_now() { return DWT->CYCCNT; }
+
+// Time a single statement as one stage
+#define PROFILE_STAGE(stage, stmt)                                         \
+  do {                                                                     \
+    const uint32_t _prof_t0 = loop_profile_now();                          \
+    stmt;                                                                  \
+    loop_profile_record((stage), loop_profile_now() - _prof_t0);           \
+  } while (0)
+
+#else
+
+#define PROFILE_STAGE(stage, stmt)  do { stmt; } while (0)
+
+#endif // XC_LOOP_PROFILE
+
+#endif // LOOP_PROFILE_H
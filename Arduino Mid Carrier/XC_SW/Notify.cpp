@@ -0,0 +1,96 @@
+#include "Notify.h"
+#include "Telemetry.h"
+#include <Arduino.h>
+#include <RPC.h>
+#include <math.h>
+
+// ----- State -----
+static volatile uint16_t s_edges = 0;        // Flag bits that changed since the last send
+static uint16_t          s_tick_flags = 0;   // Flags seen by the previous tick
+
+static volatile uint32_t s_heartbeat_ms = 0; // 0 = disabled
+static volatile bool     s_force = false;    // Send the next frame regardless
+static float             s_deadband[NOTIFY_NUM_ANALOG] = { 0.5f, 5.0f, 0.2f };
+
+static TelemetryFrame s_sent = {};           // Last frame pushed to Linux
+static uint32_t       s_last_send_ms = 0;
+static uint32_t       s_last_analog_ms = 0;
+static uint32_t       s_sent_count = 0;
+
+// --- Helpers --------------------------------------------------------------
+
+static inline bool moved(float now, float then, float band) {
+  return fabsf(now - then) >= band;
+}
+
+static uint32_t due_reasons(const TelemetryFrame& f, uint16_t edges, uint32_t now_ms) {
+  uint32_t reason = 0;
+  if (edges || f.flags != s_sent.flags) reason |= NOTIFY_REASON_FLAGS;
+  if (f.volt_set != s_sent.volt_set || f.curr_set != s_sent.curr_set) reason |= NOTIFY_REASON_SETPOINT;
+
+  if ((uint32_t)(now_ms - s_last_analog_ms) >= NOTIFY_ANALOG_MIN_MS &&
+      (moved(f.volt_act,    s_sent.volt_act,    s_deadband[NOTIFY_VOLT]) ||
+       moved(f.curr_act,    s_sent.curr_act,    s_deadband[NOTIFY_CURR]) ||
+       moved(f.temperature, s_sent.temperature, s_deadband[NOTIFY_TEMP]))) {
+    reason |= NOTIFY_REASON_ANALOG;
+  }
+
+  if (s_force || (uint32_t)(now_ms - s_last_send_ms) >= s_heartbeat_ms) reason |= NOTIFY_REASON_HEARTBEAT;
+  return reason;
+}
+
+// --- Public API -----------------------------------------------------------
+
+void init_notify() {
+  s_edges = 0;
+  s_tick_flags = 0;
+  s_heartbeat_ms = 0;
+  s_sent_count = 0;
+}
+
+void notify_sample(uint16_t flags) {
+  s_edges |= (uint16_t)(flags ^ s_tick_flags);
+  s_tick_flags = flags;
+}
+
+void notify_service() {
+  if (s_heartbeat_ms == 0) return;
+
+  TelemetryFrame f;
+  if (!telemetry_latest(f)) return;
+
+  const uint32_t now_ms = millis();
+  const uint16_t edges = s_edges;
+  const uint32_t reason = due_reasons(f, edges, now_ms);
+  if (!reason) return;
+
+  // Only the edges reported here are cleared; new ones from the tick stay
+  const uint32_t primask = __get_PRIMASK();
+  __disable_irq();
+  s_edges &= (uint16_t)~edges;
+  __set_PRIMASK(primask);
+
+  RPC.send(NOTIFY_RPC_NAME, telemetry_pack(f), reason, (uint32_t)edges);
+
+  s_sent = f;
+  s_force = false;
+  s_last_send_ms = now_ms;
+  if (reason & NOTIFY_REASON_ANALOG) s_last_analog_ms = now_ms;
+  s_sent_count++;
+}
+
+int notify_configure(uint32_t heartbeat_ms) {
+  if (heartbeat_ms != 0 && heartbeat_ms < NOTIFY_HEARTBEAT_MIN_MS) heartbeat_ms = NOTIFY_HEARTBEAT_MIN_MS;
+  s_force = true;   // Resync the subscriber with a full frame straight away
+  s_heartbeat_ms = heartbeat_ms;
+  return 1;
+}
+
+int notify_set_deadband(int channel, float deadband) {
+  if (channel < 0 || channel >= NOTIFY_NUM_ANALOG) return NOTIFY_ERR_CHANNEL;
+  if (!(deadband >= 0.0f)) return NOTIFY_ERR_PARAM;
+  s_deadband[channel] = deadband;
+  return 1;
+}
+
+uint32_t notify_sent_count() { return s_sent_count; }
@@ -0,0 +1,50 @@
+#ifndef NOTIFY_H
+#define NOTIFY_H
+
+#include "Config.h"
+
+// Change notifications pushed to the Linux bridge as
+//   RPC.send("m4_notify", telemetry frame bytes, reason, flag_edges)
+// instead of waiting to be polled. Off until the bridge has registered a
+// handler for "m4_notify" and called notify_configure().
+#define NOTIFY_RPC_NAME          "m4_notify"
+#define NOTIFY_HEARTBEAT_MS      1000U   // Default: frame at least this often
+#define NOTIFY_HEARTBEAT_MIN_MS  100U
+#define NOTIFY_ANALOG_MIN_MS     50U     // Analog-only changes at most 20 Hz
+
+// Reason bits of a notification
+#define NOTIFY_REASON_FLAGS      (1U << 0)   // A TLM_FLAG_* bit changed
+#define NOTIFY_REASON_ANALOG     (1U << 1)   // Measured value left its deadband
+#define NOTIFY_REASON_SETPOINT   (1U << 2)   // volt_set / curr_set changed
+#define NOTIFY_REASON_HEARTBEAT  (1U << 3)
+
+#define NOTIFY_ERR_CHANNEL  (-1)
+#define NOTIFY_ERR_PARAM    (-2)
+
+enum NotifyAnalog : uint8_t {
+  NOTIFY_VOLT = 0,   // volt_act, V
+  NOTIFY_CURR,       // curr_act, A
+  NOTIFY_TEMP,       // internal temperature, °C
+  NOTIFY_NUM_ANALOG
+};
+
+void init_notify();
+
+// Control tick, after power_state_publish(), with telemetry_flags() of the
+// snapshot: latch flag edges so a change that reverts before
+// notify_service() runs is still reported
+void notify_sample(uint16_t flags);
+
+// loop(): send one notification if anything is due
+void notify_service();
+
+// heartbeat_ms == 0 stops notifications; otherwise clamped to
+// NOTIFY_HEARTBEAT_MIN_MS. Returns 1.
+int notify_configure(uint32_t heartbeat_ms);
+
+// Returns 1 or a NOTIFY_ERR_* code
+int notify_set_deadband(int channel, float deadband);
+
+uint32_t notify_sent_count();
+
+#endif // NOTIFY_H
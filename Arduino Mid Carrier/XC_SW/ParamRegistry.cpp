@@ -0,0 +1,310 @@
+#include "ParamRegistry.h"
+#include "PowerState.h"
+#include "CurrWaveform.h"
+#include "SensorConv.h"
+#include "FastTrip.h"
+#include "CurrentPI.h"
+#include "IGBT.h"
+#include "ScrPulse.h"
+#include "LoopProfile.h"
+#include <float.h>
+#include <string.h>
+
+// ----- Descriptor table -----
+// On-change hooks, run once per call however many records asked for them
+// (in bit order: calibration before the trip thresholds derived from it)
+#define PARAM_HOOK_WAVEFORM  (1U << 0)   // Reload the legacy waveform
+#define PARAM_HOOK_SENSOR    (1U << 1)   // Re-fold the probe calibration
+#define PARAM_HOOK_TRIP      (1U << 2)   // Re-arm the ADC watchdog windows
+#define PARAM_HOOK_PI        (1U << 3)   // Re-derive the regulator gains
+#define PARAM_HOOK_IGBT      (1U << 4)   // Retune the IGBT PWM timer / drive mode
+#define PARAM_HOOK_SCR       (1U << 5)   // Re-program the SCR pulse and fire threshold
+
+enum ParamType : uint8_t {
+  PARAM_F32,     // float, clamped to [min, max]
+  PARAM_U32,     // unsigned long, clamped then rounded
+  PARAM_BOOL     // bool, nonzero = true
+};
+
+#define PARAM_RO       (1U << 0)   // Measured value: readable only
+#define PARAM_PERSIST  (1U << 1)   // Kept in the flash parameter store
+
+struct ParamDesc {
+  uint8_t        id;
+  uint8_t        type;
+  uint8_t        flags;
+  uint8_t        hooks;
+  const char*    name;
+  volatile void* target;
+  float          min, max;
+  void         (*set)(float);   // Write path instead of storing to target
+};
+
+// Measured values and setpoints read from a PowerState snapshot taken
+// before each read, so one batch is one control tick; setpoints are
+// written through the tick's request mailbox
+static PowerSnapshot s_view;
+
+#define P_F32(id, name, var, lo, hi, hooks)  { id, PARAM_F32,  0, hooks, name, &var, lo, hi, nullptr }
+#define P_U32(id, name, var, lo, hi)         { id, PARAM_U32,  PARAM_PERSIST, 0, name, &var, lo, hi, nullptr }
+#define P_SET(id, name, var, lo, hi, fn)     { id, PARAM_F32,  0, 0, name, &var, lo, hi, fn }
+#define P_BOOL(id, name, var)                { id, PARAM_BOOL, 0, 0, name, &var, 0.0f, 1.0f, nullptr }
+#define P_RO_F32(id, name, var)              { id, PARAM_F32,  PARAM_RO, 0, name, &var, -FLT_MAX, FLT_MAX, nullptr }
+#define P_RO_BOOL(id, name, var)             { id, PARAM_BOOL, PARAM_RO, 0, name, &var, 0.0f, 1.0f, nullptr }
+#define P_WAVE(id, name, var)                P_F32(id, name, var, -FLT_MAX, FLT_MAX, PARAM_HOOK_WAVEFORM)
+#define P_LIM(id, name, var, lo, hi, hooks)  { id, PARAM_F32,  PARAM_PERSIST, hooks, name, &var, lo, hi, nullptr }
+#define P_CFG(id, name, var, hooks)          { id, PARAM_BOOL, PARAM_PERSIST, hooks, name, &var, 0.0f, 1.0f, nullptr }
+#define P_CAL(id, name, var)                 P_LIM(id, name, var, -FLT_MAX, FLT_MAX, PARAM_HOOK_SENSOR | PARAM_HOOK_TRIP)
+
+// Ids as in config.json "signal_ids". Calibration, limits and drive
+// configuration (P_CAL, P_LIM, P_U32, P_CFG) are persisted by ParamStore.
+static constexpr ParamDesc s_params[] = {
+  P_SET    (0x04, "volt_set",               s_view.setVoltage,             0.0f, 285.0f,   power_state_request_voltage),
+  P_SET    (0x05, "curr_set",               s_view.setCurrent,             0.0f, 3600.0f,  power_state_request_current),
+  P_RO_F32 (0x06, "volt_act",               s_view.probeVoltageOutput),
+  P_RO_F32 (0x07, "curr_act",               s_view.probeCurrent),
+  P_BOOL   (0x09, "inter_enable",           PowerState::internalEnable),
+  P_BOOL   (0x0A, "extern_enable",          PowerState::externalEnable),
+  P_BOOL   (0x0B, "warn_lamp",              PowerState::warnLampTestState),
+  P_BOOL   (0x0C, "dump_relay",             PowerState::DumpRelay),
+  P_BOOL   (0x0D, "dump_fan",               PowerState::DumpFan),
+  P_BOOL   (0x0E, "charger_relay",          PowerState::ChargerRelay),
+  P_RO_BOOL(0x0F, "output_enable",          s_view.outputEnabled),
+  P_BOOL   (0x10, "scr_trig",               PowerState::ScrTrig),
+  P_BOOL   (0x11, "scr_inhib",              PowerState::ScrInhib),
+  P_RO_BOOL(0x12, "igbt_fault",             s_view.IgbtFaultState),
+  P_WAVE   (0x13, "t1",                     PowerState::currT1),
+  P_WAVE   (0x14, "th",                     PowerState::currTHold),
+  P_WAVE   (0x15, "t2",                     PowerState::currT2),
+  P_WAVE   (0x16, "a1",                     PowerState::currA1),
+  P_WAVE   (0x17, "b1",                     PowerState::currB1),
+  P_WAVE   (0x18, "c1",                     PowerState::currC1),
+  P_WAVE   (0x19, "d1",                     PowerState::currD1),
+  P_WAVE   (0x20, "a2",                     PowerState::currA2),
+  P_WAVE   (0x21, "b2",                     PowerState::currB2),
+  P_WAVE   (0x22, "c2",                     PowerState::currC2),
+  P_WAVE   (0x23, "d2",                     PowerState::currD2),
+  P_BOOL   (0x24, "run_current_wave",       PowerState::runCurrentWave),
+  P_RO_F32 (0x25, "internal_temperature",   s_view.internalTemperature),
+  P_RO_F32 (0x26, "internal_temperature_rate", s_view.internalTemperatureRate),
+  P_CAL    (0x27, "curr_scale",             VScale_C),
+  P_CAL    (0x28, "curr_offset",            VOffset_C),
+  P_CAL    (0x29, "volt_scale",             VScale_V),
+  P_CAL    (0x2A, "volt_offset",            VOffset_V),
+  P_LIM    (0x2B, "volt_pwm_full_scale",    VOLTAGE_PWM_FULL_SCALE, 1.0f,  FLT_MAX, 0),
+  P_LIM    (0x2C, "min_load_res_ohm",       MIN_LOAD_RES_OHM,       1e-6f, FLT_MAX, 0),
+  P_LIM    (0x2D, "igbt_min_duty_pct",      IGBT_MIN_DUTY_PCT,      0.0f,  100.0f,  0),
+  P_LIM    (0x2E, "igbt_max_duty_pct",      IGBT_MAX_DUTY_PCT,      0.0f,  100.0f,  0),
+  P_LIM    (0x2F, "pi_kp",                  PI_KP,                  0.0f,  1.0f,    PARAM_HOOK_PI),
+  P_LIM    (0x30, "pi_ki",                  PI_KI,                  0.0f,  FLT_MAX, PARAM_HOOK_PI),
+  P_LIM    (0x31, "pi_kaw",                 PI_KAW,                 0.0f,  FLT_MAX, PARAM_HOOK_PI),
+  P_LIM    (0x32, "current_limit_max",      CURRENT_LIMIT_MAX,      0.0f,  FLT_MAX, PARAM_HOOK_TRIP),
+  P_LIM    (0x33, "over_voltage_limit",     OVER_VOLTAGE_LIMIT,     0.0f,  FLT_MAX, PARAM_HOOK_TRIP),
+  P_LIM    (0x34, "warn_voltage_threshold", WARN_VOLTAGE_THRESHOLD, 0.0f,  FLT_MAX, 0),
+  P_U32    (0x35, "warn_blink_interval_ms", WARN_BLINK_INTERVAL_MS, 0.0f,  4.0e9f),
+  P_U32    (0x36, "debounce_delay_us",      DEBOUNCE_DELAY_US,      0.0f,  4.0e9f),
+  P_LIM    (0x37, "igbt_pwm_freq_hz",       IGBT_PWM_FREQ_HZ,       1.0f,  1.0e5f,  PARAM_HOOK_PI | PARAM_HOOK_IGBT),
+  P_CFG    (0x38, "igbt_pwm_dither",        IGBT_PWM_DITHER,        PARAM_HOOK_IGBT),
+  P_LIM    (0x39, "scr_fire_current_a",     SCR_FIRE_CURRENT_A,     0.0f,  FLT_MAX, PARAM_HOOK_SCR),
+  P_LIM    (0x3A, "scr_pulse_delay_us",     SCR_PULSE_DELAY_US,     0.0f,  5000.0f, PARAM_HOOK_SCR),
+  P_LIM    (0x3B, "scr_pulse_width_us",     SCR_PULSE_WIDTH_US,     0.1f,  1000.0f, PARAM_HOOK_SCR),
+};
+
+#define PARAM_COUNT  (sizeof(s_params) / sizeof(s_params[0]))
+#define PARAM_NONE   0xFFU
+
+// id -> index into s_params, built at compile time
+struct ParamIndex {
+  uint8_t idx[PARAM_ID_MAX + 1];
+};
+
+static constexpr ParamIndex make_param_index() {
+  ParamIndex t = {};
+  for (unsigned id = 0; id <= PARAM_ID_MAX; ++id) t.idx[id] = PARAM_NONE;
+  for (unsigned i = 0; i < PARAM_COUNT; ++i) t.idx[s_params[i].id] = (uint8_t)i;
+  return t;
+}
+
+static constexpr ParamIndex s_index = make_param_index();
+
+// --- Helpers --------------------------------------------------------------
+
+static const ParamDesc* find_id(uint8_t id) {
+  if (id > PARAM_ID_MAX || s_index.idx[id] == PARAM_NONE) return nullptr;
+  return &s_params[s_index.idx[id]];
+}
+
+static void store(const ParamDesc& d, float value) {
+  if (d.type == PARAM_BOOL) {
+    *(volatile bool*)d.target = (value != 0.0f);
+    return;
+  }
+  if (value < d.min) value = d.min;
+  if (value > d.max) value = d.max;
+  if (d.set)                    d.set(value);
+  else if (d.type == PARAM_U32) *(volatile unsigned long*)d.target = (unsigned long)(value + 0.5f);
+  else                     *(volatile float*)d.target = value;
+}
+
+static float load(const ParamDesc& d) {
+  switch (d.type) {
+    case PARAM_BOOL: return *(volatile bool*)d.target ? 1.0f : 0.0f;
+    case PARAM_U32:  return (float)*(volatile unsigned long*)d.target;
+    default:         return *(volatile float*)d.target;
+  }
+}
+
+// 1, PARAM_ERR_WAVEFORM if the waveform reload was rejected, or
+// PARAM_ERR_HARDWARE if the IGBT PWM could not be reconfigured (the other
+// hooks still run)
+static int run_hooks(uint8_t hooks) {
+  int res = 1;
+  if (hooks & PARAM_HOOK_WAVEFORM) {
+    if (curr_waveform_load_legacy() < 0) res = PARAM_ERR_WAVEFORM;
+  }
+  if (hooks & PARAM_HOOK_SENSOR)   sensor_conv_update();
+  if (hooks & PARAM_HOOK_TRIP)     fast_trip_apply_thresholds();
+  if (hooks & PARAM_HOOK_PI)       current_pi_apply_gains();
+  if (hooks & PARAM_HOOK_IGBT) {
+    int rc = 1;
+    PROFILE_STAGE(PROF_IGBT_INIT, rc = igbt_apply_config());
+    if (rc < 0) res = PARAM_ERR_HARDWARE;
+  }
+  if (hooks & PARAM_HOOK_SCR)      scr_pulse_apply_config();
+  return res;
+}
+
+// Values of the IGBT PWM parameters, to put back when the timer rejects
+// new ones: a setting the hardware cannot run must not be persisted
+static void save_igbt_params(float* prev) {
+  for (size_t i = 0; i < PARAM_COUNT; ++i) {
+    if (s_params[i].hooks & PARAM_HOOK_IGBT) prev[i] = load(s_params[i]);
+  }
+}
+
+static void restore_igbt_params(const float* prev) {
+  for (size_t i = 0; i < PARAM_COUNT; ++i) {
+    if (s_params[i].hooks & PARAM_HOOK_IGBT) store(s_params[i], prev[i]);
+  }
+  run_hooks(PARAM_HOOK_PI | PARAM_HOOK_IGBT);
+}
+
+static uint8_t* put_record(uint8_t* p, const ParamDesc& d) {
+  p[0] = d.id;
+  if (d.type == PARAM_F32) {
+    const float v = load(d);
+    p[1] = PARAM_WIRE_F32;
+    memcpy(p + 2, &v, sizeof(v));
+  } else {
+    const int32_t v = (d.type == PARAM_U32) ? (int32_t)*(volatile unsigned long*)d.target
+                                            : (*(volatile bool*)d.target ? 1 : 0);
+    p[1] = PARAM_WIRE_I32;
+    memcpy(p + 2, &v, sizeof(v));
+  }
+  return p + PARAM_BATCH_RECORD;
+}
+
+// --- Public API -----------------------------------------------------------
+
+int param_set(uint8_t id, float value) {
+  const ParamDesc* d = find_id(id);
+  if (!d || (d->flags & PARAM_RO)) return 0;
+  float prev[PARAM_COUNT];
+  save_igbt_params(prev);
+  store(*d, value);
+  const int res = run_hooks(d->hooks);
+  if (res == PARAM_ERR_HARDWARE) restore_igbt_params(prev);
+  return res;
+}
+
+int param_set_name(const char* name, float value) {
+  for (size_t i = 0; i < PARAM_COUNT; ++i) {
+    if (strcmp(name, s_params[i].name) == 0) return param_set(s_params[i].id, value);
+  }
+  return 0;
+}
+
+bool param_get(uint8_t id, float& value) {
+  const ParamDesc* d = find_id(id);
+  if (!d) return false;
+  power_state_snapshot(s_view);
+  value = load(*d);
+  return true;
+}
+
+// Store every usable record of a batch; the hooks they ask for are or-ed
+// into `hooks` for the caller to run
+static int apply_batch(const uint8_t* data, size_t len, uint8_t& hooks) {
+  if (len < PARAM_BATCH_HEADER || data[0] != PARAM_BATCH_VERSION) return PARAM_BATCH_ERR_FORMAT;
+  const size_t count = data[1];
+  if (len != PARAM_BATCH_HEADER + count * PARAM_BATCH_RECORD) return PARAM_BATCH_ERR_FORMAT;
+
+  int applied = 0;
+  const uint8_t* rec = data + PARAM_BATCH_HEADER;
+  for (size_t i = 0; i < count; ++i, rec += PARAM_BATCH_RECORD) {
+    const ParamDesc* d = find_id(rec[0]);
+    if (!d || (d->flags & PARAM_RO)) continue;
+
+    float value;
+    if (rec[1] == PARAM_WIRE_F32) {
+      memcpy(&value, rec + 2, sizeof(value));
+    } else if (rec[1] == PARAM_WIRE_I32) {
+      int32_t iv;
+      memcpy(&iv, rec + 2, sizeof(iv));
+      value = (float)iv;
+    } else {
+      continue;
+    }
+    if (value != value) continue;   // NaN
+
+    store(*d, value);
+    hooks |= d->hooks;
+    applied++;
+  }
+  return applied;
+}
+
+int param_set_many(const uint8_t* data, size_t len) {
+  float prev[PARAM_COUNT];
+  save_igbt_params(prev);
+  uint8_t hooks = 0;
+  const int applied = apply_batch(data, len, hooks);
+  if (applied <= 0) return applied;
+  const int res = run_hooks(hooks);
+  if (res == PARAM_ERR_HARDWARE) restore_igbt_params(prev);
+  return (res < 0) ? res : applied;
+}
+
+int param_load_many(const uint8_t* data, size_t len) {
+  uint8_t hooks = 0;
+  return apply_batch(data, len, hooks);
+}
+
+size_t param_get_many(const uint8_t* ids, size_t n, uint8_t* out) {
+  power_state_snapshot(s_view);
+  uint8_t* p = out + PARAM_BATCH_HEADER;
+  uint8_t count = 0;
+  if (n == 0) {
+    for (size_t i = 0; i < PARAM_COUNT; ++i, ++count) p = put_record(p, s_params[i]);
+  } else {
+    for (size_t i = 0; i < n && count < 0xFF; ++i) {
+      const ParamDesc* d = find_id(ids[i]);
+      if (!d) continue;
+      p = put_record(p, *d);
+      count++;
+    }
+  }
+  out[0] = PARAM_BATCH_VERSION;
+  out[1] = count;
+  return (size_t)(p - out);
+}
+
+size_t param_count() { return PARAM_COUNT; }
+
+size_t param_persistent_ids(uint8_t* ids, size_t max) {
+  size_t n = 0;
+  for (size_t i = 0; i < PARAM_COUNT && n < max; ++i) {
+    if (s_params[i].flags & PARAM_PERSIST) ids[n++] = s_params[i].id;
+  }
+  return n;
+}
@@ -0,0 +1,61 @@
+#ifndef PARAM_REGISTRY_H
+#define PARAM_REGISTRY_H
+
+#include "Config.h"
+
+// Every value Linux can read or write, addressed by the numeric ids the
+// bridge assigns in config.json ("signals" / "signal_ids"). One descriptor
+// table holds the target, type, clamp range and on-change hook, and drives
+// the batch RPCs as well as the name lookup of process_event_in_uc().
+#define PARAM_ID_MAX  0x3F
+
+// Batch wire format (little-endian), used both ways:
+//   u8 version, u8 count, then count records of
+//   u8 id, u8 type (PARAM_WIRE_*), 4-byte value
+#define PARAM_BATCH_VERSION  1
+#define PARAM_BATCH_HEADER   2
+#define PARAM_BATCH_RECORD   6
+
+#define PARAM_WIRE_F32  0
+#define PARAM_WIRE_I32  1
+
+#define PARAM_BATCH_ERR_FORMAT  (-1)
+#define PARAM_ERR_WAVEFORM      (-2)   // Stored, but the waveform they make was rejected
+#define PARAM_ERR_HARDWARE      (-3)   // IGBT PWM setting the timer rejected; not stored
+
+// Apply one value, clamped and with its hook run. Returns 1, 0 if no
+// writable parameter has that id/name, PARAM_ERR_WAVEFORM if the legacy
+// profile it completes was rejected (curr_waveform_rejected(); the profile
+// armed before keeps playing), or PARAM_ERR_HARDWARE if the IGBT PWM could
+// not be reconfigured (the previous PWM settings are put back).
+int param_set(uint8_t id, float value);
+int param_set_name(const char* name, float value);
+
+// Current value of a parameter (read-only ones included); false if unknown
+bool param_get(uint8_t id, float& value);
+
+// Apply every record of a batch, then run each hook (e.g. waveform
+// reload) once. Returns the number of records applied (unknown or
+// read-only ids and unknown types are skipped), PARAM_BATCH_ERR_FORMAT, in
+// which case nothing was applied, or PARAM_ERR_WAVEFORM /
+// PARAM_ERR_HARDWARE as for param_set() (only the IGBT PWM records are
+// put back; the rest of the batch stays applied).
+int param_set_many(const uint8_t* data, size_t len);
+
+// As param_set_many() but without running any hook: for setup(), before
+// the modules the hooks reconfigure have been initialised
+int param_load_many(const uint8_t* data, size_t len);
+
+// Batch holding the requested ids in order (unknown ids are left out).
+// n == 0 returns every parameter. `out` must hold
+// PARAM_BATCH_HEADER + PARAM_BATCH_RECORD * max(n, param_count()) bytes.
+// Returns the number of bytes written.
+size_t param_get_many(const uint8_t* ids, size_t n, uint8_t* out);
+
+size_t param_count();
+
+// Ids of the calibration and limit parameters kept in flash, in table
+// order. Returns how many were written to `ids` (at most `max`).
+size_t param_persistent_ids(uint8_t* ids, size_t max);
+
+#endif // PARAM_REGISTRY_H
@@ -0,0 +1,246 @@
+#include "ParamStore.h"
+#include "PowerState.h"
+#include "SensorConv.h"
+#include "Crc32.h"
+#include <stddef.h>
+#include <string.h>
+
+struct ParamSlotHeader {
+  uint32_t magic;
+  uint32_t seq;
+  uint16_t version;
+  uint16_t len;
+  uint32_t crc;
+};
+
+#define PARAM_STORE_WORD   (FLASH_NB_32BITWORD_IN_FLASHWORD * 4U)
+#define PARAM_STORE_BATCH  (PARAM_STORE_SLOT - sizeof(ParamSlotHeader))
+#define PARAM_STORE_SR_ERR (FLASH_SR_WRPERR | FLASH_SR_PGSERR | FLASH_SR_STRBERR | \
+                            FLASH_SR_INCERR | FLASH_SR_OPERR)
+#define PARAM_STORE_SR_ECC (FLASH_SR_SNECCERR | FLASH_SR_DBECCERR)
+
+static_assert(PARAM_STORE_SLOT % PARAM_STORE_WORD == 0, "slot must be whole flash words");
+static_assert(PARAM_BATCH_HEADER + PARAM_STORE_MAX * PARAM_BATCH_RECORD <= PARAM_STORE_BATCH,
+              "persistent parameters do not fit a slot");
+
+// Erase and program poll bank 2 while it is busy, so they must not fetch
+// from it: placed in .data, which the startup code copies to RAM
+#ifndef PARAM_STORE_RAMFUNC
+#define PARAM_STORE_RAMFUNC __attribute__((section(".data.param_store"), noinline, long_call))
+#endif
+
+// mbed linker script: the image is .text, then the load copy of .data
+extern "C" const uint8_t __etext[], __data_start__[], __data_end__[];
+
+// ----- State -----
+static bool     s_usable = false;           // Image ends below the sector
+static uint32_t s_seq = 0;                  // Newest slot, 0 = none
+static uint32_t s_current = PARAM_STORE_SLOTS;  // Index of that slot
+static uint32_t s_next = 0;                 // First erased slot (SLOTS = sector full)
+
+alignas(32) static uint8_t s_slot[PARAM_STORE_SLOT];   // Slot being written
+alignas(32) static uint8_t s_read[PARAM_STORE_SLOT];   // Slot read back
+
+// --- Helpers --------------------------------------------------------------
+
+static uint32_t slot_base(uint32_t i) {
+  return PARAM_STORE_ADDR + i * PARAM_STORE_SLOT;
+}
+
+static bool image_below_store() {
+  const uintptr_t end = (uintptr_t)__etext + (uintptr_t)(__data_end__ - __data_start__);
+  return end <= PARAM_STORE_ADDR;
+}
+
+static uint32_t slot_crc(const ParamSlotHeader& h, const uint8_t* batch) {
+  const uint32_t crc = crc32((const uint8_t*)&h.seq, offsetof(ParamSlotHeader, crc) - offsetof(ParamSlotHeader, seq));
+  return crc32(batch, h.len, crc);
+}
+
+static bool slot_valid(const uint8_t* s, ParamSlotHeader& h) {
+  memcpy(&h, s, sizeof(h));
+  if (h.magic != PARAM_STORE_MAGIC || h.version != PARAM_STORE_VERSION) return false;
+  if (h.len > PARAM_STORE_BATCH) return false;
+  return slot_crc(h, s + sizeof(h)) == h.crc;
+}
+
+static bool slot_erased(const uint8_t* s) {
+  for (uint32_t i = 0; i < PARAM_STORE_SLOT; ++i) {
+    if (s[i] != 0xFF) return false;
+  }
+  return true;
+}
+
+// Copy slot i into s_read. A flash word torn by a reset reads with a
+// double ECC error, which faults the load: the copy runs at FAULTMASK
+// with BFHFNMIGN set, so the fault is ignored, and SR2 tells afterwards.
+// Single errors are corrected and the data stands.
+static bool read_slot(uint32_t i) {
+  const volatile uint32_t* src = (const volatile uint32_t*)(uintptr_t)slot_base(i);
+  uint32_t* dst = (uint32_t*)s_read;
+
+  const uint32_t faultmask = __get_FAULTMASK();
+  __set_FAULTMASK(1);
+  SCB->CCR |= SCB_CCR_BFHFNMIGN_Msk;
+  __DSB();
+  __ISB();
+  FLASH->CCR2 = FLASH_CCR_CLR_SNECCERR | FLASH_CCR_CLR_DBECCERR;
+
+  for (uint32_t w = 0; w < PARAM_STORE_SLOT / 4U; ++w) dst[w] = src[w];
+  __DSB();
+  const uint32_t ecc = FLASH->SR2 & PARAM_STORE_SR_ECC;
+  FLASH->CCR2 = FLASH_CCR_CLR_SNECCERR | FLASH_CCR_CLR_DBECCERR;
+
+  SCB->CCR &= ~SCB_CCR_BFHFNMIGN_Msk;
+  __DSB();
+  __ISB();
+  __set_FAULTMASK(faultmask);
+  return !(ecc & FLASH_SR_DBECCERR);
+}
+
+// Wait out the bank 2 operation in progress; returns its error bits
+PARAM_STORE_RAMFUNC static uint32_t flash_wait() {
+  while (FLASH->SR2 & (FLASH_SR_QW | FLASH_SR_BSY)) {}
+  const uint32_t err = FLASH->SR2 & PARAM_STORE_SR_ERR;
+  FLASH->CCR2 = err | FLASH_CCR_CLR_EOP;
+  return err;
+}
+
+PARAM_STORE_RAMFUNC static uint32_t flash_erase_sector() {
+  FLASH->CR2 &= ~(FLASH_CR_PSIZE | FLASH_CR_SNB);
+  FLASH->CR2 |= FLASH_CR_SER | FLASH_VOLTAGE_RANGE_3 | (PARAM_STORE_SECTOR << FLASH_CR_SNB_Pos);
+  FLASH->CR2 |= FLASH_CR_START;
+  const uint32_t err = flash_wait();
+  FLASH->CR2 &= ~(FLASH_CR_SER | FLASH_CR_SNB);
+  return err;
+}
+
+// Program s_slot into slot i, a flash word (8 stores) at a time
+PARAM_STORE_RAMFUNC static uint32_t flash_program_slot(uint32_t i) {
+  volatile uint32_t* dst = (volatile uint32_t*)(uintptr_t)slot_base(i);
+  const uint32_t* src = (const uint32_t*)s_slot;
+
+  FLASH->CR2 &= ~FLASH_CR_PSIZE;
+  FLASH->CR2 |= FLASH_CR_PG | FLASH_VOLTAGE_RANGE_3;
+  uint32_t err = 0;
+  for (uint32_t w = 0; w < PARAM_STORE_SLOT / 4U && !err; w += FLASH_NB_32BITWORD_IN_FLASHWORD) {
+    __ISB();
+    __DSB();
+    for (uint32_t k = 0; k < FLASH_NB_32BITWORD_IN_FLASHWORD; ++k) dst[w + k] = src[w + k];
+    __ISB();
+    __DSB();
+    err = flash_wait();
+  }
+  FLASH->CR2 &= ~FLASH_CR_PG;
+  return err;
+}
+
+// Erase the sector if asked, then program slot i, with interrupts off: every
+// handler lives in bank 2 and would stall for the whole operation, up to
+// seconds for the erase. Only done with the output off, checked again
+// here because the tick can enable it up to the moment interrupts stop.
+static int write_slot(uint32_t i, bool erase) {
+  HAL_FLASH_Unlock();
+  const uint32_t primask = __get_PRIMASK();
+  __disable_irq();
+
+  int rc = 1;
+  if (PowerState::outputEnabled || PowerState::runCurrentWave) {
+    rc = PARAM_STORE_ERR_BUSY;
+  } else if ((erase && flash_erase_sector()) || flash_program_slot(i)) {
+    rc = PARAM_STORE_ERR_FLASH;
+  }
+
+  __set_PRIMASK(primask);
+  HAL_FLASH_Lock();
+  return rc;
+}
+
+// --- Public API -----------------------------------------------------------
+
+void init_param_store() {
+  s_seq = 0;
+  s_current = PARAM_STORE_SLOTS;
+  s_next = PARAM_STORE_SLOTS;
+
+  // A store overlapping the image would erase the firmware
+  s_usable = image_below_store();
+  if (!s_usable) return;
+
+  // Slots are written in order, so the first erased one ends the log.
+  // A torn slot is neither erased nor valid, and is passed over.
+  for (uint32_t i = 0; i < PARAM_STORE_SLOTS; ++i) {
+    const bool readable = read_slot(i);
+    if (readable && slot_erased(s_read)) {
+      s_next = i;
+      break;
+    }
+    ParamSlotHeader h;
+    if (readable && slot_valid(s_read, h) && h.seq >= s_seq) {
+      s_seq = h.seq;
+      s_current = i;
+    }
+  }
+
+  if (s_current == PARAM_STORE_SLOTS || !read_slot(s_current)) return;
+
+  ParamSlotHeader h;
+  memcpy(&h, s_read, sizeof(h));
+  if (param_load_many(s_read + sizeof(h), h.len) < 0) return;
+  sensor_conv_update();
+}
+
+int param_store_save() {
+  if (!s_usable) return PARAM_STORE_ERR_FLASH;
+  if (PowerState::outputEnabled || PowerState::runCurrentWave) return PARAM_STORE_ERR_BUSY;
+
+  uint8_t ids[PARAM_STORE_MAX];
+  const size_t n = param_persistent_ids(ids, PARAM_STORE_MAX);
+
+  memset(s_slot, 0xFF, sizeof(s_slot));
+  ParamSlotHeader h;
+  h.magic   = PARAM_STORE_MAGIC;
+  h.seq     = s_seq + 1;
+  h.version = PARAM_STORE_VERSION;
+  h.len     = (uint16_t)param_get_many(ids, n, s_slot + sizeof(h));
+
+  // Nothing changed since the last save: spare the sector a write
+  if (s_current < PARAM_STORE_SLOTS && read_slot(s_current)) {
+    ParamSlotHeader cur;
+    memcpy(&cur, s_read, sizeof(cur));
+    if (cur.len == h.len && memcmp(s_read + sizeof(cur), s_slot + sizeof(h), h.len) == 0) return 1;
+  }
+
+  h.crc = slot_crc(h, s_slot + sizeof(h));
+  memcpy(s_slot, &h, sizeof(h));
+
+  // A slot past the end of the log that is not erased (an erase cut short)
+  // cannot be programmed: start the sector over
+  if (s_next < PARAM_STORE_SLOTS && !(read_slot(s_next) && slot_erased(s_read))) s_next = PARAM_STORE_SLOTS;
+
+  const bool erase = (s_next >= PARAM_STORE_SLOTS);
+  const uint32_t slot = erase ? 0U : s_next;
+  const int rc = write_slot(slot, erase);
+  if (rc == PARAM_STORE_ERR_BUSY) return rc;
+
+  if (erase) s_current = PARAM_STORE_SLOTS;
+  s_next = slot + 1U;   // Never program the same flash word twice
+  if (rc < 0 || !read_slot(slot) || memcmp(s_read, s_slot, PARAM_STORE_SLOT) != 0) return PARAM_STORE_ERR_FLASH;
+
+  s_seq = h.seq;
+  s_current = slot;
+  return 1;
+}
+
+uint32_t param_store_hash(const uint8_t* ids, size_t n) {
+  uint32_t crc = 0;
+  for (size_t i = 0; i < n; ++i) {
+    float value;
+    if (!param_get(ids[i], value)) continue;
+    crc = crc32(&ids[i], 1, crc);
+    crc = crc32((const uint8_t*)&value, sizeof(value), crc);
+  }
+  return crc;
+}
+
+uint32_t param_store_seq() { return s_seq; }
@@ -0,0 +1,55 @@
+#ifndef PARAM_STORE_H
+#define PARAM_STORE_H
+
+#include "Config.h"
+#include "ParamRegistry.h"
+#include "stm32h7xx_hal.h"
+
+// Calibration and limits (the PARAM_PERSIST entries of the registry) kept
+// in the last 128 KB sector of flash bank 2, so the M4 boots calibrated
+// without waiting for Linux. The M4 runs from bank 2 too: if its image
+// reaches PARAM_STORE_ADDR, init_param_store() leaves the sector alone and
+// every save fails with PARAM_STORE_ERR_FLASH.
+//
+// The sector is an append-only log of fixed-size slots; a save programs
+// the next erased slot and the sector is only erased once every slot has
+// been used. Slot layout (little-endian):
+//   u32 magic, u32 seq, u16 version, u16 len, u32 crc32, then a
+//   param_get_many() batch of `len` bytes
+// crc32 covers seq..len and the batch. At boot the valid slot with the
+// highest seq wins. A reset during a save leaves flash words half
+// programmed, which read with an ECC error rather than bad data: such a
+// slot is read with the bus fault masked, rejected and never reused.
+#define PARAM_STORE_BANK     FLASH_BANK_2
+#define PARAM_STORE_SECTOR   FLASH_SECTOR_7
+#define PARAM_STORE_ADDR     (FLASH_BANK2_BASE + PARAM_STORE_SECTOR * FLASH_SECTOR_SIZE)
+#define PARAM_STORE_MAGIC    0x53504358U   // "XCPS"
+#define PARAM_STORE_VERSION  1             // Bump when a stored value changes meaning
+#define PARAM_STORE_MAX      32U           // Persistent parameters per slot
+#define PARAM_STORE_SLOT     256U          // Bytes, a multiple of the 32-byte flash word
+#define PARAM_STORE_SLOTS    (FLASH_SECTOR_SIZE / PARAM_STORE_SLOT)
+
+#define PARAM_STORE_ERR_BUSY   (-1)   // Output active: erase/program would stall the M4
+#define PARAM_STORE_ERR_FLASH  (-2)   // Erase, program or read-back failed, or no store
+
+// setup(), before the init_* calls: apply the newest valid slot without
+// running hooks (the modules read the values as they initialise) and
+// refresh the probe coefficients. Compiled-in defaults stay otherwise.
+void init_param_store();
+
+// Write the current persistent values to flash. Erase and program run
+// from RAM with interrupts off, as every handler is fetched from bank 2:
+// the M4 stops for the program (ms) or a sector erase (up to ~2 s). So it
+// is refused while the output is enabled or the waveform runs. Returns 1
+// (also when the values are already stored) or a PARAM_STORE_ERR_* code.
+int param_store_save();
+
+// crc32 over (u8 id, f32 value) of each requested id, in the order given;
+// unknown ids are left out. Lets the bridge tell whether the M4 already
+// runs its configuration without reading every value back.
+uint32_t param_store_hash(const uint8_t* ids, size_t n);
+
+// seq of the slot loaded at boot or written last; 0 = compiled-in defaults
+uint32_t param_store_seq();
+
+#endif // PARAM_STORE_H
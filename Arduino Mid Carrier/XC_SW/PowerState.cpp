@@ -1,10 +1,14 @@
 #include "PowerState.h"
+#include <Arduino.h>
+#include <string.h>
 
 volatile float PowerState::setVoltage = 0.0f;
 volatile float PowerState::setCurrent = 0.0f;
 volatile float PowerState::probeVoltageOutput = 0.0f;
+volatile float PowerState::probeVoltageFast = 0.0f;
 volatile float PowerState::probeCurrent = 0.0f;
 volatile float PowerState::internalTemperature = 0.0f;
+volatile float PowerState::internalTemperatureRate = 0.0f;
 
 volatile bool PowerState::internalEnable = false;
 volatile bool PowerState::externalEnable = false;
@@ -34,4 +38,115 @@ volatile float PowerState::currD1    = 0.0f;
 volatile float PowerState::currA2    = 0.0f;
 volatile float PowerState::currB2    = 0.0f;
 volatile float PowerState::currC2    = 0.0f;
-volatile float PowerState::currD2    = 0.0f;
\ No newline at end of file
+volatile float PowerState::currD2    = 0.0f;
+
+// ----- Snapshot seqlock -----
+// Single writer (the tick). The copy runs with interrupts held off, so a
+// reader cannot preempt it even when loop() ticks from thread context:
+// s_lock is odd only inside that window, and a reader that sees it change
+// across its copy takes another one, at most SNAPSHOT_TRIES times.
+#define SNAPSHOT_TRIES  4U
+
+static PowerSnapshot     s_snap = {};
+static volatile uint32_t s_lock = 0;
+
+// ----- Setpoint mailbox -----
+#define REQ_VOLTAGE  (1U << 0)
+#define REQ_CURRENT  (1U << 1)
+
+static volatile uint32_t s_req_pending = 0;
+static volatile float    s_req_voltage = 0.0f;
+static volatile float    s_req_current = 0.0f;
+
+// --- Helpers --------------------------------------------------------------
+
+static uint64_t extend_micros(uint32_t now_us) {
+  static uint32_t last_us = 0;
+  static uint64_t high = 0;
+  if (now_us < last_us) high += (1ULL << 32);
+  last_us = now_us;
+  return high | now_us;
+}
+
+// --- Public API -----------------------------------------------------------
+
+const PowerSnapshot& power_state_publish() {
+  const uint64_t now_us = extend_micros(micros());
+
+  const uint32_t primask = __get_PRIMASK();
+  __disable_irq();
+  s_lock = s_lock + 1U;
+  __DMB();
+
+  PowerSnapshot& p = s_snap;
+  p.timestamp_us            = now_us;
+  p.tick                    = p.tick + 1U;
+  p.setVoltage              = PowerState::setVoltage;
+  p.setCurrent              = PowerState::setCurrent;
+  p.probeVoltageOutput      = PowerState::probeVoltageOutput;
+  p.probeVoltageFast        = PowerState::probeVoltageFast;
+  p.probeCurrent            = PowerState::probeCurrent;
+  p.internalTemperature     = PowerState::internalTemperature;
+  p.internalTemperatureRate = PowerState::internalTemperatureRate;
+  p.internalEnable          = PowerState::internalEnable;
+  p.externalEnable          = PowerState::externalEnable;
+  p.outputEnabled           = PowerState::outputEnabled;
+  p.warnLampTestState       = PowerState::warnLampTestState;
+  p.DumpFan                 = PowerState::DumpFan;
+  p.DumpRelay               = PowerState::DumpRelay;
+  p.ChargerRelay            = PowerState::ChargerRelay;
+  p.ScrTrig                 = PowerState::ScrTrig;
+  p.ScrInhib                = PowerState::ScrInhib;
+  p.IgbtFaultState          = PowerState::IgbtFaultState;
+  p.runCurrentWave          = PowerState::runCurrentWave;
+
+  __DMB();
+  s_lock = s_lock + 1U;
+  __set_PRIMASK(primask);
+  return s_snap;
+}
+
+bool power_state_snapshot(PowerSnapshot& out) {
+  PowerSnapshot copy;
+  for (uint32_t i = 0; i < SNAPSHOT_TRIES; ++i) {
+    const uint32_t seq = s_lock;
+    if (seq & 1U) continue;
+    __DMB();
+    memcpy(&copy, &s_snap, sizeof(copy));
+    __DMB();
+    if (s_lock != seq) continue;
+    if (copy.tick == 0) return false;
+    out = copy;
+    return true;
+  }
+  return false;
+}
+
+void power_state_request_voltage(float volts) {
+  const uint32_t primask = __get_PRIMASK();
+  __disable_irq();
+  s_req_voltage = volts;
+  s_req_pending = s_req_pending | REQ_VOLTAGE;
+  __set_PRIMASK(primask);
+}
+
+void power_state_request_current(float amps) {
+  const uint32_t primask = __get_PRIMASK();
+  __disable_irq();
+  s_req_current = amps;
+  s_req_pending = s_req_pending | REQ_CURRENT;
+  __set_PRIMASK(primask);
+}
+
+void power_state_apply_requests() {
+  if (!s_req_pending) return;
+
+  // Short section: the loop() fallback tick can be preempted by a requester
+  const uint32_t primask = __get_PRIMASK();
+  __disable_irq();
+  const uint32_t pending = s_req_pending;
+  if (pending & REQ_VOLTAGE) PowerState::setVoltage = s_req_voltage;
+  if (pending & REQ_CURRENT) PowerState::setCurrent = s_req_current;
+  s_req_pending = 0;
+  __set_PRIMASK(primask);
+}
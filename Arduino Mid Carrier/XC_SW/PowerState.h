@@ -7,8 +7,10 @@ struct PowerState {
     static volatile float setVoltage;
     static volatile float setCurrent;
     static volatile float probeVoltageOutput;
+    static volatile float probeVoltageFast;          // protection path (FILTER_VOLT_FAST)
     static volatile float probeCurrent;
     static volatile float internalTemperature;
+    static volatile float internalTemperatureRate;   // °C/s, filtered
 
     // Enable logic
     static volatile bool internalEnable;   // Set via UI or logic
@@ -44,4 +46,53 @@ struct PowerState {
 
 };
 
+// ----- Published snapshot -----
+// The live statics above belong to the control tick. Once per tick
+// power_state_publish() copies them into one PowerSnapshot under a sequence
+// lock; the RPC thread and loop() read that copy, so every field of it comes
+// from the same tick and the tick never waits for a reader.
+struct PowerSnapshot {
+    uint64_t timestamp_us;    // micros() at publish, extended to 64 bits
+    uint32_t tick;            // Publish count, 0 = nothing published yet
+
+    float setVoltage;
+    float setCurrent;
+    float probeVoltageOutput;
+    float probeVoltageFast;
+    float probeCurrent;
+    float internalTemperature;
+    float internalTemperatureRate;
+
+    bool internalEnable;
+    bool externalEnable;
+    bool outputEnabled;
+    bool warnLampTestState;
+    bool DumpFan;
+    bool DumpRelay;
+    bool ChargerRelay;
+    bool ScrTrig;
+    bool ScrInhib;
+    bool IgbtFaultState;
+    bool runCurrentWave;
+};
+
+// Control tick, after the last task that writes PowerState. Returns the
+// snapshot just published, for the tick's own readers (it is the only
+// writer, so they need no lock).
+const PowerSnapshot& power_state_publish();
+
+// Consistent copy of the newest snapshot. Never blocks the tick: a copy it
+// overlapped is retried a bounded number of times. Returns false, and
+// leaves `out` as it was, before the first publish or when every try was
+// torn, so a caller that keeps `out` keeps its last good copy.
+bool power_state_snapshot(PowerSnapshot& out);
+
+// ----- Setpoint requests -----
+// setVoltage / setCurrent are written by the control tick only. Other
+// contexts stage a request; the tick adopts it in power_state_apply_requests()
+// at its start. A request not yet adopted is replaced by a newer one.
+void power_state_request_voltage(float volts);
+void power_state_request_current(float amps);
+void power_state_apply_requests();
+
 #endif // POWERSTATE_H
\ No newline at end of file
@@ -0,0 +1,222 @@
+#include "Scheduler.h"
+#include "Config.h"
+#include "LoopProfile.h"
+#include "EventLog.h"
+#include <Arduino.h>
+#include "stm32h7xx_hal.h"
+
+struct SchedTask {
+  const char*       name;
+  SchedTaskFunc     fn;
+  uint32_t          divider;
+  uint32_t          phase;     // Staggers slow tasks so they don't share a tick
+  volatile uint32_t overruns;
+};
+
+static SchedTask         s_tasks[SCHED_MAX_TASKS] = {};
+static uint8_t           s_num_tasks = 0;
+static volatile uint32_t s_tick = 0;
+
+static TIM_HandleTypeDef s_tim7 = {};
+static bool              s_running = false;
+
+// ----- Tick timing (written from the TIM7 interrupt) -----
+// Cycle counts of the timer period and of one TIM7 count are Q16, as
+// neither need be a whole number of core cycles
+static_assert(CONTROL_RATE_HZ >= 4000U, "a tick period must stay below 2^16 cycles of a 240 MHz core");
+static SchedJitter       s_jitter = {};
+static uint64_t          s_latency_sum_ns = 0;
+static uint32_t          s_period_q16 = 0;
+static uint32_t          s_count_q16 = 0;
+static uint32_t          s_ns_per_kcycle = 0;
+static uint32_t          s_expected = 0;       // CYCCNT at the last update event
+static uint32_t          s_expected_frac = 0;  // Its Q16 fraction
+static bool              s_anchored = false;
+static bool              s_was_late = false;
+
+// --- Tick dispatch --------------------------------------------------------
+
+// Runs every due task. If the timer's update flag comes back while a task is
+// executing, that task made the next tick late: charge the overrun to it and
+// let the pending interrupt re-enter straight away.
+static void run_tick(bool check_deadline) {
+  const uint32_t tick = s_tick++;
+  bool late = false;
+
+  for (uint8_t i = 0; i < s_num_tasks; ++i) {
+    SchedTask& t = s_tasks[i];
+    if ((tick % t.divider) != t.phase) continue;
+
+    t.fn();
+
+    if (check_deadline && !late && __HAL_TIM_GET_FLAG(&s_tim7, TIM_FLAG_UPDATE)) {
+      t.overruns = t.overruns + 1;
+      late = true;
+    }
+  }
+}
+
+static void clear_jitter() {
+  s_jitter = {};
+  s_jitter.latency_min_ns = UINT32_MAX;
+  s_latency_sum_ns = 0;
+  s_anchored = false;
+  s_was_late = false;
+}
+
+static inline uint32_t cycles_to_ns(uint32_t cycles) {
+  return (uint32_t)(((uint64_t)cycles * s_ns_per_kcycle) / 1000U);
+}
+
+// CYCCNT of the update event that `now` (CYCCNT at interrupt entry)
+// answers. The first tick, and any tick that finds the counter behind the
+// expected event (LoopProfile zeroes it), anchors on the TIM7 count; every
+// other adds a period to the last event, plus one per missed update.
+static uint32_t update_event(uint32_t now, uint32_t count) {
+  if (s_anchored) {
+    const uint64_t next = ((uint64_t)s_expected << 16) + s_expected_frac + s_period_q16;
+    const uint32_t event = (uint32_t)(next >> 16);
+    const int32_t late = (int32_t)(now - event);
+    if (late >= 0) {
+      const uint32_t missed = ((uint32_t)late < (s_period_q16 >> 16)) ? 0U
+                            : (uint32_t)(((uint64_t)(uint32_t)late << 16) / s_period_q16);
+      const uint64_t at = next + (uint64_t)missed * s_period_q16;
+      s_jitter.missed += missed;
+      s_expected = (uint32_t)(at >> 16);
+      s_expected_frac = (uint32_t)at & 0xFFFFU;
+      return s_expected;
+    }
+  }
+  s_expected = now - (uint32_t)(((uint64_t)count * s_count_q16) >> 16);
+  s_expected_frac = 0;
+  s_anchored = true;
+  return s_expected;
+}
+
+static void record_jitter(uint32_t event, uint32_t entry, uint32_t done) {
+  const uint32_t latency = cycles_to_ns(entry - event);
+  const uint32_t complete = cycles_to_ns(done - event);
+
+  SchedJitter& j = s_jitter;
+  j.ticks++;
+  if (latency < j.latency_min_ns) j.latency_min_ns = latency;
+  if (latency > j.latency_max_ns) j.latency_max_ns = latency;
+  if (complete > j.complete_max_ns) j.complete_max_ns = complete;
+  s_latency_sum_ns += latency;
+
+  uint32_t bin = 31U - (uint32_t)__builtin_clz(latency | 1U);
+  if (bin >= SCHED_JITTER_BINS) bin = SCHED_JITTER_BINS - 1;
+  j.hist[bin]++;
+
+  // Journal the start of a late streak, not every tick of it
+  const bool late = latency > CONTROL_LATENCY_BUDGET_NS;
+  if (late) {
+    j.over_budget++;
+    if (!s_was_late) event_log_add(EVT_TICK_LATE, 0, (float)latency);
+  }
+  s_was_late = late;
+}
+
+void sched_timer_isr() {
+  if (!__HAL_TIM_GET_FLAG(&s_tim7, TIM_FLAG_UPDATE)) return;
+  const uint32_t entry = DWT->CYCCNT;
+  __HAL_TIM_CLEAR_FLAG(&s_tim7, TIM_FLAG_UPDATE);
+  const uint32_t event = update_event(entry, s_tim7.Instance->CNT);
+  PROFILE_STAGE(PROF_TICK, run_tick(true));
+  record_jitter(event, entry, DWT->CYCCNT);
+}
+// --- Public API -----------------------------------------------------------
+
+int sched_add_task(const char* name, uint32_t divider, SchedTaskFunc fn) {
+  if (s_num_tasks >= SCHED_MAX_TASKS || divider == 0 || fn == nullptr) return -1;
+
+  SchedTask& t = s_tasks[s_num_tasks];
+  t.name     = name;
+  t.fn       = fn;
+  t.divider  = divider;
+  t.phase    = s_num_tasks % divider;
+  t.overruns = 0;
+  return s_num_tasks++;
+}
+
+bool init_scheduler() {
+  __HAL_RCC_TIM7_CLK_ENABLE();
+
+  const uint32_t timer_clock_hz = 200000000U; // APB1 timer clock, as TIM3/TIM6
+  const uint32_t total_ticks    = timer_clock_hz / CONTROL_RATE_HZ;
+
+  uint32_t psc = 0, arr = 0;
+  while (1) {
+    arr = (total_ticks / (psc + 1U)) - 1U;
+    if (arr <= 65535U) break;
+    if (++psc > 65535U) return false;
+  }
+
+  s_tim7.Instance               = TIM7;
+  s_tim7.Init.Prescaler         = psc;
+  s_tim7.Init.CounterMode       = TIM_COUNTERMODE_UP;
+  s_tim7.Init.Period            = arr;
+  s_tim7.Init.AutoReloadPreload = TIM_AUTORELOAD_PRELOAD_ENABLE;
+  if (HAL_TIM_Base_Init(&s_tim7) != HAL_OK) return false;
+
+  // Tick timing runs on the cycle counter; LoopProfile may share it
+  CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+  DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+  s_period_q16    = (uint32_t)(((uint64_t)(psc + 1U) * (arr + 1U) * SystemCoreClock << 16) / timer_clock_hz);
+  s_count_q16     = (uint32_t)(((uint64_t)(psc + 1U) * SystemCoreClock << 16) / timer_clock_hz);
+  s_ns_per_kcycle = (uint32_t)(1000000000000ULL / SystemCoreClock);
+  clear_jitter();
+
+  NVIC_SetVector(TIM7_IRQn, (uint32_t)(uintptr_t)&sched_timer_isr);
+  HAL_NVIC_SetPriority(TIM7_IRQn, IRQ_PRIO_CONTROL, 0);
+  HAL_NVIC_EnableIRQ(TIM7_IRQn);
+
+  s_tick = 0;
+  if (HAL_TIM_Base_Start_IT(&s_tim7) != HAL_OK) {
+    HAL_NVIC_DisableIRQ(TIM7_IRQn);
+    return false;
+  }
+
+  s_running = true;
+  return true;
+}
+
+bool scheduler_running() {
+  return s_running;
+}
+
+void sched_run_tick() {
+  run_tick(false);
+}
+
+uint32_t sched_tick_count() {
+  return s_tick;
+}
+
+void sched_jitter(SchedJitter& out) {
+  const uint32_t primask = __get_PRIMASK();
+  __disable_irq();
+  out = s_jitter;
+  const uint64_t sum = s_latency_sum_ns;
+  __set_PRIMASK(primask);
+
+  if (out.ticks == 0) out.latency_min_ns = 0;
+  else                out.latency_mean_ns = (uint32_t)(sum / out.ticks);
+}
+
+void sched_jitter_reset() {
+  // Recorded from the scheduler interrupt; keep it out while clearing
+  const uint32_t primask = __get_PRIMASK();
+  __disable_irq();
+  clear_jitter();
+  __set_PRIMASK(primask);
+}
+
+uint32_t sched_overruns(int task) {
+  if (task >= 0) {
+    return (task < s_num_tasks) ? s_tasks[task].overruns : 0U;
+  }
+  uint32_t total = 0;
+  for (uint8_t i = 0; i < s_num_tasks; ++i) total += s_tasks[i].overruns;
+  return total;
+}
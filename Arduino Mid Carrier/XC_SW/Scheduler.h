@@ -0,0 +1,56 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include "Config.h"
+
+typedef void (*SchedTaskFunc)();
+
+#define SCHED_MAX_TASKS    8
+#define SCHED_JITTER_BINS  16   // Bin i counts ticks entered [2^i, 2^(i+1)) ns late
+
+// Tick timing from the DWT cycle counter, in ns after the update event
+// the tick belongs to: latency until the interrupt ran, complete when its
+// last task returned. Update events are expected one timer period apart
+// from the first tick on; an update that came and went while the previous
+// tick still ran is counted as missed.
+struct SchedJitter {
+  uint32_t ticks;
+  uint32_t latency_min_ns;
+  uint32_t latency_max_ns;
+  uint32_t latency_mean_ns;
+  uint32_t complete_max_ns;
+  uint32_t over_budget;          // Entered later than CONTROL_LATENCY_BUDGET_NS
+  uint32_t missed;               // Update events that never got a tick
+  uint32_t hist[SCHED_JITTER_BINS];
+};
+
+// Register a task that runs every `divider` base ticks (CONTROL_RATE_HZ).
+// Tasks execute in registration order within a tick. Returns the task id,
+// or -1 if the table is full or the divider is zero.
+int sched_add_task(const char* name, uint32_t divider, SchedTaskFunc fn);
+
+// Start TIM7 at CONTROL_RATE_HZ; tasks then run from its update interrupt.
+// Returns false if the timer could not be configured.
+bool init_scheduler();
+
+// TIM7 update interrupt entry (installed by init_scheduler())
+void sched_timer_isr();
+
+// True while the timer interrupt is driving the task table
+bool scheduler_running();
+
+// Run one base tick by hand (used from loop() when the timer is unavailable)
+void sched_run_tick();
+
+// Base ticks elapsed since init_scheduler()
+uint32_t sched_tick_count();
+
+// Tick timing since init_scheduler() or the last reset
+void sched_jitter(SchedJitter& out);
+void sched_jitter_reset();
+
+// Number of times a task was still running when the next base tick fell due.
+// A negative id returns the sum over all tasks.
+uint32_t sched_overruns(int task);
+
+#endif // SCHEDULER_H
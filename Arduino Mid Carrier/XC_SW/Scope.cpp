@@ -0,0 +1,199 @@
+#include "Scope.h"
+#include "PowerState.h"
+#include "Telemetry.h"
+#include "IGBT.h"
+#include <Arduino.h>
+#include <string.h>
+
+static_assert(sizeof(ScopeSample) == 16, "scope record is 16 bytes on the wire");
+
+// ----- Ring and capture state -----
+// Written by the control tick only. A frozen record is not touched again
+// until the tick adopts a re-arm, so the RPC thread reads it unlocked.
+static ScopeSample          s_buf[SCOPE_DEPTH];
+static uint32_t             s_head = 0;        // Next record written
+static uint32_t             s_filled = 0;      // Valid records behind s_head
+static uint32_t             s_div = 0;
+
+static volatile ScopeState  s_state = SCOPE_IDLE;
+static uint32_t             s_mask = 0;
+static uint32_t             s_pre = SCOPE_DEFAULT_PRE;
+static uint32_t             s_post = SCOPE_DEFAULT_POST;
+static uint32_t             s_decimation = 1;
+static uint16_t             s_prev_flags = 0;
+static uint32_t             s_post_left = 0;
+
+// Frozen record (valid in SCOPE_FROZEN)
+static uint32_t             s_start = 0;       // Ring index of record 0
+static volatile uint32_t    s_len_pre = 0;
+static volatile uint32_t    s_len_post = 0;
+static volatile uint8_t     s_fired = 0;
+static volatile uint64_t    s_trigger_us = 0;
+static volatile uint32_t    s_capture = 0;
+
+// ----- Requests from the RPC thread -----
+struct ScopeConfig {
+  uint32_t mask, pre, post, decimation;
+};
+
+static ScopeConfig       s_req = {};
+static volatile bool     s_req_pending = false;
+static volatile bool     s_manual = false;
+
+// --- Helpers --------------------------------------------------------------
+
+static inline uint16_t duty_to_u16(float d) {
+  if (!(d > 0.0f)) return 0U;
+  if (d >= 1.0f) return 0xFFFFU;
+  return (uint16_t)(d * 65535.0f + 0.5f);
+}
+
+// Edges on the snapshot flags that fire an enabled trigger
+static uint8_t triggers_fired(uint16_t flags) {
+  const uint16_t rising = flags & (uint16_t)~s_prev_flags;
+  uint8_t fired = 0;
+  if (rising & TLM_FLAG_RUN_WAVE)   fired |= SCOPE_TRIG_RUN_WAVE;
+  if (rising & TLM_FLAG_IGBT_FAULT) fired |= SCOPE_TRIG_IGBT_FAULT;
+  if (rising & TLM_FLAG_FAST_TRIP)  fired |= SCOPE_TRIG_FAST_TRIP;
+  if (s_manual) {
+    s_manual = false;
+    fired |= SCOPE_TRIG_MANUAL;
+  }
+  return fired & (uint8_t)s_mask;
+}
+
+static void adopt_request() {
+  const uint32_t primask = __get_PRIMASK();
+  __disable_irq();
+  const ScopeConfig cfg = s_req;
+  s_req_pending = false;
+  __set_PRIMASK(primask);
+
+  s_mask       = cfg.mask;
+  s_pre        = cfg.pre;
+  s_post       = cfg.post;
+  s_decimation = cfg.decimation;
+  s_head = s_filled = s_div = 0;
+  s_manual = false;
+
+  // Flags already up when arming are not an edge
+  PowerSnapshot p = {};
+  power_state_snapshot(p);
+  s_prev_flags = telemetry_flags(p);
+  s_state = s_mask ? SCOPE_ARMED : SCOPE_IDLE;
+}
+
+template <typename T>
+static inline void put(std::vector<uint8_t>& out, T v) {
+  uint8_t b[sizeof(T)];
+  memcpy(b, &v, sizeof(T));   // Cortex-M and the bridge are both little-endian
+  out.insert(out.end(), b, b + sizeof(T));
+}
+
+// --- Public API -----------------------------------------------------------
+
+void init_scope() {
+  scope_arm(SCOPE_TRIG_ALL, SCOPE_DEFAULT_PRE, SCOPE_DEFAULT_POST, 1U);
+}
+
+void scope_sample(const PowerSnapshot& p, uint16_t flags) {
+  if (s_req_pending) adopt_request();
+
+  const ScopeState state = s_state;
+  if (state != SCOPE_ARMED && state != SCOPE_TRIGGERED) return;
+
+  // Edges are looked for every tick, whatever the decimation
+  const uint8_t fired = (state == SCOPE_ARMED) ? triggers_fired(flags) : 0U;
+  s_prev_flags = flags;
+
+  // The trigger record is always taken, and restarts the decimation
+  if (!fired && ++s_div < s_decimation) return;
+  s_div = 0;
+
+  const uint32_t idx = s_head;
+  ScopeSample& s = s_buf[idx];
+  s.volt     = p.probeVoltageOutput;
+  s.curr     = p.probeCurrent;
+  s.curr_set = p.setCurrent;
+  s.duty     = duty_to_u16(igbt_applied_duty());
+  s.flags    = flags;
+  s_head = (idx + 1U == SCOPE_DEPTH) ? 0U : idx + 1U;
+  if (s_filled < SCOPE_DEPTH) s_filled++;
+
+  if (fired) {
+    const uint32_t have = s_filled - 1U;
+    s_len_pre    = (have < s_pre) ? have : s_pre;
+    s_start      = (idx + SCOPE_DEPTH - s_len_pre) % SCOPE_DEPTH;
+    s_fired      = fired;
+    s_trigger_us = p.timestamp_us;
+    s_post_left  = s_post - 1U;   // The trigger record is the first
+    s_state      = SCOPE_TRIGGERED;
+  } else if (s_post_left) {
+    s_post_left--;
+  }
+
+  if (s_state == SCOPE_TRIGGERED && s_post_left == 0U) {
+    s_len_post = s_post;
+    s_capture  = s_capture + 1U;
+    s_state    = SCOPE_FROZEN;
+  }
+}
+
+int scope_arm(uint32_t mask, uint32_t pre, uint32_t post, uint32_t decimation) {
+  if (mask & ~SCOPE_TRIG_ALL) return SCOPE_ERR_PARAM;
+  if (post < 1U || post > SCOPE_DEPTH || pre > SCOPE_DEPTH - post) return SCOPE_ERR_PARAM;
+  if (decimation < 1U || decimation > SCOPE_MAX_DECIMATION) return SCOPE_ERR_PARAM;
+
+  const uint32_t primask = __get_PRIMASK();
+  __disable_irq();
+  s_req.mask       = mask;
+  s_req.pre        = pre;
+  s_req.post       = post;
+  s_req.decimation = decimation;
+  s_req_pending    = true;
+  __set_PRIMASK(primask);
+  return 1;
+}
+
+int scope_trigger() {
+  if (s_state != SCOPE_ARMED || !(s_mask & SCOPE_TRIG_MANUAL)) return 0;
+  s_manual = true;
+  return 1;
+}
+
+std::vector<uint8_t> scope_status() {
+  const uint8_t state  = s_state;
+  const bool    frozen = (state == SCOPE_FROZEN);
+
+  std::vector<uint8_t> out;
+  out.reserve(28);
+  put<uint8_t>(out, SCOPE_VERSION);
+  put<uint8_t>(out, state);
+  put<uint8_t>(out, sizeof(ScopeSample));
+  put<uint8_t>(out, frozen ? s_fired : 0U);
+  put<uint32_t>(out, s_capture);
+  put<uint16_t>(out, (uint16_t)(frozen ? s_len_pre : s_pre));
+  put<uint16_t>(out, (uint16_t)(frozen ? s_len_post : s_post));
+  put<uint16_t>(out, (uint16_t)s_decimation);
+  put<uint16_t>(out, 0);
+  put<uint32_t>(out, CONTROL_RATE_HZ);
+  put<uint64_t>(out, frozen ? s_trigger_us : 0U);
+  return out;
+}
+
+std::vector<uint8_t> scope_read(uint32_t capture, uint32_t offset, uint32_t max_samples) {
+  std::vector<uint8_t> out;
+  if (s_state != SCOPE_FROZEN || capture != s_capture) return out;
+
+  const uint32_t len = s_len_pre + s_len_post;
+  if (offset >= len) return out;
+  uint32_t n = len - offset;
+  if (n > max_samples) n = max_samples;
+
+  out.resize(n * sizeof(ScopeSample));
+  for (uint32_t i = 0; i < n; ++i) {
+    const uint32_t idx = (s_start + offset + i) % SCOPE_DEPTH;
+    memcpy(&out[i * sizeof(ScopeSample)], &s_buf[idx], sizeof(ScopeSample));
+  }
+  return out;
+}
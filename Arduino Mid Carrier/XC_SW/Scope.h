@@ -0,0 +1,73 @@
+#ifndef SCOPE_H
+#define SCOPE_H
+
+#include "Config.h"
+#include "PowerState.h"
+#include <vector>
+
+// Triggered capture of the control loop. Every decimation-th control
+// tick one record goes into a RAM ring; a trigger freezes `pre` records
+// before it and `post` records from it on, until the next scope_arm().
+#define SCOPE_DEPTH             2048U   // Records in the ring (32 KiB)
+#define SCOPE_VERSION           1
+#define SCOPE_DEFAULT_PRE       512U    // 25.6 ms at CONTROL_RATE_HZ
+#define SCOPE_DEFAULT_POST      (SCOPE_DEPTH - SCOPE_DEFAULT_PRE)
+#define SCOPE_MAX_DECIMATION    255U
+
+// Trigger sources (scope_arm() mask, and which one fired in the status)
+#define SCOPE_TRIG_RUN_WAVE   (1U << 0)   // runCurrentWave rising
+#define SCOPE_TRIG_IGBT_FAULT (1U << 1)   // IgbtFaultState rising
+#define SCOPE_TRIG_FAST_TRIP  (1U << 2)   // Hardware trip latched
+#define SCOPE_TRIG_MANUAL     (1U << 3)   // scope_trigger()
+#define SCOPE_TRIG_ALL        0x0FU
+
+enum ScopeState : uint8_t {
+  SCOPE_IDLE = 0,     // Not recording
+  SCOPE_ARMED,        // Filling the pre-trigger history
+  SCOPE_TRIGGERED,    // Recording the post-trigger part
+  SCOPE_FROZEN        // Record complete, readable with scope_read()
+};
+
+#define SCOPE_ERR_PARAM  (-1)
+
+// One record, little-endian on the wire (16 bytes)
+struct ScopeSample {
+  float    volt;       // probeVoltageOutput, V
+  float    curr;       // probeCurrent, A
+  float    curr_set;   // setCurrent, A
+  uint16_t duty;       // Applied IGBT duty, 65535 = 100 %
+  uint16_t flags;      // TLM_FLAG_* (see Telemetry.h)
+};
+
+// Arm on SCOPE_TRIG_RUN_WAVE | SCOPE_TRIG_IGBT_FAULT | SCOPE_TRIG_FAST_TRIP
+// | SCOPE_TRIG_MANUAL with the default depths, at the control rate
+void init_scope();
+
+// Control tick, with the snapshot power_state_publish() returned and its
+// telemetry_flags()
+void scope_sample(const PowerSnapshot& p, uint16_t flags);
+
+// Discard the current record and re-arm. Takes effect at the next tick.
+// mask == 0 stops recording. pre + post <= SCOPE_DEPTH, post >= 1,
+// 1 <= decimation <= SCOPE_MAX_DECIMATION. Returns 1 or SCOPE_ERR_PARAM.
+int scope_arm(uint32_t mask, uint32_t pre, uint32_t post, uint32_t decimation);
+
+// Manual trigger. Returns 1, or 0 if the scope is not armed for it.
+int scope_trigger();
+
+// Little-endian status blob:
+//   u8 version, u8 state, u8 record size, u8 trigger that fired,
+//   u32 capture (records frozen since boot), u16 pre, u16 post,
+//   u16 decimation, u16 reserved, u32 control rate (Hz),
+//   u64 trigger time (µs, PowerSnapshot::timestamp_us)
+// pre/post are the frozen record's lengths once SCOPE_FROZEN, the armed
+// configuration before.
+std::vector<uint8_t> scope_status();
+
+// Up to max_samples records of the frozen capture from `offset` on, oldest
+// first (the trigger is record `pre`). Empty unless `capture` is the frozen
+// one. A re-arm during a download starts a new capture: compare the
+// status afterwards.
+std::vector<uint8_t> scope_read(uint32_t capture, uint32_t offset, uint32_t max_samples);
+
+#endif // SCOPE_H
@@ -0,0 +1,167 @@
+#include "ScrPulse.h"
+#include "AdcScan.h"
+#include "SensorConv.h"
+#include "EventLog.h"
+#include <Arduino.h>
+#include "stm32h7xx_hal.h"
+
+// ----- TIM16 one-pulse (PF6 / CH1) -----
+// PWM2 from a stopped counter: OC1REF goes active at CCR1 and the update
+// at ARR clears CEN, so one trigger gives exactly one delayed pulse
+#define SCR_TIMER_CLOCK_HZ  200000000U   // TIM16 kernel clock, as TIM1/TIM3
+#define SCR_COUNT_HZ        10000000U    // 0.1 µs per count
+
+static TIM_HandleTypeDef s_tim = {};
+static bool              s_ready = false;
+static bool              s_window = false;  // AWD3 threshold programmed
+static volatile bool     s_armed = false;   // AWD3 interrupt enabled
+
+// ----- Firing log (written from ADC_IRQn) -----
+static volatile uint32_t s_log[SCR_PULSE_LOG_LEN] = {};
+static volatile uint32_t s_count = 0;
+
+// --- Helpers --------------------------------------------------------------
+
+static inline uint32_t us_to_counts(float us) {
+  return (us <= 0.0f) ? 0U : (uint32_t)(us * (float)(SCR_COUNT_HZ / 1000000U) + 0.5f);
+}
+
+// CCR1 = delay + 1: at CCR1 = 0 the stopped counter would hold the output
+// active. Costs 0.1 µs of extra delay.
+static bool pulse_counts(uint32_t& ccr, uint32_t& arr) {
+  float delay = SCR_PULSE_DELAY_US, width = SCR_PULSE_WIDTH_US;
+  if (!(delay >= 0.0f)) delay = 0.0f;
+  if (!(width > 0.0f)) return false;
+  if (delay + width > SCR_PULSE_MAX_SPAN_US) return false;
+
+  uint32_t w = us_to_counts(width);
+  if (w == 0U) w = 1U;
+  ccr = us_to_counts(delay) + 1U;
+  arr = ccr + w - 1U;
+  return arr <= 65535U;
+}
+
+// Uncalibrated probe: window wide open, as the fast trip does. Arming is
+// left to scr_pulse_service().
+static void program_window() {
+  uint16_t high = 4095U;
+  if (VScale_C > 0.0f) high = sensor_units_to_raw(SENSOR_CURRENT, SCR_FIRE_CURRENT_A, 4095U);
+  s_window = adc_scan_set_scr_watchdog(0U, high);
+}
+
+// --- Public API -----------------------------------------------------------
+
+void init_scr_pulse() {
+  __HAL_RCC_TIM16_CLK_ENABLE();
+  __HAL_RCC_GPIOF_CLK_ENABLE();
+  __HAL_RCC_GPIOB_CLK_ENABLE();
+
+  uint32_t ccr, arr;
+  if (!pulse_counts(ccr, arr)) return;
+
+  s_tim.Instance               = TIM16;
+  s_tim.Init.Prescaler         = SCR_TIMER_CLOCK_HZ / SCR_COUNT_HZ - 1U;
+  s_tim.Init.CounterMode       = TIM_COUNTERMODE_UP;
+  s_tim.Init.Period            = arr;
+  s_tim.Init.ClockDivision     = TIM_CLOCKDIVISION_DIV1;
+  s_tim.Init.RepetitionCounter = 0;
+  s_tim.Init.AutoReloadPreload = TIM_AUTORELOAD_PRELOAD_DISABLE;
+  if (HAL_TIM_OnePulse_Init(&s_tim, TIM_OPMODE_SINGLE) != HAL_OK) return;
+
+  TIM_OC_InitTypeDef oc = {};
+  oc.OCMode      = TIM_OCMODE_PWM2;
+  oc.Pulse       = ccr;
+  oc.OCPolarity  = TIM_OCPOLARITY_LOW;    // Trigger is active low
+  oc.OCFastMode  = TIM_OCFAST_DISABLE;
+  oc.OCIdleState = TIM_OCIDLESTATE_RESET;
+  if (HAL_TIM_PWM_ConfigChannel(&s_tim, &oc, TIM_CHANNEL_1) != HAL_OK) return;
+
+  // Enable the output without HAL_TIM_PWM_Start(), which would set CEN
+  // and fire a pulse
+  s_tim.Instance->CCER |= TIM_CCER_CC1E;
+  __HAL_TIM_MOE_ENABLE(&s_tim);
+
+  // Hand PF6 to the timer only now: the stopped channel sits at its
+  // inactive (high) level, as init_enable_control() left the pin
+  GPIO_InitTypeDef gpio = {};
+  gpio.Pin       = GPIO_PIN_6;
+  gpio.Mode      = GPIO_MODE_AF_PP;
+  gpio.Pull      = GPIO_NOPULL;
+  gpio.Speed     = GPIO_SPEED_FREQ_HIGH;
+  gpio.Alternate = GPIO_AF1_TIM16;
+  HAL_GPIO_Init(GPIOF, &gpio);
+
+  s_ready = true;
+  program_window();
+}
+
+void scr_pulse_apply_config() {
+  if (!s_ready) return;
+  uint32_t ccr, arr;
+  if (pulse_counts(ccr, arr) && !scr_pulse_busy()) {
+    s_tim.Instance->CCR1 = ccr;
+    s_tim.Instance->ARR  = arr;
+    s_tim.Init.Period    = arr;
+  }
+  program_window();
+}
+
+void scr_pulse_apply_threshold() {
+  if (s_ready) program_window();
+}
+
+bool scr_pulse_fire() {
+  if (!s_ready) return false;
+  s_armed = false;
+
+  TIM_TypeDef* tim = s_tim.Instance;
+  if (!(tim->CR1 & TIM_CR1_CEN)) {
+    // Inhibit off (PB10 high) before the gate pulse can start
+    HAL_GPIO_WritePin(GPIOB, GPIO_PIN_10, GPIO_PIN_SET);
+    tim->CNT = 0U;
+    tim->CR1 |= TIM_CR1_CEN;
+  }
+  return true;
+}
+
+void scr_pulse_log_fire() {
+  const uint32_t n = s_count;
+  s_log[n % SCR_PULSE_LOG_LEN] = micros();
+  s_count = n + 1U;
+  event_log_add(EVT_SCR_FIRE, 0, (float)(n + 1U));
+}
+
+void scr_pulse_service(bool running, float probe_current) {
+  if (!s_window) return;
+  if (!running) {
+    if (s_armed) {
+      s_armed = false;
+      adc_scan_arm_scr_watchdog(false);
+    }
+    return;
+  }
+  if (s_armed || scr_pulse_busy()) return;
+  if (probe_current < SCR_FIRE_CURRENT_A) {
+    s_armed = true;
+    adc_scan_arm_scr_watchdog(true);
+  }
+}
+
+bool scr_pulse_ready() { return s_ready; }
+
+bool scr_pulse_busy() {
+  return s_ready && (s_tim.Instance->CR1 & TIM_CR1_CEN) != 0U;
+}
+
+uint32_t scr_pulse_count() { return s_count; }
+
+size_t scr_pulse_log(uint32_t* out, size_t max) {
+  const uint32_t primask = __get_PRIMASK();
+  __disable_irq();
+  const uint32_t count = s_count;
+  size_t n = (count < SCR_PULSE_LOG_LEN) ? count : SCR_PULSE_LOG_LEN;
+  if (n > max) n = max;
+  for (size_t i = 0; i < n; ++i) out[i] = s_log[(count - n + i) % SCR_PULSE_LOG_LEN];
+  __set_PRIMASK(primask);
+  return n;
+}
@@ -0,0 +1,48 @@
+#ifndef SCR_PULSE_H
+#define SCR_PULSE_H
+
+#include "Config.h"
+
+// Hardware-timed SCR crowbar pulse. ADC1 AWD3 watches the current rank
+// against SCR_FIRE_CURRENT_A; its interrupt (ADC_IRQn, see FastTrip)
+// releases DPIN_SCR_INHIB and starts TIM16 in one-pulse mode, which drives
+// DPIN_SCR_TRIG (PF6, TIM16_CH1, active low) after SCR_PULSE_DELAY_US for
+// SCR_PULSE_WIDTH_US. No loop tick or filter sits in the firing path.
+// AWD3 is only armed while a waveform runs, so an idle output never
+// releases the inhibit.
+#define SCR_PULSE_LOG_LEN     8U          // Firing timestamps kept
+#define SCR_PULSE_MAX_SPAN_US 6500.0f     // Delay + width (16-bit count at 0.1 µs)
+
+// Configure TIM16 and PF6 and arm the watchdog. Call after
+// init_enable_control(), init_adc_scan() and init_fast_trip().
+void init_scr_pulse();
+
+// Re-program the pulse and the fire threshold from SCR_FIRE_CURRENT_A,
+// SCR_PULSE_DELAY_US, SCR_PULSE_WIDTH_US and the current calibration
+void scr_pulse_apply_config();
+
+// Re-program only the fire threshold (SCR_FIRE_CURRENT_A and the current
+// calibration); called from fast_trip_apply_thresholds()
+void scr_pulse_apply_threshold();
+
+// ADC_IRQn, on an AWD3 event: start the pulse. False if the timer path is
+// not set up. The watchdog stays masked until scr_pulse_service() re-arms it.
+bool scr_pulse_fire();
+
+// ADC_IRQn, after scr_pulse_fire() and the gate bookkeeping: log the firing
+void scr_pulse_log_fire();
+
+// Control tick: arm AWD3 while `running` once any pulse is over and the
+// measured current is below the threshold; mask it while not running
+void scr_pulse_service(bool running, float probe_current);
+
+bool scr_pulse_ready();   // TIM16 owns DPIN_SCR_TRIG
+bool scr_pulse_busy();    // Delay or pulse in progress
+
+uint32_t scr_pulse_count();   // Firings since boot
+
+// micros() of the last firings, oldest first. Returns how many were
+// written to `out` (at most min(max, SCR_PULSE_LOG_LEN)).
+size_t scr_pulse_log(uint32_t* out, size_t max);
+
+#endif // SCR_PULSE_H
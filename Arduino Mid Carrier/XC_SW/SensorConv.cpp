@@ -0,0 +1,68 @@
+#include "SensorConv.h"
+
+SensorCal sensor_cal_table[SENSOR_NUM_LINEAR] = {
+  sensor_cal_from(DEFAULT_VSCALE_V, DEFAULT_VOFFSET_V),
+  sensor_cal_from(DEFAULT_VSCALE_C, DEFAULT_VOFFSET_C),
+};
+
+// ----- Temperature table -----
+// Sensor transfer curve in volts, tabulated at compile time over the 12-bit
+// range and interpolated linearly (error < 0.1 °C against the cubic)
+#define TEMP_LUT_SHIFT   6                                   // 64 counts per step
+#define TEMP_LUT_POINTS  ((4096 >> TEMP_LUT_SHIFT) + 1)
+
+struct TempLut {
+  float t[TEMP_LUT_POINTS];
+};
+
+static constexpr float temp_poly(float v) {
+  return -7.22f + v * (121.0f + v * (-69.3f + v * 18.4f));
+}
+
+static constexpr TempLut make_temp_lut() {
+  TempLut lut = {};
+  for (int i = 0; i < TEMP_LUT_POINTS; ++i) {
+    const float v = (float)(i << TEMP_LUT_SHIFT) * (SENSOR_ADC_VREF / SENSOR_ADC_FULL_SCALE);
+    lut.t[i] = temp_poly(v);
+  }
+  return lut;
+}
+
+static constexpr TempLut s_temp_lut = make_temp_lut();
+
+// --- Public API -----------------------------------------------------------
+
+void sensor_conv_update() {
+  const SensorCal v = sensor_cal_from(VScale_V, VOffset_V);
+  const SensorCal c = sensor_cal_from(VScale_C, VOffset_C);
+
+  // Both words of a pair change together as seen from the control tick
+  const uint32_t primask = __get_PRIMASK();
+  __disable_irq();
+  sensor_cal_table[SENSOR_VOLTAGE] = v;
+  sensor_cal_table[SENSOR_CURRENT] = c;
+  __set_PRIMASK(primask);
+}
+
+void sensor_to_units_block(SensorChannel ch, const uint16_t* raw, float* out, size_t n) {
+  const SensorCal c = sensor_cal_table[ch];
+  for (size_t i = 0; i < n; ++i) out[i] = (float)raw[i] * c.gain + c.bias;
+}
+
+uint16_t sensor_units_to_raw(SensorChannel ch, float value, uint16_t fallback) {
+  const SensorCal c = sensor_cal_table[ch];
+  if (c.gain == 0.0f) return fallback;
+  const float raw = (value - c.bias) / c.gain;
+  if (!(raw > 0.0f)) return 0U;
+  if (raw >= SENSOR_ADC_FULL_SCALE) return 4095U;
+  return (uint16_t)(raw + 0.5f);
+}
+
+float sensor_temperature_c(float raw) {
+  if (!(raw > 0.0f)) return s_temp_lut.t[0];
+  if (raw > SENSOR_ADC_FULL_SCALE) raw = SENSOR_ADC_FULL_SCALE;
+  const float pos  = raw * (1.0f / (1 << TEMP_LUT_SHIFT));
+  const int   i    = (int)pos;
+  const float frac = pos - (float)i;
+  return s_temp_lut.t[i] + (s_temp_lut.t[i + 1] - s_temp_lut.t[i]) * frac;
+}
@@ -0,0 +1,52 @@
+#ifndef SENSOR_CONV_H
+#define SENSOR_CONV_H
+
+#include "Config.h"
+
+// Raw 12-bit ADC codes to engineering units. The probes are bipolar around
+// mid-rail:  value = (raw / 4095 * 3.3 - 1.65) * scale + offset
+// which folds into one multiply-add per sample:  value = raw * gain + bias
+#define SENSOR_ADC_FULL_SCALE  4095.0f
+#define SENSOR_ADC_VREF        3.3f
+#define SENSOR_PROBE_MID_V     1.65f
+
+enum SensorChannel : uint8_t {
+  SENSOR_VOLTAGE = 0,
+  SENSOR_CURRENT,
+  SENSOR_NUM_LINEAR
+};
+
+struct SensorCal {
+  float gain;   // units per count
+  float bias;   // units at raw == 0
+};
+
+constexpr SensorCal sensor_cal_from(float scale, float offset) {
+  return { scale * (SENSOR_ADC_VREF / SENSOR_ADC_FULL_SCALE),
+           offset - SENSOR_PROBE_MID_V * scale };
+}
+
+// Coefficients in use; start out at the DEFAULT_* calibration
+extern SensorCal sensor_cal_table[SENSOR_NUM_LINEAR];
+
+// Recompute the coefficients from VScale_*/VOffset_*.
+// Call after changing any of them.
+void sensor_conv_update();
+
+static inline float sensor_to_units(SensorChannel ch, int raw) {
+  const SensorCal& c = sensor_cal_table[ch];
+  return (float)raw * c.gain + c.bias;
+}
+
+// Convert a block of samples, e.g. a DMA scan buffer
+void sensor_to_units_block(SensorChannel ch, const uint16_t* raw, float* out, size_t n);
+
+// Inverse, rounded and clamped to 0..4095. Returns `fallback` when the
+// channel is uncalibrated (zero gain).
+uint16_t sensor_units_to_raw(SensorChannel ch, float value, uint16_t fallback);
+
+// Internal temperature sensor (°C) from its 12-bit code (fractional
+// counts allowed, e.g. an average), by table lookup
+float sensor_temperature_c(float raw);
+
+#endif // SENSOR_CONV_H
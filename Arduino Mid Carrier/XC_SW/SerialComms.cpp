@@ -10,10 +10,39 @@
 #include "Current.h"
 #include "EnableControl.h"
 #include "Temperature.h"
+#include "SensorConv.h"
 #include "Config.h"
 #include "PowerState.h" 
 #include "SerialRPC.h" 
 #include "IGBT.h"
+#include "CurrWaveform.h"
+#include "Scheduler.h"
+#include "LoopProfile.h"
+#include "Telemetry.h"
+#include "CurrentPI.h"
+#include "FastTrip.h"
+#include "ScrPulse.h"
+#include "SignalFilter.h"
+#include "Notify.h"
+#include "Scope.h"
+#include "EventLog.h"
+#include "ParamRegistry.h"
+#include "ParamStore.h"
+#include "stm32h7xx_hal.h"
+
+#if XC_LOOP_PROFILE
+// Times a scalar getter as PROF_RPC_GETTER before returning its value
+template <typename R, R (*Getter)()>
+static R profiled_getter() {
+  const uint32_t t0 = loop_profile_now();
+  const R r = Getter();
+  loop_profile_record(PROF_RPC_GETTER, loop_profile_now() - t0);
+  return r;
+}
+#define RPC_GETTER(type, fn) profiled_getter<type, fn>
+#else
+#define RPC_GETTER(type, fn) fn
+#endif
  
 
 void init_serial_comms() {
@@ -23,10 +52,31 @@ void init_serial_comms() {
   RPC.begin();  
   //Serial.println("✓ RPC.begin");
 
+  // The doorbell from the M7 that RPC.begin() enables only wakes the RPC
+  // thread: keep it below the control tick
+  HAL_NVIC_SetPriority(HSEM2_IRQn, IRQ_PRIO_COMMS, 0);
+
   //Serial.println("→ Binding RPC functions...");
   RPC.bind("get_poll_data", []() -> uint64_t {
-  return get_poll_data();
+  uint64_t word;
+  PROFILE_STAGE(PROF_RPC_POLL, word = get_poll_data());
+  return word;
   }); 
+  RPC.bind("get_poll_data_temp", get_poll_data_temp);
+  RPC.bind("get_telemetry", get_telemetry);
+  RPC.bind("load_waveform", [](const std::vector<uint8_t>& blob) -> int {
+    return load_waveform(blob);
+  });
+  RPC.bind("param_set_many", [](const std::vector<uint8_t>& blob) -> int {
+    int applied;
+    PROFILE_STAGE(PROF_RPC_EVENT, applied = set_params(blob));
+    return applied;
+  });
+  RPC.bind("param_get_many", get_params);
+  RPC.bind("param_hash", get_param_hash);
+  RPC.bind("param_save", save_params);
+  RPC.bind("param_store_seq", get_param_store_seq);
+  RPC.bind("waveform_generation", get_waveform_generation);
 
   RPC.bind("mode_set", [](int mode){
       //RPC.call("set_value", "mode_set", mode);
@@ -36,42 +86,156 @@ void init_serial_comms() {
   RPC.bind("process_event_in_uc", [](std::string s) {
     ////Serial.println("[RAW-RPC] " + String(s.c_str()));
     //Serial.flush();
-    return process_event_in_uc(s);
+    int ack;
+    PROFILE_STAGE(PROF_RPC_EVENT, ack = process_event_in_uc(s));
+    return ack;
   }); 
 
-  RPC.bind("volt_act", get_volt_act);
-  RPC.bind("volt_set", get_volt_set);
-  RPC.bind("curr_act", get_curr_act);
-  RPC.bind("curr_set", get_curr_set);
-  RPC.bind("internal_temperature", get_internal_temperature);
-  RPC.bind("inter_enable", get_internal_enable_state);
-  RPC.bind("extern_enable", get_external_enable_state);
-  RPC.bind("warn_lamp", get_warn_lamp_test_state); 
-  RPC.bind("dump_fan", get_dump_fan_state); 
-  RPC.bind("dump_relay", get_dump_relay_state); 
-  RPC.bind("charger_relay", get_charger_relay_state); 
-  RPC.bind("scr_trig", get_scr_trig_state);
-  RPC.bind("scr_inhib", get_scr_inhib_state); 
-  RPC.bind("igbt_fault", get_igbt_fault_state);
+  RPC.bind("volt_act", RPC_GETTER(float, get_volt_act));
+  RPC.bind("volt_set", RPC_GETTER(float, get_volt_set));
+  RPC.bind("curr_act", RPC_GETTER(float, get_curr_act));
+  RPC.bind("curr_set", RPC_GETTER(float, get_curr_set));
+  RPC.bind("internal_temperature", RPC_GETTER(float, get_internal_temperature));
+  RPC.bind("temp_rate", RPC_GETTER(float, get_internal_temperature_rate));
+  RPC.bind("inter_enable", RPC_GETTER(int, get_internal_enable_state));
+  RPC.bind("extern_enable", RPC_GETTER(int, get_external_enable_state));
+  RPC.bind("warn_lamp", RPC_GETTER(int, get_warn_lamp_test_state)); 
+  RPC.bind("dump_fan", RPC_GETTER(int, get_dump_fan_state)); 
+  RPC.bind("dump_relay", RPC_GETTER(int, get_dump_relay_state)); 
+  RPC.bind("charger_relay", RPC_GETTER(int, get_charger_relay_state)); 
+  RPC.bind("scr_trig", RPC_GETTER(int, get_scr_trig_state));
+  RPC.bind("scr_inhib", RPC_GETTER(int, get_scr_inhib_state)); 
+  RPC.bind("igbt_fault", RPC_GETTER(int, get_igbt_fault_state));
+  RPC.bind("sched_overruns", get_sched_overruns);
+  RPC.bind("sched_jitter", get_sched_jitter);
+  RPC.bind("sched_jitter_reset", []() -> int { sched_jitter_reset(); return 1; });
+  RPC.bind("get_pi_log", get_pi_log);
+  RPC.bind("pi_log_dropped", get_pi_log_dropped);
+  RPC.bind("trip_status", get_trip_status);
+  RPC.bind("trip_count", get_trip_count);
+  RPC.bind("trip_clear", clear_trip);
+  RPC.bind("scr_fire_count", get_scr_fire_count);
+  RPC.bind("scr_fire_log", get_scr_fire_log);
+  RPC.bind("event_log_read", get_event_log);
+  RPC.bind("event_log_head", get_event_log_head);
+  RPC.bind("scope_arm", set_scope_arm);
+  RPC.bind("scope_trigger", scope_manual_trigger);
+  RPC.bind("scope_status", get_scope_status);
+  RPC.bind("scope_read", get_scope_read);
+  RPC.bind("set_filter", set_filter);
+  RPC.bind("filter_delay_us", get_filter_delay_us);
+  RPC.bind("notify_config", set_notify_config);
+  RPC.bind("notify_deadband", set_notify_deadband);
+
+#if XC_LOOP_PROFILE
+  RPC.bind("get_loop_profile", get_loop_profile);
+  RPC.bind("reset_loop_profile", []() -> int { reset_loop_profile(); return 1; });
+#endif
   ////Serial.println("✓ RPC functions bound.");
 }
 
-float get_volt_set() { return PowerState::setVoltage; }
-float get_curr_set() { return PowerState::setCurrent; }
-int get_warn_lamp_test_state() { return PowerState::warnLampTestState ? 1 : 0; }
-float get_volt_act() { return PowerState::probeVoltageOutput; }
-float get_curr_act() { return PowerState::probeCurrent; }
-float get_internal_temperature() { return PowerState::internalTemperature; }
+// Getters read the published snapshot: the live statics belong to the tick.
+// A read that loses to the publish repeats the last good copy, not zeros.
+static PowerSnapshot s_last = {};   // RPC thread only
 
-int get_internal_enable_state() { return PowerState::internalEnable ? 1 : 0; }
-int get_external_enable_state() { return PowerState::externalEnable ? 1 : 0; } 
+static const PowerSnapshot& snapshot() {
+  power_state_snapshot(s_last);
+  return s_last;
+}
 
-int get_dump_fan_state() { return PowerState::DumpFan ? 1 : 0; }
-int get_dump_relay_state() { return PowerState::DumpRelay ? 0 : 1; }
-int get_charger_relay_state() { return PowerState::ChargerRelay ? 1 : 0; } 
-int get_scr_trig_state() { return PowerState::ScrTrig ? 1 : 0; }
-int get_scr_inhib_state() { return PowerState::ScrInhib ? 1 : 0; } 
-int get_igbt_fault_state() { return PowerState::IgbtFaultState ? 1 : 0; }
+float get_volt_set() { return snapshot().setVoltage; }
+float get_curr_set() { return snapshot().setCurrent; }
+int get_warn_lamp_test_state() { return snapshot().warnLampTestState ? 1 : 0; }
+float get_volt_act() { return snapshot().probeVoltageOutput; }
+float get_curr_act() { return snapshot().probeCurrent; }
+float get_internal_temperature() { return snapshot().internalTemperature; }
+float get_internal_temperature_rate() { return snapshot().internalTemperatureRate; }
+
+int get_internal_enable_state() { return snapshot().internalEnable ? 1 : 0; }
+int get_external_enable_state() { return snapshot().externalEnable ? 1 : 0; } 
+
+int get_dump_fan_state() { return snapshot().DumpFan ? 1 : 0; }
+int get_dump_relay_state() { return snapshot().DumpRelay ? 0 : 1; }
+int get_charger_relay_state() { return snapshot().ChargerRelay ? 1 : 0; } 
+int get_scr_trig_state() { return snapshot().ScrTrig ? 1 : 0; }
+int get_scr_inhib_state() { return snapshot().ScrInhib ? 1 : 0; } 
+int get_igbt_fault_state() { return snapshot().IgbtFaultState ? 1 : 0; }
+int load_waveform(const std::vector<uint8_t>& blob) {
+  return (int)curr_waveform_load_blob(blob.data(), blob.size());
+}
+uint32_t get_waveform_generation() { return curr_waveform_generation(); }
+int set_params(const std::vector<uint8_t>& blob) { return param_set_many(blob.data(), blob.size()); }
+std::vector<uint8_t> get_params(const std::vector<uint8_t>& ids) {
+  std::vector<uint8_t> out(PARAM_BATCH_HEADER + PARAM_BATCH_RECORD *
+                           (ids.size() > param_count() ? ids.size() : param_count()));
+  out.resize(param_get_many(ids.data(), ids.size(), out.data()));
+  return out;
+}
+uint32_t get_param_hash(const std::vector<uint8_t>& ids) { return param_store_hash(ids.data(), ids.size()); }
+int save_params() { return param_store_save(); }
+uint32_t get_param_store_seq() { return param_store_seq(); }
+// Task ids follow registration order in setup(); pass -1 for the total
+uint32_t get_sched_overruns(int task) { return sched_overruns(task); }
+
+std::vector<uint8_t> get_sched_jitter() {
+  SchedJitter j;
+  sched_jitter(j);
+  const uint32_t budget = CONTROL_LATENCY_BUDGET_NS;
+  std::vector<uint8_t> out(8U + sizeof(j));
+  out[0] = 2;   // version
+  out[1] = SCHED_JITTER_BINS;
+  memcpy(&out[4], &budget, 4);
+  memcpy(&out[8], &j, sizeof(j));   // Cortex-M and the bridge are both little-endian
+  return out;
+}
+std::vector<uint8_t> get_pi_log() { return current_pi_log_drain(PI_LOG_RPC_MAX); }
+uint32_t get_pi_log_dropped() { return current_pi_log_dropped(); }
+uint32_t get_trip_status() { return fast_trip_status(); }
+uint32_t get_trip_count() { return fast_trip_count(); }
+uint32_t clear_trip() { return fast_trip_clear(); }
+
+uint32_t get_scr_fire_count() { return scr_pulse_count(); }
+
+std::vector<uint32_t> get_scr_fire_log() {
+  uint32_t ts[SCR_PULSE_LOG_LEN];
+  const size_t n = scr_pulse_log(ts, SCR_PULSE_LOG_LEN);
+  return std::vector<uint32_t>(ts, ts + n);
+}
+
+std::vector<uint8_t> get_event_log(uint32_t cursor) { return event_log_read(cursor, EVENT_LOG_RPC_MAX); }
+uint32_t get_event_log_head() { return event_log_head(); }
+
+int set_scope_arm(int mask, int pre, int post, int decimation) {
+  if (mask < 0 || pre < 0 || post < 0 || decimation < 0) return SCOPE_ERR_PARAM;
+  return scope_arm((uint32_t)mask, (uint32_t)pre, (uint32_t)post, (uint32_t)decimation);
+}
+int scope_manual_trigger() { return scope_trigger(); }
+std::vector<uint8_t> get_scope_status() { return scope_status(); }
+std::vector<uint8_t> get_scope_read(uint32_t capture, uint32_t offset) {
+  return scope_read(capture, offset, SCOPE_RPC_MAX);
+}
+
+int set_filter(int channel, int type, float cutoff_hz, int order_or_len) {
+  if (channel < 0 || channel >= FILTER_NUM_CHANNELS) return FILTER_ERR_CHANNEL;
+  if (type < 0 || type > 0xFF) return FILTER_ERR_TYPE;
+  if (order_or_len < 0 || order_or_len > FILTER_MAX_AVG_LEN) return FILTER_ERR_PARAM;
+  FilterConfig cfg = {};
+  cfg.type      = (uint8_t)type;
+  cfg.cutoff_hz = cutoff_hz;
+  if (type == FILTER_BIQUAD) cfg.order  = (uint8_t)order_or_len;
+  else                       cfg.length = (uint16_t)order_or_len;
+  const int err = filter_configure((FilterChannel)channel, cfg);
+  return err ? err : 1;
+}
+float get_filter_delay_us(int channel) {
+  if (channel < 0 || channel >= FILTER_NUM_CHANNELS) return 0.0f;
+  return filter_group_delay_us((FilterChannel)channel);
+}
+
+int set_notify_config(int heartbeat_ms) {
+  return notify_configure(heartbeat_ms > 0 ? (uint32_t)heartbeat_ms : 0U);
+}
+int set_notify_deadband(int channel, float deadband) { return notify_set_deadband(channel, deadband); }
 
 
 int process_event_in_uc(const std::string& json_event_std)
@@ -93,100 +257,8 @@ int process_event_in_uc(const std::string& json_event_std)
     else if (jv.is<int>())          value = jv.as<int>();
     else if (jv.is<const char*>())  value = atof(jv.as<const char*>());
 
-    if (strcmp(name, "curr_set") == 0) {if (value < 0.0f) value = 0.0f; if (value > 3600.0f) value = 3600.0f; PowerState::setCurrent = value; return 1;}
-    else if (strcmp(name, "volt_set") == 0) {if (value < 0.0f) value = 0.0f; if (value > 285.0f) value = 285.0f; PowerState::setVoltage = value; return 1;}
-    else if (strcmp(name, "inter_enable") == 0) { PowerState::internalEnable = (value != 0.0f); return 1; }
-    else if (strcmp(name, "extern_enable") == 0) { PowerState::externalEnable = (value != 0.0f); return 1; }
-    else if (strcmp(name, "warn_lamp") == 0) { PowerState::warnLampTestState = (value != 0.0f); return 1; } 
-    else if (strcmp(name, "dump_fan") == 0) { PowerState::DumpFan = (value != 0.0f); return 1; } 
-    else if (strcmp(name, "dump_relay") == 0) { PowerState::DumpRelay = (value != 0.0f); return 1; } 
-    else if (strcmp(name, "charger_relay") == 0) { PowerState::ChargerRelay = (value != 0.0f); return 1; } 
-    else if (strcmp(name, "scr_trig") == 0) { PowerState::ScrTrig = (value != 0.0f); return 1; } 
-    else if (strcmp(name, "scr_inhib") == 0) { PowerState::ScrInhib = (value != 0.0f); return 1; }
-    else if (strcmp(name, "run_current_wave") == 0) { PowerState::runCurrentWave = (value != 0.0f); return 1; }
-    else if (strcmp(name, "t1") == 0)  { PowerState::currT1    = value; return 1; }
-    else if (strcmp(name, "t2") == 0)  { PowerState::currT2    = value; return 1; }
-    else if (strcmp(name, "th") == 0)  { PowerState::currTHold = value; return 1; }
-    else if (strcmp(name, "a1") == 0)  { PowerState::currA1    = value; return 1; }
-    else if (strcmp(name, "b1") == 0)  { PowerState::currB1    = value; return 1; }
-    else if (strcmp(name, "c1") == 0)  { PowerState::currC1    = value; return 1; }
-    else if (strcmp(name, "d1") == 0)  { PowerState::currD1    = value; return 1; }
-    else if (strcmp(name, "a2") == 0)  { PowerState::currA2    = value; return 1; }
-    else if (strcmp(name, "b2") == 0)  { PowerState::currB2    = value; return 1; }
-    else if (strcmp(name, "c2") == 0)  { PowerState::currC2    = value; return 1; }
-    else if (strcmp(name, "d2") == 0)  { PowerState::currD2    = value; return 1; }
-    else if (strcmp(name, "curr_scale") == 0) {
-      VScale_C = value;
-      return 1;
-    }
-    else if (strcmp(name, "curr_offset") == 0) {
-      VOffset_C = value;
-      return 1;
-    }
-    else if (strcmp(name, "volt_scale") == 0) {
-      VScale_V = value;
-      return 1;
-    }
-    else if (strcmp(name, "volt_offset") == 0) {
-      VOffset_V = value;
-      return 1;
-    }
-    else if (strcmp(name, "volt_pwm_full_scale") == 0) {
-      if (value < 1.0f) value = 1.0f;
-      VOLTAGE_PWM_FULL_SCALE = value;
-      return 1;
-    }
-    else if (strcmp(name, "min_load_res_ohm") == 0) {
-      if (value <= 0.0f) value = 1e-6f;
-      MIN_LOAD_RES_OHM = value;
-      return 1;
-    }
-    else if (strcmp(name, "igbt_min_duty_pct") == 0) {
-      if (value < 0.0f) value = 0.0f;
-      if (value > 100.0f) value = 100.0f;
-      IGBT_MIN_DUTY_PCT = value;
-      return 1;
-    }
-    else if (strcmp(name, "igbt_max_duty_pct") == 0) {
-      if (value < 0.0f) value = 0.0f;
-      if (value > 100.0f) value = 100.0f;
-      IGBT_MAX_DUTY_PCT = value;
-      return 1;
-    }
-    else if (strcmp(name, "current_limit_max") == 0) {
-      if (value < 0.0f) value = 0.0f;
-      CURRENT_LIMIT_MAX = value;
-      return 1;
-    }
-    else if (strcmp(name, "over_voltage_limit") == 0) {
-      if (value < 0.0f) value = 0.0f;
-      OVER_VOLTAGE_LIMIT = value;
-      return 1;
-    }
-    else if (strcmp(name, "warn_voltage_threshold") == 0) {
-      if (value < 0.0f) value = 0.0f;
-      WARN_VOLTAGE_THRESHOLD = value;
-      return 1;
-    }
-    else if (strcmp(name, "warn_blink_interval_ms") == 0) {
-      if (value < 0.0f) value = 0.0f;
-      WARN_BLINK_INTERVAL_MS = (unsigned long)(value + 0.5f);
-      return 1;
-    }
-    else if (strcmp(name, "debounce_delay_us") == 0) {
-      if (value < 0.0f) value = 0.0f;
-      DEBOUNCE_DELAY_US = (unsigned long)(value + 0.5f);
-      return 1;
-    } 
-    else if (strcmp(name, "igbt_pwm_freq_hz") == 0) {
-      if (value <= 0.0f) value = 1.0f; // Prevent zero/negative frequency
-      IGBT_PWM_FREQ_HZ = value;
-      init_igbt(); 
-      return 1;
-    }
-
-
-    return 0; // unknown name
+    // Clamping and follow-up work come from the parameter table
+    return param_set_name(name, value);
 }
 
 
@@ -198,12 +270,20 @@ static inline uint64_t mask_nbits(int32_t x, unsigned n) {
   return (uint64_t)( (uint32_t)x & ((n >= 32) ? 0xFFFFFFFFu : ((1u << n) - 1u)) );
 }
 
-// In SerialComms.cpp
+// Coherent snapshot of every live value from one control tick
+std::vector<uint8_t> get_telemetry() {
+    return telemetry_pack();
+}
 
+// Legacy two-packet poll word, kept for older bridges. Both packets are now
+// cut from the same telemetry frame rather than from live PowerState.
 uint64_t get_poll_data() {
     // Static variable to track which packet to send next
     static bool send_packet_zero = true;
 
+    TelemetryFrame f = {};
+    telemetry_latest(f);
+
     uint64_t word = 0;
 
     // For 20-bit signed resolution: -(2^19) to (2^19 - 1)
@@ -212,15 +292,10 @@ uint64_t get_poll_data() {
 
     if (send_packet_zero) {
         // --- PACKET 0: ID=0, Flags, Actuals ---
-        uint64_t flags =
-            ((uint64_t)(PowerState::externalEnable ? 1U : 0U) << 0) |
-            ((uint64_t)(PowerState::IgbtFaultState ? 1U : 0U) << 1) |
-            ((uint64_t)(PowerState::ScrTrig        ? 1U : 0U) << 2) |
-            ((uint64_t)(PowerState::ScrInhib       ? 1U : 0U) << 3) |
-            ((uint64_t)(PowerState::runCurrentWave ? 1U : 0U) << 4);
+        const uint64_t flags = f.flags & 0x1FU;   // ext_en, fault, scr_trig, scr_inhib, run_wave
 
-        int32_t v100 = clamp_s((int32_t)lroundf(PowerState::probeVoltageOutput * 100.0f), min_val, max_val);
-        int32_t c100 = clamp_s((int32_t)lroundf(PowerState::probeCurrent       * 100.0f), min_val, max_val);
+        int32_t v100 = clamp_s((int32_t)lroundf(f.volt_act * 100.0f), min_val, max_val);
+        int32_t c100 = clamp_s((int32_t)lroundf(f.curr_act * 100.0f), min_val, max_val);
 
         word |= (0ULL)                     << 63;  // Packet ID = 0
         word |= (flags & 0x1FULL)          << 58;  // [62:58] Flags (5 bits)
@@ -229,8 +304,8 @@ uint64_t get_poll_data() {
 
     } else {
         // --- PACKET 1: ID=1, Setpoints, Temperature ---
-        int32_t s100 = clamp_s((int32_t)lroundf(PowerState::setCurrent          * 100.0f), min_val, max_val);
-        int32_t t100 = clamp_s((int32_t)lroundf(PowerState::internalTemperature * 100.0f), min_val, max_val);
+        int32_t s100 = clamp_s((int32_t)lroundf(f.curr_set    * 100.0f), min_val, max_val);
+        int32_t t100 = clamp_s((int32_t)lroundf(f.temperature * 100.0f), min_val, max_val);
 
         word |= (1ULL)                     << 63;  // Packet ID = 1
         word |= (mask_nbits(s100, 20))     << 43;  // [62:43] curr_set (20 bits)
@@ -241,4 +316,24 @@ uint64_t get_poll_data() {
     send_packet_zero = !send_packet_zero;
 
     return word;
-}
\ No newline at end of file
+}
+
+// Analog poll word read by the bridge's poll_m4_signals_temp():
+//   [20:0] volt_x100, [41:21] curr_x100, [62:42] temp_x100 (21-bit signed each)
+uint64_t get_poll_data_temp() {
+    TelemetryFrame f = {};
+    telemetry_latest(f);
+
+    const int32_t max_val = (1 << 20) - 1;
+    const int32_t min_val = -(1 << 20);
+
+    int32_t v100 = clamp_s((int32_t)lroundf(f.volt_act    * 100.0f), min_val, max_val);
+    int32_t c100 = clamp_s((int32_t)lroundf(f.curr_act    * 100.0f), min_val, max_val);
+    int32_t t100 = clamp_s((int32_t)lroundf(f.temperature * 100.0f), min_val, max_val);
+
+    uint64_t word = 0;
+    word |= mask_nbits(v100, 21);
+    word |= mask_nbits(c100, 21) << 21;
+    word |= mask_nbits(t100, 21) << 42;
+    return word;
+}
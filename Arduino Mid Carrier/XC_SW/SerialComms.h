@@ -3,6 +3,7 @@
 
 #include <Arduino.h>
 #include <string>
+#include <vector>
 #include "Config.h"
 #include "PowerState.h"
 #include "SerialRPC.h"
@@ -36,9 +37,69 @@ int get_igbt_fault_state();
 float get_volt_act();
 float get_curr_act();
 float get_internal_temperature();
+float get_internal_temperature_rate();
 float get_analog_reading();
 uint64_t get_poll_data(); 
 uint64_t get_poll_data_temp();
+std::vector<uint8_t> get_telemetry();
+
+// --- Waveform upload: returns generation ID (> 0) or WAVE_ERR_* ---
+int load_waveform(const std::vector<uint8_t>& blob);
+uint32_t get_waveform_generation();
+
+// --- Parameter registry (ids and wire format in ParamRegistry.h) ---
+// set: returns the number of records applied, PARAM_BATCH_ERR_FORMAT or
+//      PARAM_ERR_WAVEFORM (values stored, legacy waveform rejected)
+// get: a batch of the requested ids; no ids returns every parameter
+int set_params(const std::vector<uint8_t>& blob);
+std::vector<uint8_t> get_params(const std::vector<uint8_t>& ids);
+
+// --- Flash parameter store (see ParamStore.h) ---
+uint32_t get_param_hash(const std::vector<uint8_t>& ids);  // crc32 of the ids' values
+int      save_params();                                    // 1 or PARAM_STORE_ERR_*
+uint32_t get_param_store_seq();                            // 0 = compiled-in defaults
+uint32_t get_sched_overruns(int task);
+
+// Control tick timing (see SchedJitter in Scheduler.h): u8 version, u8 bins,
+// u16 reserved, u32 budget_ns, u32 ticks, u32 latency min/max/mean ns,
+// u32 complete_max_ns, u32 over_budget, u32 hist[bins]
+std::vector<uint8_t> get_sched_jitter();
+
+// --- Current regulator debug tap (see CurrentPI.h for the record layout) ---
+#define PI_LOG_RPC_MAX  64
+std::vector<uint8_t> get_pi_log();
+uint32_t get_pi_log_dropped();
+
+// --- Fast trip (TRIP_* bits, see FastTrip.h) ---
+uint32_t get_trip_status();
+uint32_t get_trip_count();
+uint32_t clear_trip();        // returns the bits that were latched
+
+// --- SCR crowbar pulse (see ScrPulse.h) ---
+uint32_t get_scr_fire_count();
+std::vector<uint32_t> get_scr_fire_log();   // micros() of the last firings, oldest first
+
+// --- Event journal (see EventLog.h for the blob layout) ---
+#define EVENT_LOG_RPC_MAX  32   // Entries per event_log_read call
+std::vector<uint8_t> get_event_log(uint32_t cursor);
+uint32_t get_event_log_head();
+
+// --- Scope capture (see Scope.h for the status and record layouts) ---
+#define SCOPE_RPC_MAX  64   // Records per scope_read call
+int set_scope_arm(int mask, int pre, int post, int decimation);  // 1 or SCOPE_ERR_*
+int scope_manual_trigger();                                      // 1, or 0 if not armed for it
+std::vector<uint8_t> get_scope_status();
+std::vector<uint8_t> get_scope_read(uint32_t capture, uint32_t offset);
+
+// --- Measurement filters (FILTER_* ids, see SignalFilter.h) ---
+// order_or_len is the Butterworth order or the moving-average length.
+// Returns 1 or a FILTER_ERR_* code.
+int   set_filter(int channel, int type, float cutoff_hz, int order_or_len);
+float get_filter_delay_us(int channel);
+
+// --- Change notifications (see Notify.h) ---
+int set_notify_config(int heartbeat_ms);             // 0 stops them; returns 1
+int set_notify_deadband(int channel, float deadband); // NOTIFY_* channel; 1 or NOTIFY_ERR_*
 
 // --- Sync / truth table RPCs ---
 uint16_t get_sync_status_rpc();                       // returns M4_STATUS_* code
@@ -49,7 +110,7 @@ int      set_truth_table_rpc(const std::string& js);  // returns 0/1
 int get_internal_enable_state();
 int get_external_enable_state();
 
-// --- Unified JSON processor (returns int ack) ---
+// --- Unified JSON processor (returns the param_set() result as its ack) ---
 int process_event_in_uc(const std::string& json_event); 
 
 
@@ -0,0 +1,175 @@
+#include "SignalFilter.h"
+#include <math.h>
+
+// ----- Channel state -----
+// Biquads run in transposed direct form II, one {s1, s2} pair per section.
+struct Biquad {
+  float b0, b1, b2, a1, a2;
+};
+
+struct FilterState {
+  FilterConfig cfg;
+  uint8_t  sections;
+  Biquad   bq[FILTER_MAX_ORDER / 2];
+  float    s1[FILTER_MAX_ORDER / 2];
+  float    s2[FILTER_MAX_ORDER / 2];
+  float    avg_buf[FILTER_MAX_AVG_LEN];
+  float    avg_sum;
+  uint16_t avg_pos;
+  float    delay_us;
+  bool     primed;
+};
+
+static FilterState s_filters[FILTER_NUM_CHANNELS];
+
+// Defaults: protection sees the raw sample; display and current keep the
+// smoothing of the old 0.9/0.1 exponential average (~335 Hz at 20 kHz)
+static const FilterConfig s_defaults[FILTER_NUM_CHANNELS] = {
+  { FILTER_BYPASS, 0, 0, 0.0f },
+  { FILTER_BIQUAD, 1, 0, 335.0f },
+  { FILTER_BIQUAD, 1, 0, 335.0f },
+};
+
+// --- Helpers --------------------------------------------------------------
+
+// Bilinear-transform Butterworth low-pass, prewarped to the cutoff
+static void design_butterworth(FilterState& f, float fc_hz, uint8_t order) {
+  const float k  = tanf((float)M_PI * fc_hz / (float)FILTER_SAMPLE_RATE_HZ);
+  const float k2 = k * k;
+
+  f.sections = 0;
+  for (uint8_t i = 0; i < order / 2; ++i) {
+    const float q = 1.0f / (2.0f * sinf((float)M_PI * (2.0f * i + 1.0f) / (2.0f * order)));
+    const float norm = 1.0f / (1.0f + k / q + k2);
+    Biquad& s = f.bq[f.sections++];
+    s.b0 = k2 * norm;
+    s.b1 = 2.0f * s.b0;
+    s.b2 = s.b0;
+    s.a1 = 2.0f * (k2 - 1.0f) * norm;
+    s.a2 = (1.0f - k / q + k2) * norm;
+  }
+  if (order & 1U) {
+    const float norm = 1.0f / (1.0f + k);
+    Biquad& s = f.bq[f.sections++];
+    s.b0 = k * norm;
+    s.b1 = s.b0;
+    s.b2 = 0.0f;
+    s.a1 = (k - 1.0f) * norm;
+    s.a2 = 0.0f;
+  }
+}
+
+// d(phase)/d(omega) at omega = 0, in samples:
+//   sum(n*b[n])/sum(b[n]) - sum(n*a[n])/sum(a[n])
+static float biquad_dc_delay(const Biquad& s) {
+  const float bsum = s.b0 + s.b1 + s.b2;
+  const float asum = 1.0f + s.a1 + s.a2;
+  return (s.b1 + 2.0f * s.b2) / bsum - (s.a1 + 2.0f * s.a2) / asum;
+}
+
+static int validate(const FilterConfig& cfg) {
+  switch (cfg.type) {
+    case FILTER_BYPASS:
+      return 0;
+    case FILTER_BIQUAD:
+      if (cfg.order < 1 || cfg.order > FILTER_MAX_ORDER) return FILTER_ERR_PARAM;
+      if (!(cfg.cutoff_hz > 0.0f) || cfg.cutoff_hz >= 0.45f * (float)FILTER_SAMPLE_RATE_HZ) return FILTER_ERR_PARAM;
+      return 0;
+    case FILTER_MOVING_AVG:
+      if (cfg.length < 1 || cfg.length > FILTER_MAX_AVG_LEN) return FILTER_ERR_PARAM;
+      return 0;
+    default:
+      return FILTER_ERR_TYPE;
+  }
+}
+
+// Steady state for a constant input x (every section has unity DC gain)
+static void prime(FilterState& f, float x) {
+  for (uint8_t i = 0; i < f.sections; ++i) {
+    const Biquad& s = f.bq[i];
+    f.s1[i] = x - s.b0 * x;
+    f.s2[i] = (s.b2 - s.a2) * x;
+  }
+  for (uint16_t i = 0; i < f.cfg.length; ++i) f.avg_buf[i] = x;
+  f.avg_sum = x * (float)f.cfg.length;
+  f.avg_pos = 0;
+  f.primed = true;
+}
+
+// --- Public API -----------------------------------------------------------
+
+void init_filters() {
+  for (uint8_t ch = 0; ch < FILTER_NUM_CHANNELS; ++ch) {
+    filter_configure((FilterChannel)ch, s_defaults[ch]);
+  }
+}
+
+int filter_configure(FilterChannel ch, const FilterConfig& cfg) {
+  if (ch >= FILTER_NUM_CHANNELS) return FILTER_ERR_CHANNEL;
+  const int err = validate(cfg);
+  if (err) return err;
+
+  // Design off to the side; the control tick only ever sees a whole filter
+  FilterState next = {};
+  next.cfg = cfg;
+  float delay_samples = 0.0f;
+  if (cfg.type == FILTER_BIQUAD) {
+    design_butterworth(next, cfg.cutoff_hz, cfg.order);
+    for (uint8_t i = 0; i < next.sections; ++i) delay_samples += biquad_dc_delay(next.bq[i]);
+  } else if (cfg.type == FILTER_MOVING_AVG) {
+    delay_samples = 0.5f * (float)(cfg.length - 1U);
+  }
+  if (cfg.type != FILTER_MOVING_AVG) next.cfg.length = 0;
+  next.delay_us = delay_samples * (1e6f / (float)FILTER_SAMPLE_RATE_HZ);
+
+  const uint32_t primask = __get_PRIMASK();
+  __disable_irq();
+  s_filters[ch] = next;
+  __set_PRIMASK(primask);
+  return 0;
+}
+
+FilterConfig filter_config(FilterChannel ch) {
+  return (ch < FILTER_NUM_CHANNELS) ? s_filters[ch].cfg : FilterConfig{};
+}
+
+float filter_step(FilterChannel ch, float x) {
+  FilterState& f = s_filters[ch];
+  if (!f.primed) prime(f, x);
+
+  switch (f.cfg.type) {
+    case FILTER_BIQUAD:
+      for (uint8_t i = 0; i < f.sections; ++i) {
+        const Biquad& s = f.bq[i];
+        const float y = s.b0 * x + f.s1[i];
+        f.s1[i] = s.b1 * x - s.a1 * y + f.s2[i];
+        f.s2[i] = s.b2 * x - s.a2 * y;
+        x = y;
+      }
+      return x;
+
+    case FILTER_MOVING_AVG: {
+      f.avg_sum += x - f.avg_buf[f.avg_pos];
+      f.avg_buf[f.avg_pos] = x;
+      if (++f.avg_pos >= f.cfg.length) {
+        // Re-sum once per window so float rounding cannot accumulate
+        f.avg_pos = 0;
+        float sum = 0.0f;
+        for (uint16_t i = 0; i < f.cfg.length; ++i) sum += f.avg_buf[i];
+        f.avg_sum = sum;
+      }
+      return f.avg_sum / (float)f.cfg.length;
+    }
+
+    default:
+      return x;
+  }
+}
+
+void filter_reset(FilterChannel ch) {
+  if (ch < FILTER_NUM_CHANNELS) s_filters[ch].primed = false;
+}
+
+float filter_group_delay_us(FilterChannel ch) {
+  return (ch < FILTER_NUM_CHANNELS) ? s_filters[ch].delay_us : 0.0f;
+}
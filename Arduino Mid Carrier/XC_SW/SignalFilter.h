@@ -0,0 +1,56 @@
+#ifndef SIGNAL_FILTER_H
+#define SIGNAL_FILTER_H
+
+#include "Config.h"
+
+// Per-channel measurement filters, stepped once per sample from the
+// measure task. Coefficients are designed for FILTER_SAMPLE_RATE_HZ.
+#define FILTER_SAMPLE_RATE_HZ  CONTROL_RATE_HZ
+#define FILTER_MAX_ORDER       6     // Butterworth order (3 biquad sections)
+#define FILTER_MAX_AVG_LEN     64    // Moving-average window
+
+// Negative results of filter_configure()
+#define FILTER_ERR_CHANNEL  (-1)
+#define FILTER_ERR_TYPE     (-2)
+#define FILTER_ERR_PARAM    (-3)
+
+enum FilterChannel : uint8_t {
+  FILTER_VOLT_FAST = 0,   // Bank voltage for protection (update_igbt)
+  FILTER_VOLT,            // Bank voltage for display/telemetry
+  FILTER_CURR,            // Load current (regulator and display)
+  FILTER_NUM_CHANNELS
+};
+
+enum FilterType : uint8_t {
+  FILTER_BYPASS     = 0,  // y = x
+  FILTER_BIQUAD     = 1,  // Butterworth low-pass, cascaded sections
+  FILTER_MOVING_AVG = 2   // Boxcar over `length` samples
+};
+
+struct FilterConfig {
+  uint8_t  type;        // FilterType
+  uint8_t  order;       // FILTER_BIQUAD: 1..FILTER_MAX_ORDER
+  uint16_t length;      // FILTER_MOVING_AVG: 1..FILTER_MAX_AVG_LEN
+  float    cutoff_hz;   // FILTER_BIQUAD: -3 dB point, below 0.45 * sample rate
+};
+
+// Load the default configuration for every channel
+void init_filters();
+
+// Design and swap in a new configuration. The channel re-primes on its
+// next sample. Returns 0 or a FILTER_ERR_* code (nothing changes on error).
+int filter_configure(FilterChannel ch, const FilterConfig& cfg);
+
+FilterConfig filter_config(FilterChannel ch);
+
+// One sample in, one out. The first sample after a reset or reconfigure
+// primes the state so the output starts at the input (no start-up ramp).
+float filter_step(FilterChannel ch, float x);
+
+// Forget the history; the next filter_step() primes again
+void filter_reset(FilterChannel ch);
+
+// Group delay at DC in microseconds (what a slow ramp lags by)
+float filter_group_delay_us(FilterChannel ch);
+
+#endif // SIGNAL_FILTER_H
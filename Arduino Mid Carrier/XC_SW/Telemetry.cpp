@@ -0,0 +1,67 @@
+#include "Telemetry.h"
+#include "PowerState.h"
+#include "FastTrip.h"
+#include "CurrWaveform.h"
+#include <Arduino.h>
+#include <string.h>
+
+uint16_t telemetry_flags(const PowerSnapshot& p) {
+  uint16_t f = 0;
+  if (p.externalEnable)    f |= TLM_FLAG_EXTERN_ENABLE;
+  if (p.IgbtFaultState)    f |= TLM_FLAG_IGBT_FAULT;
+  if (p.ScrTrig)           f |= TLM_FLAG_SCR_TRIG;
+  if (p.ScrInhib)          f |= TLM_FLAG_SCR_INHIB;
+  if (p.runCurrentWave)    f |= TLM_FLAG_RUN_WAVE;
+  if (p.internalEnable)    f |= TLM_FLAG_INTER_ENABLE;
+  if (p.outputEnabled)     f |= TLM_FLAG_OUTPUT_ENABLED;
+  if (p.ChargerRelay)      f |= TLM_FLAG_CHARGER_RELAY;
+  if (p.DumpRelay)         f |= TLM_FLAG_DUMP_RELAY;
+  if (p.DumpFan)           f |= TLM_FLAG_DUMP_FAN;
+  if (p.warnLampTestState) f |= TLM_FLAG_WARN_LAMP_TEST;
+  if (fast_trip_active())  f |= TLM_FLAG_FAST_TRIP;   // Latched, so no tick skew
+  if (curr_waveform_rejected()) f |= TLM_FLAG_WAVE_REJECTED;
+  return f;
+}
+
+template <typename T>
+static inline void put(std::vector<uint8_t>& out, T v) {
+  uint8_t b[sizeof(T)];
+  memcpy(b, &v, sizeof(T));   // Cortex-M and the bridge are both little-endian
+  out.insert(out.end(), b, b + sizeof(T));
+}
+
+bool telemetry_latest(TelemetryFrame& out) {
+  PowerSnapshot p;
+  if (!power_state_snapshot(p)) return false;
+  out.seq          = p.tick;
+  out.timestamp_us = p.timestamp_us;
+  out.volt_act     = p.probeVoltageOutput;
+  out.curr_act     = p.probeCurrent;
+  out.volt_set     = p.setVoltage;
+  out.curr_set     = p.setCurrent;
+  out.temperature  = p.internalTemperature;
+  out.flags        = telemetry_flags(p);
+  return true;
+}
+
+std::vector<uint8_t> telemetry_pack() {
+  TelemetryFrame f = {};
+  telemetry_latest(f);
+  return telemetry_pack(f);
+}
+
+std::vector<uint8_t> telemetry_pack(const TelemetryFrame& f) {
+  std::vector<uint8_t> out;
+  out.reserve(36);
+  put<uint8_t>(out, TELEMETRY_VERSION);
+  put<uint8_t>(out, 36);
+  put<uint16_t>(out, f.flags);
+  put<uint32_t>(out, f.seq);
+  put<uint64_t>(out, f.timestamp_us);
+  put<float>(out, f.volt_act);
+  put<float>(out, f.curr_act);
+  put<float>(out, f.volt_set);
+  put<float>(out, f.curr_set);
+  put<float>(out, f.temperature);
+  return out;
+}
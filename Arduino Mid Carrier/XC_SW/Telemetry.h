@@ -0,0 +1,49 @@
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include "Config.h"
+#include "PowerState.h"
+#include <vector>
+
+#define TELEMETRY_VERSION  1
+
+// Flag bits in TelemetryFrame::flags
+#define TLM_FLAG_EXTERN_ENABLE   (1U << 0)
+#define TLM_FLAG_IGBT_FAULT      (1U << 1)
+#define TLM_FLAG_SCR_TRIG        (1U << 2)
+#define TLM_FLAG_SCR_INHIB       (1U << 3)
+#define TLM_FLAG_RUN_WAVE        (1U << 4)
+#define TLM_FLAG_INTER_ENABLE    (1U << 5)
+#define TLM_FLAG_OUTPUT_ENABLED  (1U << 6)
+#define TLM_FLAG_CHARGER_RELAY   (1U << 7)
+#define TLM_FLAG_DUMP_RELAY      (1U << 8)
+#define TLM_FLAG_DUMP_FAN        (1U << 9)
+#define TLM_FLAG_WARN_LAMP_TEST  (1U << 10)
+#define TLM_FLAG_FAST_TRIP       (1U << 11)   // Hardware trip latched
+#define TLM_FLAG_WAVE_REJECTED   (1U << 12)   // Newest waveform upload rejected
+
+// The values Linux is sent, cut from one PowerSnapshot
+struct TelemetryFrame {
+  uint32_t seq;           // PowerSnapshot::tick
+  uint64_t timestamp_us;  // micros() at publish, extended to 64 bits
+  float    volt_act;
+  float    curr_act;
+  float    volt_set;
+  float    curr_set;
+  float    temperature;
+  uint16_t flags;         // TLM_FLAG_*
+};
+
+// TLM_FLAG_* bits of a snapshot
+uint16_t telemetry_flags(const PowerSnapshot& p);
+
+// Frame from the newest published snapshot; false until the first publish
+bool telemetry_latest(TelemetryFrame& out);
+
+// Versioned little-endian wire format of the newest frame:
+//   u8 version, u8 size, u16 flags, u32 seq, u64 timestamp_us,
+//   f32 volt_act, f32 curr_act, f32 volt_set, f32 curr_set, f32 temperature
+std::vector<uint8_t> telemetry_pack();
+std::vector<uint8_t> telemetry_pack(const TelemetryFrame& f);
+
+#endif // TELEMETRY_H
@@ -8,7 +8,13 @@ typedef int (*AnalogReadFunc)(uint8_t);
 void set_temperature_analog_reader(AnalogReadFunc func);
 
 void init_temperature();
+
+// Temperature task (TEMPERATURE_RATE_HZ): averages the whole ADC3 scan
+// buffer, converts through the sensor table and low-pass filters the
+// result into PowerState::internalTemperature / internalTemperatureRate
 void update_temperature();
+
 float get_internal_temperature();
+float get_internal_temperature_rate();   // °C/s
 
 #endif // TEMPERATURE_H
\ No newline at end of file
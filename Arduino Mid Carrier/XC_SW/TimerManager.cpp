@@ -0,0 +1,278 @@
+#include "TimerManager.h"
+#include <Arduino.h>
+#include <math.h>
+
+struct PwmOutputDesc {
+  uint8_t        timer;
+  uint32_t       channel;      // TIM_CHANNEL_x
+  GPIO_TypeDef*  port;
+  uint16_t       pin;
+  uint8_t        af;
+  uint32_t       polarity;
+};
+
+// GPIO ports are not constant expressions in the HAL, so this table is
+// filled at static init
+static const PwmOutputDesc s_outputs[PWM_NUM_OUTPUTS] = {
+  { PWM_TIM1, TIM_CHANNEL_2, GPIOA, GPIO_PIN_9,  GPIO_AF1_TIM1, TIM_OCPOLARITY_HIGH },
+  { PWM_TIM1, TIM_CHANNEL_3, GPIOA, GPIO_PIN_10, GPIO_AF1_TIM1, TIM_OCPOLARITY_HIGH },
+  { PWM_TIM3, TIM_CHANNEL_2, GPIOC, GPIO_PIN_7,  GPIO_AF2_TIM3, TIM_OCPOLARITY_LOW  },
+  { PWM_TIM3, TIM_CHANNEL_4, nullptr, 0,          0,             TIM_OCPOLARITY_HIGH },
+};
+
+// ----- State -----
+static TIM_HandleTypeDef s_tim[PWM_NUM_TIMERS] = {};
+static bool              s_running[PWM_NUM_TIMERS] = {};
+static volatile uint32_t s_arr[PWM_NUM_TIMERS] = {};   // Value in (or staged for) ARR
+static uint8_t           s_claimed[PWM_NUM_TIMERS] = {};   // Bit n = channel index n
+
+// ----- Dither (TIM3 only) -----
+#define DITHER_NONE  0xFFU
+static DMA_HandleTypeDef s_dither_dma = {};
+static bool              s_dither_ready = false;
+static volatile uint8_t  s_dither_ch = DITHER_NONE;   // Channel index fed by the stream
+static volatile uint32_t s_dither_tbl[PWM_DITHER_LEN] = {};
+
+// --- Helpers --------------------------------------------------------------
+
+static TIM_TypeDef* instance(PwmTimer t) {
+  return (t == PWM_TIM1) ? TIM1 : TIM3;
+}
+
+// Center-aligned: one period is 2 * (ARR + 1) prescaled ticks. Picks the
+// smallest PSC that fits ARR in 16 bits, for the finest duty resolution.
+static bool period_for(float freq_hz, uint32_t& psc, uint32_t& arr) {
+  if (!(freq_hz > 0.0f)) return false;
+  const uint32_t total = (uint32_t)((double)PWM_TIMER_CLOCK_HZ / (2.0 * (double)freq_hz));
+  psc = total / 65537U;
+  if (psc > 65535U) return false;
+  const uint32_t ticks = total / (psc + 1U);
+  if (ticks < 2U) return false;
+  arr = ticks - 1U;
+  return true;
+}
+
+static inline uint32_t duty_to_ccr(uint32_t arr, float duty_norm) {
+  if (duty_norm <= 0.0f) return 0U;
+  const float dn = (duty_norm >= 1.0f) ? 1.0f : duty_norm;
+  uint32_t ccr = (uint32_t)(dn * (float)(arr + 1U) + 0.5f);
+  if (ccr > arr) ccr = arr;
+  return ccr;
+}
+
+static inline bool dithered(const PwmChannel& c) {
+  return c.timer == PWM_TIM3 && s_dither_ch == c.index;
+}
+
+// Table holding `q` sixteenths of a count on average: entry i gets the
+// base count plus the carry of the running fraction, so the extra counts
+// are spread evenly instead of bunched at the start. The stream reads on
+// as the table is rewritten, which blends old and new duty for at most
+// one pass.
+static void dither_fill(uint32_t q, uint32_t arr) {
+  const uint32_t base = q >> PWM_DITHER_BITS;
+  const uint32_t frac = q & (PWM_DITHER_LEN - 1U);
+  for (uint32_t i = 0; i < PWM_DITHER_LEN; ++i) {
+    uint32_t v = base + (((i + 1U) * frac) >> PWM_DITHER_BITS) - ((i * frac) >> PWM_DITHER_BITS);
+    if (v > arr) v = arr;
+    s_dither_tbl[i] = v;
+  }
+}
+
+static bool dither_dma_init() {
+  if (s_dither_ready) return true;
+  __HAL_RCC_DMA1_CLK_ENABLE();
+  s_dither_dma.Instance                 = DMA1_Stream1;
+  s_dither_dma.Init.Request             = DMA_REQUEST_TIM3_UP;
+  s_dither_dma.Init.Direction           = DMA_MEMORY_TO_PERIPH;
+  s_dither_dma.Init.PeriphInc           = DMA_PINC_DISABLE;
+  s_dither_dma.Init.MemInc              = DMA_MINC_ENABLE;
+  s_dither_dma.Init.PeriphDataAlignment = DMA_PDATAALIGN_WORD;
+  s_dither_dma.Init.MemDataAlignment    = DMA_MDATAALIGN_WORD;
+  s_dither_dma.Init.Mode                = DMA_CIRCULAR;
+  s_dither_dma.Init.Priority            = DMA_PRIORITY_HIGH;
+  s_dither_dma.Init.FIFOMode            = DMA_FIFOMODE_DISABLE;
+  s_dither_ready = (HAL_DMA_Init(&s_dither_dma) == HAL_OK);
+  return s_dither_ready;
+}
+
+// Timer and the GPIO port its outputs are on
+static inline void enable_clocks(PwmTimer t) {
+  if (t == PWM_TIM1) {
+    __HAL_RCC_TIM1_CLK_ENABLE();
+    __HAL_RCC_GPIOA_CLK_ENABLE();
+  } else {
+    __HAL_RCC_TIM3_CLK_ENABLE();
+    __HAL_RCC_GPIOC_CLK_ENABLE();
+  }
+}
+
+// --- Public API -----------------------------------------------------------
+
+int pwm_timer_start(PwmTimer t, float freq_hz) {
+  if (s_running[t]) return pwm_timer_retune(t, freq_hz);
+
+  uint32_t psc, arr;
+  if (!period_for(freq_hz, psc, arr)) return PWM_ERR_FREQ;
+
+  enable_clocks(t);
+  TIM_HandleTypeDef& h = s_tim[t];
+  h.Instance               = instance(t);
+  h.Init.Prescaler         = psc;
+  h.Init.CounterMode       = TIM_COUNTERMODE_CENTERALIGNED1;
+  h.Init.Period            = arr;
+  h.Init.ClockDivision     = TIM_CLOCKDIVISION_DIV1;
+  h.Init.RepetitionCounter = 0;
+  h.Init.AutoReloadPreload = TIM_AUTORELOAD_PRELOAD_ENABLE;
+  if (HAL_TIM_PWM_Init(&h) != HAL_OK) return PWM_ERR_STOPPED;
+
+  s_arr[t] = arr;
+  s_running[t] = true;
+  return 1;
+}
+
+int pwm_timer_retune(PwmTimer t, float freq_hz) {
+  if (!s_running[t]) return PWM_ERR_STOPPED;
+
+  uint32_t psc, arr;
+  if (!period_for(freq_hz, psc, arr)) return PWM_ERR_FREQ;
+
+  TIM_TypeDef* tim = s_tim[t].Instance;
+  const uint32_t old_arr = s_arr[t];
+  if (psc == tim->PSC && arr == old_arr) return 1;
+
+  // UDIS holds off the update event so PSC, ARR and the CCRs cannot load
+  // from a half-written set; the counter keeps running throughout. The
+  // section also keeps the control tick from writing a CCR against the
+  // old ARR in between.
+  const uint32_t primask = __get_PRIMASK();
+  __disable_irq();
+  tim->CR1 |= TIM_CR1_UDIS;
+  tim->PSC = psc;
+  tim->ARR = arr;
+  for (uint8_t i = 0; i < 4; ++i) {
+    if (!(s_claimed[t] & (1U << i))) continue;
+    volatile uint32_t* ccr = &tim->CCR1 + i;
+    uint32_t v = (uint32_t)(((uint64_t)*ccr * (arr + 1U) + (old_arr + 1U) / 2U) / (old_arr + 1U));
+    if (v > arr) v = arr;
+    *ccr = v;
+  }
+  if (t == PWM_TIM3 && s_dither_ch != DITHER_NONE) {
+    for (uint32_t i = 0; i < PWM_DITHER_LEN; ++i) {
+      uint32_t v = (uint32_t)(((uint64_t)s_dither_tbl[i] * (arr + 1U) + (old_arr + 1U) / 2U) / (old_arr + 1U));
+      if (v > arr) v = arr;
+      s_dither_tbl[i] = v;
+    }
+  }
+  s_arr[t] = arr;
+  s_tim[t].Init.Prescaler = psc;
+  s_tim[t].Init.Period    = arr;
+  tim->CR1 &= ~TIM_CR1_UDIS;
+  __set_PRIMASK(primask);
+  return 1;
+}
+
+bool pwm_timer_running(PwmTimer t) { return s_running[t]; }
+
+float pwm_timer_freq(PwmTimer t) {
+  if (!s_running[t]) return 0.0f;
+  const float ticks = 2.0f * (float)(s_tim[t].Init.Prescaler + 1U) * (float)(s_arr[t] + 1U);
+  return (float)PWM_TIMER_CLOCK_HZ / ticks;
+}
+
+TIM_HandleTypeDef* pwm_timer_handle(PwmTimer t) { return &s_tim[t]; }
+
+PwmChannel pwm_claim(PwmOutput o) {
+  const PwmOutputDesc& d = s_outputs[o];
+  const uint8_t idx = (uint8_t)(d.channel >> 2);
+  PwmChannel c = { nullptr, d.timer, idx };
+  if (!s_running[d.timer]) return c;
+
+  TIM_HandleTypeDef& h = s_tim[d.timer];
+  if (!(s_claimed[d.timer] & (1U << idx))) {
+    if (d.port) {
+      GPIO_InitTypeDef gpio = {};
+      gpio.Pin       = d.pin;
+      gpio.Mode      = GPIO_MODE_AF_PP;
+      gpio.Pull      = GPIO_NOPULL;
+      gpio.Speed     = GPIO_SPEED_FREQ_HIGH;
+      gpio.Alternate = d.af;
+      HAL_GPIO_Init(d.port, &gpio);
+    }
+
+    TIM_OC_InitTypeDef oc = {};
+    oc.OCMode      = TIM_OCMODE_PWM1;
+    oc.Pulse       = 0U;
+    oc.OCPolarity  = d.polarity;
+    oc.OCFastMode  = TIM_OCFAST_DISABLE;
+    oc.OCIdleState = TIM_OCIDLESTATE_RESET;
+    if (HAL_TIM_PWM_ConfigChannel(&h, &oc, d.channel) != HAL_OK) return c;
+    if (HAL_TIM_PWM_Start(&h, d.channel) != HAL_OK) return c;
+    s_claimed[d.timer] |= (uint8_t)(1U << idx);
+  }
+
+  c.ccr = &h.Instance->CCR1 + idx;
+  return c;
+}
+
+void pwm_set_duty(const PwmChannel& c, float duty_norm) {
+  if (!c.ccr) return;
+  const uint32_t arr = s_arr[c.timer];
+  if (!dithered(c)) {
+    *c.ccr = duty_to_ccr(arr, duty_norm);
+    return;
+  }
+  const float dn = (duty_norm <= 0.0f) ? 0.0f : (duty_norm >= 1.0f) ? 1.0f : duty_norm;
+  dither_fill((uint32_t)(dn * (float)((arr + 1U) << PWM_DITHER_BITS) + 0.5f), arr);
+}
+
+void pwm_set_ccr(const PwmChannel& c, uint32_t ccr) {
+  if (!c.ccr) return;
+  const uint32_t arr = s_arr[c.timer];
+  if (ccr > arr) ccr = arr;
+  if (dithered(c)) dither_fill(ccr << PWM_DITHER_BITS, arr);
+  else             *c.ccr = ccr;
+}
+
+uint32_t pwm_period_ticks(const PwmChannel& c) { return s_arr[c.timer]; }
+
+int pwm_dither_start(const PwmChannel& c) {
+  if (!c.ccr) return PWM_ERR_STOPPED;
+  if (c.timer != PWM_TIM3) return PWM_ERR_DITHER;
+  if (dithered(c)) return 1;
+  if (s_dither_ch != DITHER_NONE || !dither_dma_init()) return PWM_ERR_DITHER;
+
+  dither_fill(*c.ccr << PWM_DITHER_BITS, s_arr[c.timer]);
+  if (HAL_DMA_Start(&s_dither_dma, (uint32_t)(uintptr_t)s_dither_tbl,
+                    (uint32_t)(uintptr_t)c.ccr, PWM_DITHER_LEN) != HAL_OK) {
+    return PWM_ERR_DITHER;
+  }
+  s_dither_ch = c.index;
+  __HAL_TIM_ENABLE_DMA(&s_tim[c.timer], TIM_DMA_UPDATE);
+  return 1;
+}
+
+void pwm_dither_stop(const PwmChannel& c) {
+  if (!dithered(c)) return;
+  __HAL_TIM_DISABLE_DMA(&s_tim[c.timer], TIM_DMA_UPDATE);
+  HAL_DMA_Abort(&s_dither_dma);
+  s_dither_ch = DITHER_NONE;
+  *c.ccr = s_dither_tbl[0];
+}
+
+bool pwm_dither_active(const PwmChannel& c) { return c.ccr && dithered(c); }
+
+float pwm_duty_bits(const PwmChannel& c) {
+  if (!c.ccr) return 0.0f;
+  const float bits = log2f((float)(s_arr[c.timer] + 1U));
+  return dithered(c) ? bits + (float)PWM_DITHER_BITS : bits;
+}
+
+void pwm_force_inactive(const PwmChannel& c, bool inactive) {
+  if (!c.ccr) return;
+  TIM_TypeDef* tim = s_tim[c.timer].Instance;
+  volatile uint32_t& ccmr = (c.index < 2) ? tim->CCMR1 : tim->CCMR2;
+  const unsigned sh = (c.index & 1U) ? 8U : 0U;   // HAL OC modes are CH1-positioned
+  MODIFY_REG(ccmr, TIM_CCMR1_OC1M << sh,
+             (inactive ? TIM_OCMODE_FORCED_INACTIVE : TIM_OCMODE_PWM1) << sh);
+}
@@ -0,0 +1,88 @@
+#ifndef TIMER_MANAGER_H
+#define TIMER_MANAGER_H
+
+#include "Config.h"
+#include "stm32h7xx_hal.h"
+
+// Owner of the PWM timers: TIM1 (measured-value display outputs) and TIM3
+// (IGBT gate). Each timer is initialised once, center-aligned with ARR and
+// CCR preload, and modules claim their output channel from it instead of
+// configuring the timer themselves. A frequency change is written to the
+// preload registers and takes effect at one update event, with every
+// claimed channel's duty kept.
+#define PWM_TIMER_CLOCK_HZ  200000000U   // TIM1/TIM3 kernel clock on the Portenta H7
+
+#define PWM_ERR_FREQ     (-1)   // Frequency out of the 16-bit PSC/ARR range
+#define PWM_ERR_STOPPED  (-2)   // Timer not started
+#define PWM_ERR_DITHER   (-3)   // No dither DMA for this timer
+
+// Duty dither: a circular DMA stream on the timer's update request reloads
+// the channel's CCR from a table every update event, and pwm_set_duty()
+// spreads the fractional count over the table (first-order sigma-delta).
+// The mean duty gains PWM_DITHER_BITS of resolution. Center-aligned
+// without a repetition counter, the update event is at both the peak and
+// the valley, so one table pass spans PWM_DITHER_LEN / 2 periods.
+#define PWM_DITHER_BITS  4U
+#define PWM_DITHER_LEN   (1U << PWM_DITHER_BITS)
+
+enum PwmTimer : uint8_t {
+  PWM_TIM1 = 0,
+  PWM_TIM3,
+  PWM_NUM_TIMERS
+};
+
+// Outputs the board wires to a timer channel, and internal-only channels
+enum PwmOutput : uint8_t {
+  PWM_OUT_VOLT_DISPLAY = 0,   // TIM1_CH2, PA9  (MEASURED_VOLT_OUT)
+  PWM_OUT_CURR_DISPLAY,       // TIM1_CH3, PA10 (MEASURED_CURR_OUT)
+  PWM_OUT_IGBT_HS,            // TIM3_CH2, PC7  (DPIN_IGBT_HS), active low
+  PWM_OUT_IGBT_ADC_TRIG,      // TIM3_CH4, no pin: OC4REF for TRGO
+  PWM_NUM_OUTPUTS
+};
+
+// Handle returned by pwm_claim(); ccr == nullptr if the timer is not running
+struct PwmChannel {
+  volatile uint32_t* ccr;
+  uint8_t            timer;     // PwmTimer
+  uint8_t            index;     // Channel 1..4 as 0..3
+};
+
+// Start the timer at freq_hz, or retune it if it is already running.
+// Returns 1 or a PWM_ERR_* code.
+int pwm_timer_start(PwmTimer t, float freq_hz);
+
+// Change the frequency of a running timer without stopping it: PSC, ARR
+// and the rescaled CCRs are staged with update events held off, then load
+// together at the next one. Returns 1 or a PWM_ERR_* code.
+int pwm_timer_retune(PwmTimer t, float freq_hz);
+
+bool               pwm_timer_running(PwmTimer t);
+float              pwm_timer_freq(PwmTimer t);     // Actual frequency, 0 if stopped
+TIM_HandleTypeDef* pwm_timer_handle(PwmTimer t);   // For DMA/trigger wiring
+
+// Route the output's pin (if any) to its channel and enable it at 0 % duty. The
+// timer must have been started. Claiming an output again returns the same
+// handle without touching the hardware.
+PwmChannel pwm_claim(PwmOutput o);
+
+// Duty 0..1 of the PWM period (CCR preloaded: applies from the next period)
+void     pwm_set_duty(const PwmChannel& c, float duty_norm);
+void     pwm_set_ccr(const PwmChannel& c, uint32_t ccr);
+uint32_t pwm_period_ticks(const PwmChannel& c);   // ARR
+
+// Switch a claimed channel to dithered duty, keeping its current CCR, or
+// back to a plain CCR. Only TIM3 has a stream (DMA1 Stream1, TIM3_UP), so
+// one channel per timer. Returns 1 or a PWM_ERR_* code.
+int  pwm_dither_start(const PwmChannel& c);
+void pwm_dither_stop(const PwmChannel& c);
+bool pwm_dither_active(const PwmChannel& c);
+
+// Effective duty resolution in bits: log2(ARR + 1), plus PWM_DITHER_BITS
+// while dithered
+float pwm_duty_bits(const PwmChannel& c);
+
+// Hold the output at its inactive level immediately (OCxM is not
+// preloaded), or hand it back to the PWM comparator
+void pwm_force_inactive(const PwmChannel& c, bool inactive);
+
+#endif // TIMER_MANAGER_H
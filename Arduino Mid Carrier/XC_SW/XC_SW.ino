@@ -1,12 +1,9 @@
 #include <Arduino.h>
 #include "Config.h"
-#include "Voltage.h"
-#include "Current.h"
-#include "Temperature.h"
-#include "EnableControl.h"
+#include "Firmware.h"
 #include "SerialComms.h"
-#include "IGBT.h"
-#include "CurrWaveform.h"
+#include "Scheduler.h"
+#include "Notify.h"
 #include <ArduinoJson.h>
 #include <RPC.h>
 #include <string> 
@@ -23,28 +20,15 @@ volatile bool m4_sync_done = false;
 volatile uint16_t m4_status = M4_STATUS_NOT_SYNCED; 
 bool m4_sync_status_logged = false; 
 
-
-
 void setup() {
   Serial.begin(115200);
   //Serial.println("Portenta M4 Core Logic Starting...");
   //Serial.println("--------------------------------");
   //Serial.println("Initializing Modules...");
 
-  init_serial_comms();
-  //Serial.println("Serial OK"); 
-
-  init_voltage();
-  //Serial.println("Voltage OK");
-
-  init_current();
-  //Serial.println("Current OK");
-
-  init_temperature();
-  //Serial.println("Temperature OK");
-
-  init_enable_control();  
-  //Serial.println("Enable Control OK");
+  // Modules, waveform and the scheduler tasks (shared with XC_SW_Sim)
+  init_firmware();
+  //Serial.println("Modules and scheduler OK");
 
   // --- RPC Setup ---
   RPC.bind("get_sync_status", []() -> uint16_t {
@@ -72,8 +56,8 @@ void setup() {
     }
 
     // Apply JSON values
-    if (doc.containsKey("volt_set")) PowerState::setVoltage = doc["volt_set"];
-    if (doc.containsKey("curr_set")) PowerState::setCurrent = doc["curr_set"];
+    if (doc.containsKey("volt_set")) power_state_request_voltage(doc["volt_set"]);
+    if (doc.containsKey("curr_set")) power_state_request_current(doc["curr_set"]);
 
     m4_status = M4_STATUS_SYNCED;
     m4_sync_done = true; 
@@ -86,29 +70,24 @@ void setup() {
 
   //Serial.println("RPC bindings OK");
 
-  init_igbt();
-  //Serial.println("PWM OK"); 
-
   //Serial.println("--------------------------------");
   //Serial.println("Setup Complete. Entering main loop.");
 } 
 
 void loop() {
-  static uint32_t last_us = micros();
-  uint32_t now_us = micros();
-  float dt = (now_us - last_us) * 1e-6f;
-  last_us = now_us;
-
-  update_enable_inputs();
-  update_voltage();
-  update_current();
-  update_temperature();
-  
-  update_curr_waveform(dt);
-  update_igbt(); 
-
-  update_enable_outputs(); 
-  //delayMicroseconds(5);
+  // Control runs from the TIM7 interrupt. Only if the timer could not be
+  // started do we fall back to ticking the task table from here.
+  if (!scheduler_running()) {
+    static uint32_t last_tick_us = micros();
+    const uint32_t period_us = 1000000U / CONTROL_RATE_HZ;
+    if ((uint32_t)(micros() - last_tick_us) >= period_us) {
+      last_tick_us += period_us;
+      sched_run_tick();
+    }
+  }
+
+  // Push flag edges and out-of-deadband values to Linux (once subscribed)
+  notify_service();
 
   // Sync status output
   static uint32_t last_log_ms = 0;
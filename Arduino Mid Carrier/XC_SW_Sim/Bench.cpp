@@ -0,0 +1,303 @@
+// Microbenchmarks for the XC_SW hot paths on the host build.
+//
+//   xc_sw_bench [--label TAG] [--min-ms N] [--filter SUBSTR]
+//
+// Prints CSV: label,bench,iterations,ns_per_call,ns_min,allocs_per_call,
+// bytes_per_call. ns_per_call is the median of BENCH_REPS timed runs and
+// ns_min the fastest; allocations are counted through global operator new.
+// Pass the commit hash as --label to track results across commits.
+#include <Arduino.h>
+#include <algorithm>
+#include <chrono>
+#include <new>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#include "Config.h"
+#include "PowerState.h"
+#include "Voltage.h"
+#include "Current.h"
+#include "Temperature.h"
+#include "EnableControl.h"
+#include "IGBT.h"
+#include "TimerManager.h"
+#include "CurrWaveform.h"
+#include "AdcScan.h"
+#include "Scheduler.h"
+#include "CurrentPI.h"
+#include "FastTrip.h"
+#include "SensorConv.h"
+#include "SignalFilter.h"
+#include "ParamRegistry.h"
+#include "SerialComms.h"
+
+#include "SimHw.h"
+
+// Normally defined in XC_SW.ino
+volatile bool     m4_sync_done = false;
+volatile uint16_t m4_status = 0xA0B0;
+
+// ----- Allocation counting -----
+static bool     s_count_allocs = false;
+static uint64_t s_allocs = 0;
+static uint64_t s_alloc_bytes = 0;
+
+static void* counted_alloc(size_t n) {
+  if (s_count_allocs) { s_allocs++; s_alloc_bytes += n; }
+  void* p = malloc(n ? n : 1);
+  if (!p) throw std::bad_alloc();
+  return p;
+}
+
+void* operator new(size_t n)                          { return counted_alloc(n); }
+void* operator new[](size_t n)                        { return counted_alloc(n); }
+void* operator new(size_t n, const std::nothrow_t&) noexcept {
+  if (s_count_allocs) { s_allocs++; s_alloc_bytes += n; }
+  return malloc(n ? n : 1);
+}
+void* operator new[](size_t n, const std::nothrow_t& t) noexcept { return operator new(n, t); }
+void operator delete(void* p) noexcept                { free(p); }
+void operator delete[](void* p) noexcept              { free(p); }
+void operator delete(void* p, size_t) noexcept        { free(p); }
+void operator delete[](void* p, size_t) noexcept      { free(p); }
+
+// ----- Harness -----
+static const int      BENCH_REPS = 7;
+static const uint32_t BENCH_BATCH = 1000;
+
+struct BenchOptions {
+  std::string label = "local";
+  double      min_ms = 50.0;
+  std::string filter;
+};
+
+static BenchOptions g_opt;
+
+// Runs `fn` in batches of `batch` calls. `prepare` runs before each batch,
+// untimed, to put the firmware back into the state being measured.
+template <typename Prepare, typename Fn>
+static void bench(const char* name, uint32_t batch, Prepare prepare, Fn fn) {
+  if (!g_opt.filter.empty() && std::string(name).find(g_opt.filter) == std::string::npos) return;
+
+  using clk = std::chrono::steady_clock;
+  auto timed_run = [&](uint64_t batches) {
+    double ns = 0.0;
+    for (uint64_t b = 0; b < batches; ++b) {
+      prepare();
+      const auto t0 = clk::now();
+      for (uint32_t i = 0; i < batch; ++i) fn(i);
+      ns += std::chrono::duration<double, std::nano>(clk::now() - t0).count();
+    }
+    return ns;
+  };
+
+  // Warm up and size the run to about min_ms
+  uint64_t batches = 1;
+  for (;;) {
+    const double ns = timed_run(batches);
+    if (ns >= g_opt.min_ms * 1e6 / 4.0 || batches >= (1ULL << 24)) break;
+    batches *= 2;
+  }
+
+  std::vector<double> per_call;
+  uint64_t allocs = 0, bytes = 0;
+  for (int r = 0; r < BENCH_REPS; ++r) {
+    s_allocs = 0; s_alloc_bytes = 0;
+    s_count_allocs = true;
+    const double ns = timed_run(batches);
+    s_count_allocs = false;
+    per_call.push_back(ns / (double)(batches * batch));
+    allocs += s_allocs; bytes += s_alloc_bytes;
+  }
+  std::sort(per_call.begin(), per_call.end());
+
+  const double calls = (double)batches * batch * BENCH_REPS;
+  printf("%s,%s,%llu,%.2f,%.2f,%.3f,%.1f\n", g_opt.label.c_str(), name,
+         (unsigned long long)(batches * batch), per_call[BENCH_REPS / 2], per_call[0],
+         allocs / calls, bytes / calls);
+}
+
+template <typename Fn>
+static void bench(const char* name, Fn fn) {
+  bench(name, BENCH_BATCH, [] {}, fn);
+}
+
+// ----- Firmware fixture -----
+static int read_voltage(uint8_t)     { return 2600; }   // ~220 V with the sim calibration
+static int read_current(uint8_t)     { return 2500; }   // ~850 A
+static int read_temperature(uint8_t) { return 2048; }
+
+static void firmware_setup() {
+  VScale_V = 606.06f;   VOffset_V = 0.0f;
+  VScale_C = 2575.75f;  VOffset_C = 0.0f;
+  sensor_conv_update();
+  sim_set_pin_input(DPIN_GATE_FAULT, HIGH);
+  sim_set_pin_input(DPIN_ENABLE_IN, HW_INPUT_ACTIVE_STATE);
+
+  init_serial_comms();
+  init_filters();
+  init_voltage();
+  init_current();
+  init_temperature();
+  init_enable_control();
+  init_adc_scan();
+  set_voltage_analog_reader(read_voltage);
+  set_current_analog_reader(read_current);
+  set_temperature_analog_reader(read_temperature);
+  init_igbt();
+  current_pi_apply_gains();
+  init_fast_trip();
+  init_curr_waveform();
+  // No tasks and no update events: the firmware sees a running scheduler
+  init_scheduler();
+
+  // 20 ms rise, 100 ms hold at 1500 A, 20 ms fall
+  PowerState::currT1 = 0.020f;  PowerState::currTHold = 0.100f;  PowerState::currT2 = 0.020f;
+  PowerState::currA1 = 0.0f;    PowerState::currB1 = 0.0f;
+  PowerState::currC1 = 4500.0f; PowerState::currD1 = -3000.0f;
+  PowerState::currA2 = 1500.0f; PowerState::currB2 = 0.0f;
+  PowerState::currC2 = -4500.0f; PowerState::currD2 = 3000.0f;
+  curr_waveform_load_legacy();
+
+  update_voltage();
+  power_state_publish();
+}
+
+// Enabled and mid-waveform: the path the control tick takes during a shot
+static void enter_running() {
+  PowerState::internalEnable = false;
+  PowerState::outputEnabled = false;
+  update_curr_waveform();
+  PowerState::internalEnable = true;
+  PowerState::outputEnabled = true;
+  update_curr_waveform();
+  PowerState::probeVoltageOutput = 220.0f;
+  PowerState::probeCurrent = 850.0f;
+}
+
+static bool parse_args(int argc, char** argv) {
+  for (int i = 1; i < argc; ++i) {
+    const std::string a = argv[i];
+    const bool has_val = (i + 1 < argc);
+    if      (a == "--label"  && has_val) g_opt.label  = argv[++i];
+    else if (a == "--min-ms" && has_val) g_opt.min_ms = atof(argv[++i]);
+    else if (a == "--filter" && has_val) g_opt.filter = argv[++i];
+    else {
+      fprintf(stderr, "usage: %s [--label TAG] [--min-ms N] [--filter SUBSTR]\n", argv[0]);
+      return false;
+    }
+  }
+  return true;
+}
+
+int main(int argc, char** argv) {
+  if (!parse_args(argc, argv)) return 2;
+  firmware_setup();
+
+  printf("label,bench,iterations,ns_per_call,ns_min,allocs_per_call,bytes_per_call\n");
+
+  // A shot is 2800 ticks; stay inside it so every call takes the running path
+  bench("update_curr_waveform", BENCH_BATCH, enter_running,
+        [](uint32_t) { update_curr_waveform(); });
+
+  bench("update_igbt", BENCH_BATCH, enter_running, [](uint32_t i) {
+    PowerState::setCurrent = 500.0f + (float)(i & 1023U);
+    update_igbt();
+  });
+
+  // Runtime frequency change of the live IGBT timer (was a full init_igbt())
+  bench("pwm_timer_retune", [](uint32_t i) {
+    pwm_timer_retune(PWM_TIM3, (i & 1U) ? IGBT_PWM_FREQ_HZ * 1.25f : IGBT_PWM_FREQ_HZ);
+  });
+  pwm_timer_retune(PWM_TIM3, IGBT_PWM_FREQ_HZ);
+
+  // Duty write per control tick: plain CCR vs refilling the dither table
+  {
+    static PwmChannel igbt;
+    igbt = pwm_claim(PWM_OUT_IGBT_HS);
+    bench("pwm_set_duty", [](uint32_t i) { pwm_set_duty(igbt, (float)(i & 1023U) / 1024.0f); });
+    pwm_dither_start(igbt);
+    bench("pwm_set_duty_dither", [](uint32_t i) { pwm_set_duty(igbt, (float)(i & 1023U) / 1024.0f); });
+    pwm_dither_stop(igbt);
+    pwm_set_ccr(igbt, 0U);
+  }
+
+  bench("update_current", BENCH_BATCH, enter_running, [](uint32_t) { update_current(); });
+  bench("update_voltage", [](uint32_t) { update_voltage(); });
+  bench("power_state_publish", [](uint32_t) { power_state_publish(); });
+  bench("power_state_snapshot", [](uint32_t) {
+    PowerSnapshot p;
+    power_state_snapshot(p);
+    volatile float v = p.probeCurrent;
+    (void)v;
+  });
+
+  // One channel per engine type, 4th-order Butterworth as the heavy case
+  static const FilterConfig filter_cfgs[FILTER_NUM_CHANNELS] = {
+    { FILTER_BYPASS, 0, 0, 0.0f },
+    { FILTER_BIQUAD, 4, 0, 500.0f },
+    { FILTER_MOVING_AVG, 0, 32, 0.0f },
+  };
+  static const char* const filter_names[FILTER_NUM_CHANNELS] = {
+    "filter_step/bypass", "filter_step/biquad4", "filter_step/moving_avg32",
+  };
+  for (uint8_t ch = 0; ch < FILTER_NUM_CHANNELS; ++ch) {
+    filter_configure((FilterChannel)ch, filter_cfgs[ch]);
+    bench(filter_names[ch], [ch](uint32_t i) {
+      volatile float y = filter_step((FilterChannel)ch, 200.0f + (float)(i & 63U));
+      (void)y;
+    });
+  }
+  init_filters();
+
+  // Writes as param_set_many batches: one setpoint, and the full legacy
+  // waveform (one reload for all eleven records)
+  static std::vector<uint8_t> one_set, wave_set;
+  auto add_record = [](std::vector<uint8_t>& b, uint8_t id, float v) {
+    uint8_t rec[PARAM_BATCH_RECORD] = { id, PARAM_WIRE_F32 };
+    memcpy(rec + 2, &v, sizeof(v));
+    b.insert(b.end(), rec, rec + PARAM_BATCH_RECORD);
+    b[1]++;
+  };
+  one_set  = { PARAM_BATCH_VERSION, 0 };
+  wave_set = { PARAM_BATCH_VERSION, 0 };
+  add_record(one_set, 0x05, 1250.5f);
+  static const uint8_t wave_ids[] = { 0x13, 0x14, 0x15, 0x16, 0x17, 0x18, 0x19, 0x20, 0x21, 0x22, 0x23 };
+  static const float   wave_vals[] = { 0.02f, 0.1f, 0.02f, 0.0f, 0.0f, 4500.0f, -3000.0f,
+                                       1500.0f, 0.0f, -4500.0f, 3000.0f };
+  for (size_t k = 0; k < sizeof(wave_ids); ++k) add_record(wave_set, wave_ids[k], wave_vals[k]);
+  bench("param_set_many/curr_set", [](uint32_t) { param_set_many(one_set.data(), one_set.size()); });
+  bench("param_set_many/waveform11", 10U, [] {},
+        [](uint32_t) { param_set_many(wave_set.data(), wave_set.size()); });
+
+  static uint8_t get_buf[PARAM_BATCH_HEADER + PARAM_BATCH_RECORD * 64];
+  bench("param_get_many/all", [](uint32_t) { param_get_many(nullptr, 0, get_buf); });
+
+  // Payloads exactly as portenta_linux_bridge.py builds them
+  static const std::string events[] = {
+    "{\"display_event\": {\"name\": \"curr_set\", \"value\": 1250.5}}",
+    "{\"display_event\": {\"name\": \"volt_set\", \"value\": 240}}",
+    "{\"display_event\": {\"name\": \"inter_enable\", \"value\": 1}}",
+    "{\"display_event\": {\"name\": \"dump_fan\", \"value\": 0}}",
+    "{\"display_event\": {\"name\": \"noop\", \"value\": 0}}",
+    "{\"display_event\": {\"name\": \"t1\", \"value\": \"0.02\"}}",
+  };
+  static const char* const event_names[] = {
+    "process_event_in_uc/curr_set", "process_event_in_uc/volt_set",
+    "process_event_in_uc/inter_enable", "process_event_in_uc/dump_fan",
+    "process_event_in_uc/noop", "process_event_in_uc/t1",
+  };
+  for (size_t e = 0; e < sizeof(events) / sizeof(events[0]); ++e) {
+    // t1 reloads the waveform; keep its batches short
+    const uint32_t batch = (e == 5) ? 10U : BENCH_BATCH;
+    bench(event_names[e], batch, [] {}, [e](uint32_t) { process_event_in_uc(events[e]); });
+  }
+
+  bench("get_poll_data", [](uint32_t) {
+    volatile uint64_t w = get_poll_data();
+    (void)w;
+  });
+  return 0;
+}
@@ -0,0 +1,55 @@
+#include "Plant.h"
+#include <math.h>
+
+Plant::Plant(const PlantParams& p, uint32_t seed)
+    : p_(p), s_{p.v0, 0.0f, 0.0f}, rng_(seed ? seed : 1U) {}
+
+void Plant::reset(float v0, float r_load) {
+  p_.v0 = v0;
+  p_.r_load = r_load;
+  s_ = PlantState{v0, 0.0f, 0.0f};
+}
+
+void Plant::step(float dt_s, bool gate_on) {
+  float di;
+  if (gate_on && s_.v_bank > 0.0f) {
+    // Bank drives the load through the switch
+    di = (s_.v_bank - (p_.r_load + p_.r_on) * s_.i_load) / p_.l_load;
+    s_.v_bank -= s_.i_load * dt_s / p_.c_bank_f;
+    if (s_.v_bank < 0.0f) s_.v_bank = 0.0f;
+  } else {
+    // Load current circulates through the freewheel diode
+    di = (s_.i_load > 0.0f) ? -(p_.v_diode + p_.r_load * s_.i_load) / p_.l_load : 0.0f;
+  }
+  s_.i_load += di * dt_s;
+  if (s_.i_load < 0.0f) s_.i_load = 0.0f;
+
+  const float k = dt_s / (p_.probe_tau_s + dt_s);
+  s_.i_probe += k * (s_.i_load - s_.i_probe);
+}
+
+int Plant::voltage_raw(float scale, float offset) {
+  return to_raw(s_.v_bank + p_.v_noise * gauss(), scale, offset);
+}
+
+int Plant::current_raw(float scale, float offset) {
+  return to_raw(s_.i_probe + p_.probe_noise_a * gauss(), scale, offset);
+}
+
+int Plant::to_raw(float value, float scale, float offset) {
+  if (scale == 0.0f) return 2048;
+  const float raw = ((value - offset) / scale + 1.65f) * (4095.0f / 3.3f);
+  if (!(raw > 0.0f)) return 0;
+  if (raw >= 4095.0f) return 4095;
+  return (int)(raw + 0.5f);
+}
+
+// xorshift64* and Box-Muller: deterministic for a given seed
+float Plant::gauss() {
+  auto next = [this]() {
+    rng_ ^= rng_ >> 12; rng_ ^= rng_ << 25; rng_ ^= rng_ >> 27;
+    return (double)((rng_ * 2685821657736338717ULL) >> 11) * (1.0 / 9007199254740992.0);
+  };
+  const double u1 = next() + 1e-12, u2 = next();
+  return (float)(sqrt(-2.0 * log(u1)) * cos(6.283185307179586 * u2));
+}
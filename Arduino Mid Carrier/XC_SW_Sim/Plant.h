@@ -0,0 +1,52 @@
+// Electrical model of the capacitor bank, IGBT and inductive load that
+// XC_SW regulates. Integrated with a fixed substep between control ticks.
+#ifndef PLANT_H
+#define PLANT_H
+
+#include <stdint.h>
+
+struct PlantParams {
+  float c_bank_f      = 4.0f;      // Bank capacitance (F)
+  float v0            = 250.0f;    // Bank voltage at the start of a shot (V)
+  float r_load        = 0.012f;    // Load resistance (ohm)
+  float l_load        = 120e-6f;   // Load inductance (H)
+  float r_on          = 0.0005f;   // IGBT on-resistance (ohm)
+  float v_diode       = 0.8f;      // Freewheel diode drop (V)
+  float probe_tau_s   = 20e-6f;    // Current probe bandwidth (first-order lag)
+  float probe_noise_a = 5.0f;      // Current probe noise (A rms)
+  float v_noise       = 0.5f;      // Voltage probe noise (V rms)
+};
+
+struct PlantState {
+  float v_bank;    // Capacitor voltage (V)
+  float i_load;    // Inductor current (A)
+  float i_probe;   // Current probe output before the ADC (A)
+};
+
+class Plant {
+public:
+  explicit Plant(const PlantParams& p, uint32_t seed);
+
+  void reset(float v0, float r_load);
+
+  // Advance by dt with the IGBT conducting (gate_on) or freewheeling
+  void step(float dt_s, bool gate_on);
+
+  const PlantState&  state()  const { return s_; }
+  const PlantParams& params() const { return p_; }
+
+  // 12-bit ADC codes the probes would produce, using the inverse of the
+  // firmware scaling: value = (raw / 4095 * 3.3 - 1.65) * scale + offset
+  int voltage_raw(float scale, float offset);
+  int current_raw(float scale, float offset);
+
+private:
+  float gauss();
+  static int to_raw(float value, float scale, float offset);
+
+  PlantParams p_;
+  PlantState  s_;
+  uint64_t    rng_;
+};
+
+#endif // PLANT_H
@@ -0,0 +1,335 @@
+// Closed-loop host simulation of XC_SW: the firmware modules run unmodified
+// against the fake HAL, the scheduler is ticked by simulated TIM7 update
+// events, and Plant closes the loop through the analog reader hooks and,
+// for the current, ADC2 conversions at each TIM3 period.
+// Prints one CSV line of tracking metrics per shot. After the random shots
+// one more runs the shipped profile timing (t1 500 ms, th 100 ms, t2 500 ms,
+// the Client Interface defaults) to cover multi-second profiles.
+//
+//   xc_sw_sim [--shots N] [--seed S] [--rload OHM] [--v0 V] [--igbt-hz F] [--trace FILE]
+//                [--scope FILE]
+//
+// --igbt-hz overrides IGBT_PWM_FREQ_HZ (the current is sampled once per
+// IGBT period, phase-locked to the PWM, at any frequency).
+// --trace writes the per-tick setpoint, plant and gate state for plotting.
+// --scope downloads each shot's on-device scope capture (armed on the
+// waveform start) through scope_read(), as the bridge does.
+// Exits non-zero if any shot failed to start, ended with a trip latched, or
+// tracked worse than MAX_RMS_ERR_FRAC / MAX_ERR_FRAC of its hold current,
+// or overshot it by more than MAX_OVERSHOOT_FRAC. Overshoot is taken on the
+// current averaged over one IGBT period, so the switching ripple does not
+// count, and is not gated for shots held below IGBT_MIN_DUTY_PCT: those are
+// a train of minimum pulses whose current steps the regulator cannot shrink.
+#include <Arduino.h>
+#include <chrono>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#include "Config.h"
+#include "Firmware.h"
+#include "PowerState.h"
+#include "Voltage.h"
+#include "Temperature.h"
+#include "CurrWaveform.h"
+#include "Scheduler.h"
+#include "FastTrip.h"
+#include "SensorConv.h"
+#include "Scope.h"
+#include "ParamStore.h"
+
+#include "SimHw.h"
+#include "Plant.h"
+
+// Normally defined in XC_SW.ino
+volatile bool     m4_sync_done = false;
+volatile uint16_t m4_status = 0xA0B0;
+
+// ----- Sim configuration -----
+static const uint32_t TICK_NS     = 1000000000U / CONTROL_RATE_HZ;
+static const uint32_t SUBSTEP_NS  = 1000U;
+static const uint32_t IDLE_TICKS  = CONTROL_RATE_HZ / 100U;   // 10 ms between shots
+static const int      MAX_LAG_TICKS = 200;
+static const double   MAX_RMS_ERR_FRAC   = 0.15;   // rms_err limit, fraction of i_hold
+static const double   MAX_ERR_FRAC       = 0.50;   // max_err limit, fraction of i_hold
+static const double   MAX_OVERSHOOT_FRAC = 0.10;   // period-mean peak above i_hold
+static const uint32_t SCOPE_CHUNK = 64U;   // SCOPE_RPC_MAX (SerialComms.h)
+
+// Random shots: 20 ms rise, 100 ms hold, 20 ms fall
+static const float SHOT_T1_S = 0.020f, SHOT_TH_S = 0.100f, SHOT_T2_S = 0.020f;
+// Default-timing shot (waveform.html defaults, ms → s as the bridge sends them)
+static const float DEFAULT_T1_S = 0.500f, DEFAULT_TH_S = 0.100f, DEFAULT_T2_S = 0.500f;
+static const float DEFAULT_I_HOLD = 1000.0f;
+
+// Probe calibration used for the run (firmware defaults are bring-up values)
+static const float SIM_VSCALE_V = 606.06f;    // ±1000 V full scale
+static const float SIM_VSCALE_C = 2575.75f;   // ±4250 A full scale
+
+struct SimOptions {
+  int         shots  = 10;
+  uint32_t    seed   = 1;
+  float       rload  = 0.0f;    // 0 = randomize per shot
+  float       v0     = 250.0f;
+  float       igbt_hz = 0.0f;   // 0 = firmware default
+  std::string trace;
+  std::string scope;
+};
+
+struct ShotStats {
+  std::vector<float> ref, meas;
+  double   tick_ns_sum = 0.0;
+  double   tick_ns_max = 0.0;
+  uint32_t ticks = 0;
+};
+
+static Plant* g_plant = nullptr;
+static int    g_raw_v = 2048, g_raw_i = 2048;
+static uint64_t g_tim3_cycles = 0;
+static FILE*  g_trace = nullptr;
+static FILE*  g_scope = nullptr;
+
+// ----- Analog reader hooks -----
+static int read_voltage(uint8_t)     { return g_raw_v; }
+static int read_temperature(uint8_t) { return 2048; }
+
+static void firmware_setup() {
+  // Calibrate once through the flash store; init_firmware() then boots
+  // from it as a calibrated unit would
+  init_param_store();
+  VScale_V = SIM_VSCALE_V;  VOffset_V = 0.0f;
+  VScale_C = SIM_VSCALE_C;  VOffset_C = 0.0f;
+  if (param_store_save() != 1) fprintf(stderr, "param store: save failed\n");
+  VScale_V = VScale_C = 0.0f;
+
+  // Inputs the firmware samples during init: no gate fault, external enable on
+  sim_set_pin_input(DPIN_GATE_FAULT, HIGH);
+  sim_set_pin_input(DPIN_ENABLE_IN, HW_INPUT_ACTIVE_STATE);
+
+  // setup() as on the M4; ticks only come from sim_tim_update_event()
+  init_firmware();
+  if (param_store_seq() == 0 || VScale_V != SIM_VSCALE_V || VScale_C != SIM_VSCALE_C) {
+    fprintf(stderr, "param store: calibration not restored\n");
+  }
+
+  set_voltage_analog_reader(read_voltage);
+  set_temperature_analog_reader(read_temperature);
+}
+
+// One control period: integrate the plant, convert, then fire TIM7
+static void run_tick(ShotStats* st, int shot) {
+  Plant& plant = *g_plant;
+  uint32_t on_substeps = 0;
+  for (uint32_t t = 0; t < TICK_NS; t += SUBSTEP_NS) {
+    // TIM3 CH2 drives the gate active-low
+    const bool gate_on = (sim_tim_output(TIM3, 2, HIGH) == LOW);
+    on_substeps += gate_on ? 1U : 0U;
+    plant.step(SUBSTEP_NS * 1e-9f, gate_on);
+    sim_advance_ns(SUBSTEP_NS);
+
+    // TIM3 TRGO (OC4REF) triggers ADC2 as the counter passes 0
+    const uint64_t cycles = sim_tim_cycles(TIM3);
+    if (cycles != g_tim3_cycles) {
+      g_tim3_cycles = cycles;
+      const uint16_t adc2[2] = { 0, (uint16_t)plant.current_raw(VScale_C, VOffset_C) };
+      sim_adc_convert(ADC2, adc2, 2);
+    }
+  }
+
+  g_raw_v = plant.voltage_raw(VScale_V, VOffset_V);
+  g_raw_i = plant.current_raw(VScale_C, VOffset_C);
+  const uint16_t adc1[3] = { 0, (uint16_t)g_raw_i, (uint16_t)g_raw_v };
+  const uint16_t adc3[1] = { 2048 };
+  sim_adc_convert(ADC1, adc1, 3);
+  sim_adc_convert(ADC3, adc3, 1);
+
+  const auto t0 = std::chrono::steady_clock::now();
+  sim_tim_update_event(TIM7);
+  const double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count();
+
+  if (!st) return;
+  st->tick_ns_sum += ns;
+  if (ns > st->tick_ns_max) st->tick_ns_max = ns;
+  st->ticks++;
+  st->ref.push_back((float)PowerState::setCurrent);
+  st->meas.push_back(plant.state().i_load);
+
+  if (g_trace) {
+    fprintf(g_trace, "%d,%.3f,%.1f,%.1f,%.1f,%.2f,%.3f\n", shot,
+            st->ticks * (TICK_NS * 1e-6), (double)PowerState::setCurrent,
+            (double)plant.state().i_load, (double)plant.state().i_probe,
+            (double)plant.state().v_bank, on_substeps / (double)(TICK_NS / SUBSTEP_NS));
+  }
+}
+
+// Rise/hold/fall smoothstep, loaded the same way the bridge's legacy path does
+static void load_shot_waveform(float i_hold, float t1, float th, float t2) {
+  PowerState::currT1 = t1;      PowerState::currTHold = th;      PowerState::currT2 = t2;
+  PowerState::currA1 = 0.0f;    PowerState::currB1 = 0.0f;
+  PowerState::currC1 = 3.0f * i_hold;   PowerState::currD1 = -2.0f * i_hold;
+  PowerState::currA2 = i_hold;  PowerState::currB2 = 0.0f;
+  PowerState::currC2 = -3.0f * i_hold;  PowerState::currD2 = 2.0f * i_hold;
+  curr_waveform_load_legacy();
+}
+
+// Download the frozen capture in RPC-sized chunks, then re-arm
+static void dump_scope(int shot) {
+  const std::vector<uint8_t> st = scope_status();
+  uint32_t capture;
+  uint16_t pre, post, decimation;
+  memcpy(&capture, &st[4], 4);
+  memcpy(&pre, &st[8], 2);
+  memcpy(&post, &st[10], 2);
+  memcpy(&decimation, &st[12], 2);
+  if (st[1] != SCOPE_FROZEN) {
+    fprintf(stderr, "shot %d: scope not frozen (state %u)\n", shot, st[1]);
+    return;
+  }
+
+  const double dt_ms = decimation * (TICK_NS * 1e-6);
+  uint32_t offset = 0;
+  for (;;) {
+    const std::vector<uint8_t> chunk = scope_read(capture, offset, SCOPE_CHUNK);
+    if (chunk.empty()) break;
+    for (size_t i = 0; i < chunk.size(); i += sizeof(ScopeSample), ++offset) {
+      ScopeSample r;
+      memcpy(&r, &chunk[i], sizeof(r));
+      fprintf(g_scope, "%d,%u,0x%X,%.3f,%.1f,%.1f,%.1f,%.4f,0x%X\n", shot, capture, st[3],
+              ((double)offset - pre) * dt_ms, (double)r.volt, (double)r.curr,
+              (double)r.curr_set, r.duty / 65535.0, r.flags);
+    }
+  }
+  if (offset != (uint32_t)pre + post) fprintf(stderr, "shot %d: scope read %u of %u records\n", shot, offset, pre + post);
+  init_scope();
+}
+
+static double rms_at_shift(const ShotStats& st, int k) {
+  double sum = 0.0;
+  size_t n = 0;
+  for (size_t i = 0; i + (size_t)k < st.ref.size(); ++i, ++n) {
+    const double e = st.ref[i] - st.meas[i + k];
+    sum += e * e;
+  }
+  return n ? sqrt(sum / n) : 0.0;
+}
+
+static float uniform(uint64_t& s, float lo, float hi) {
+  s = s * 6364136223846793005ULL + 1442695040888963407ULL;
+  return lo + (hi - lo) * (float)((s >> 40) * (1.0 / 16777216.0));
+}
+
+static bool parse_args(int argc, char** argv, SimOptions& o) {
+  for (int i = 1; i < argc; ++i) {
+    const std::string a = argv[i];
+    const bool has_val = (i + 1 < argc);
+    if      (a == "--shots" && has_val) o.shots = atoi(argv[++i]);
+    else if (a == "--seed"  && has_val) o.seed  = (uint32_t)strtoul(argv[++i], nullptr, 0);
+    else if (a == "--rload" && has_val) o.rload = (float)atof(argv[++i]);
+    else if (a == "--v0"    && has_val) o.v0    = (float)atof(argv[++i]);
+    else if (a == "--igbt-hz" && has_val) o.igbt_hz = (float)atof(argv[++i]);
+    else if (a == "--trace" && has_val) o.trace = argv[++i];
+    else if (a == "--scope" && has_val) o.scope = argv[++i];
+    else {
+      fprintf(stderr, "usage: %s [--shots N] [--seed S] [--rload OHM] [--v0 V] [--igbt-hz F] [--trace FILE] [--scope FILE]\n", argv[0]);
+      return false;
+    }
+  }
+  return o.shots > 0;
+}
+
+int main(int argc, char** argv) {
+  SimOptions opt;
+  if (!parse_args(argc, argv, opt)) return 2;
+
+  PlantParams pp;
+  pp.v0 = opt.v0;
+  Plant plant(pp, opt.seed);
+  g_plant = &plant;
+
+  if (!opt.trace.empty()) {
+    g_trace = fopen(opt.trace.c_str(), "w");
+    if (!g_trace) { perror(opt.trace.c_str()); return 1; }
+    fprintf(g_trace, "shot,t_ms,i_set_A,i_load_A,i_probe_A,v_bank_V,gate_duty\n");
+  }
+
+  if (!opt.scope.empty()) {
+    g_scope = fopen(opt.scope.c_str(), "w");
+    if (!g_scope) { perror(opt.scope.c_str()); return 1; }
+    fprintf(g_scope, "shot,capture,trigger,t_ms,volt_V,curr_A,curr_set_A,duty,flags\n");
+  }
+
+  if (opt.igbt_hz > 0.0f) IGBT_PWM_FREQ_HZ = opt.igbt_hz;
+  firmware_setup();
+  if (!scheduler_running()) {
+    fprintf(stderr, "scheduler did not start\n");
+    return 1;
+  }
+
+  printf("shot,i_hold_A,r_load_ohm,v0_V,ticks,rms_err_A,max_err_A,overshoot_pct,"
+         "lag_ms,trip,tick_ns_mean,tick_ns_max,rt_factor\n");
+
+  uint64_t rng = opt.seed;
+  int failures = 0;
+  for (int shot = 0; shot <= opt.shots; ++shot) {
+    const bool  dflt   = (shot == opt.shots);
+    const float i_hold = dflt ? DEFAULT_I_HOLD : uniform(rng, 500.0f, 3000.0f);
+    const float r_load = (opt.rload > 0.0f) ? opt.rload : uniform(rng, 0.010f, 0.016f);
+
+    // Idle: new profile is adopted, bank recharged
+    PowerState::internalEnable = false;
+    fast_trip_clear();
+    if (dflt) load_shot_waveform(i_hold, DEFAULT_T1_S, DEFAULT_TH_S, DEFAULT_T2_S);
+    else      load_shot_waveform(i_hold, SHOT_T1_S, SHOT_TH_S, SHOT_T2_S);
+    plant.reset(opt.v0, r_load);
+    for (uint32_t i = 0; i < IDLE_TICKS; ++i) run_tick(nullptr, shot);
+
+    // Rising edge on the enable starts the waveform
+    ShotStats st;
+    const auto w0 = std::chrono::steady_clock::now();
+    PowerState::internalEnable = true;
+    bool started = false;
+    for (uint32_t i = 0; i < WAVE_MAX_TICKS + IDLE_TICKS; ++i) {
+      run_tick(&st, shot);
+      if (PowerState::runCurrentWave) started = true;
+      else if (started) break;
+    }
+    const double wall_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - w0).count();
+    PowerState::internalEnable = false;
+    if (g_scope) dump_scope(shot);
+
+    const double per_ticks = (double)CONTROL_RATE_HZ / IGBT_PWM_FREQ_HZ;
+    const size_t n_avg = per_ticks > 1.0 ? (size_t)(per_ticks + 0.5) : 1U;
+    double max_err = 0.0, peak = 0.0, win = 0.0;
+    for (size_t i = 0; i < st.ref.size(); ++i) {
+      max_err = fmax(max_err, fabs(st.ref[i] - st.meas[i]));
+      win += st.meas[i];
+      if (i >= n_avg) win -= st.meas[i - n_avg];
+      if (i + 1 >= n_avg) peak = fmax(peak, win / n_avg);
+    }
+    int best_k = 0;
+    double best_rms = rms_at_shift(st, 0);
+    for (int k = 1; k <= MAX_LAG_TICKS; ++k) {
+      const double r = rms_at_shift(st, k);
+      if (r < best_rms) { best_rms = r; best_k = k; }
+    }
+    const double overshoot = fmax(0.0, (peak - i_hold) / i_hold * 100.0);
+    const double sim_s = st.ticks * (TICK_NS * 1e-9);
+    const uint32_t trip = fast_trip_status();
+    const double rms_err = rms_at_shift(st, 0);
+    const double hold_duty = i_hold * (r_load + plant.params().r_on) / opt.v0;
+    const bool gate_overshoot = hold_duty >= IGBT_MIN_DUTY_PCT * 0.01;
+    if (!started || trip) failures++;
+    else if (rms_err > MAX_RMS_ERR_FRAC * i_hold || max_err > MAX_ERR_FRAC * i_hold) failures++;
+    else if (gate_overshoot && overshoot > MAX_OVERSHOOT_FRAC * 100.0) failures++;
+
+    printf("%d,%.1f,%.4f,%.1f,%u,%.1f,%.1f,%.2f,%.2f,0x%X,%.0f,%.0f,%.1f\n",
+           shot, i_hold, r_load, opt.v0, st.ticks, rms_err, max_err, overshoot,
+           best_k * (TICK_NS * 1e-6), trip,
+           st.ticks ? st.tick_ns_sum / st.ticks : 0.0, st.tick_ns_max,
+           wall_s > 0.0 ? sim_s / wall_s : 0.0);
+  }
+
+  if (g_trace) fclose(g_trace);
+  if (g_scope) fclose(g_scope);
+  return failures ? 1 : 0;
+}
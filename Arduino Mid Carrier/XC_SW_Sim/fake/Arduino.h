@@ -0,0 +1,64 @@
+// Host stand-in for the Arduino core used by XC_SW (see FakeArduino.cpp)
+#ifndef FAKE_ARDUINO_H
+#define FAKE_ARDUINO_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+// Portenta H7 pin names used by Config.h; values index the fake pin table
+enum : uint8_t {
+  PA_9 = 1, PA_10, PB_10, PC_7, PE_10, PE_11, PF_3, PF_4, PF_6, PF_8, PF_11, PF_12,
+  A0, A1, A2, SIM_NUM_PINS
+};
+
+#define LOW             0
+#define HIGH            1
+#define INPUT           0
+#define OUTPUT          1
+#define INPUT_PULLUP    2
+#define INPUT_PULLDOWN  3
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t value);
+int  digitalRead(uint8_t pin);
+int  analogRead(uint8_t pin);
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+
+struct FakeSerial {
+  void begin(unsigned long) {}
+  template <typename T> void print(const T&) {}
+  template <typename T> void println(const T&) {}
+  template <typename T> void println(const T&, int) {}
+  void println() {}
+  void flush() {}
+};
+extern FakeSerial Serial;
+
+// ----- Cortex-M intrinsics -----
+// The sim is single threaded: "interrupts" are only delivered between
+// firmware calls, and masked ones stay pending until PRIMASK and FAULTMASK
+// clear.
+extern volatile uint32_t g_sim_primask;
+extern volatile uint32_t g_sim_faultmask;
+void sim_deliver_pending_irqs();
+
+static inline uint32_t __get_PRIMASK(void) { return g_sim_primask; }
+static inline void __set_PRIMASK(uint32_t m) { g_sim_primask = m; if (!m) sim_deliver_pending_irqs(); }
+static inline void __disable_irq(void) { g_sim_primask = 1; }
+static inline void __enable_irq(void) { __set_PRIMASK(0); }
+static inline uint32_t __get_FAULTMASK(void) { return g_sim_faultmask; }
+static inline void __set_FAULTMASK(uint32_t m) { g_sim_faultmask = m; if (!m) sim_deliver_pending_irqs(); }
+static inline void __DMB(void) {}
+static inline void __DSB(void) {}
+static inline void __ISB(void) {}
+
+void NVIC_SetVector(int irq, uint32_t vector);
+
+#endif // FAKE_ARDUINO_H
@@ -0,0 +1,43 @@
+#include "Arduino.h"
+#include "RPC.h"
+#include "SimHw.h"
+
+FakeSerial Serial;
+FakeRPC    RPC;
+
+static uint8_t s_pin_out[SIM_NUM_PINS] = {};
+static uint8_t s_pin_in[SIM_NUM_PINS]  = {};
+static int     s_analog[SIM_NUM_PINS]  = {};
+
+void pinMode(uint8_t, uint8_t) {}
+
+void digitalWrite(uint8_t pin, uint8_t value) {
+  if (pin < SIM_NUM_PINS) s_pin_out[pin] = value ? HIGH : LOW;
+}
+
+int digitalRead(uint8_t pin) {
+  return (pin < SIM_NUM_PINS) ? s_pin_in[pin] : LOW;
+}
+
+int analogRead(uint8_t pin) {
+  return (pin < SIM_NUM_PINS) ? s_analog[pin] : 0;
+}
+
+unsigned long millis() { return (unsigned long)(sim_now_ns() / 1000000ULL); }
+unsigned long micros() { return (unsigned long)(sim_now_ns() / 1000ULL); }
+
+// Firmware never blocks on the control path; treat delays as elapsed time
+void delay(unsigned long ms) { sim_advance_ns((uint64_t)ms * 1000000ULL); }
+void delayMicroseconds(unsigned int us) { sim_advance_ns((uint64_t)us * 1000ULL); }
+
+void sim_set_pin_input(uint8_t pin, int level) {
+  if (pin < SIM_NUM_PINS) s_pin_in[pin] = level ? HIGH : LOW;
+}
+
+int sim_pin_output(uint8_t pin) {
+  return (pin < SIM_NUM_PINS) ? s_pin_out[pin] : LOW;
+}
+
+void sim_set_analog(uint8_t pin, int raw) {
+  if (pin < SIM_NUM_PINS) s_analog[pin] = raw;
+}
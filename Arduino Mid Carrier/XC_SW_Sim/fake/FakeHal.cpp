@@ -0,0 +1,537 @@
+#include "stm32h7xx_hal.h"
+#include "Arduino.h"
+#include "SimHw.h"
+#include <string.h>
+
+// ----- Peripheral register blocks -----
+static TIM_TypeDef        s_tim[7];
+static GPIO_TypeDef       s_gpio[5];
+static ADC_TypeDef        s_adc[3];
+static DMA_Stream_TypeDef s_dma_streams[8];
+static DWT_Type           s_dwt;
+static CoreDebug_Type     s_core_debug;
+static SCB_Type           s_scb;
+static FLASH_TypeDef      s_flash;
+
+TIM_TypeDef *TIM1 = &s_tim[0], *TIM2 = &s_tim[1], *TIM3 = &s_tim[2], *TIM6 = &s_tim[3],
+            *TIM7 = &s_tim[4], *TIM15 = &s_tim[5], *TIM16 = &s_tim[6];
+GPIO_TypeDef *GPIOA = &s_gpio[0], *GPIOB = &s_gpio[1], *GPIOC = &s_gpio[2],
+             *GPIOE = &s_gpio[3], *GPIOF = &s_gpio[4];
+ADC_TypeDef *ADC1 = &s_adc[0], *ADC2 = &s_adc[1], *ADC3 = &s_adc[2];
+DMA_Stream_TypeDef *DMA1_Stream0 = &s_dma_streams[0], *DMA1_Stream1 = &s_dma_streams[1],
+                   *DMA1_Stream2 = &s_dma_streams[2], *DMA1_Stream3 = &s_dma_streams[3],
+                   *DMA2_Stream0 = &s_dma_streams[4], *DMA2_Stream1 = &s_dma_streams[5],
+                   *DMA2_Stream2 = &s_dma_streams[6], *DMA2_Stream3 = &s_dma_streams[7];
+DWT_Type*       DWT       = &s_dwt;
+CoreDebug_Type* CoreDebug = &s_core_debug;
+SCB_Type*       SCB       = &s_scb;
+FLASH_TypeDef*  FLASH     = &s_flash;
+uint32_t        SystemCoreClock = 240000000U;   // M4 core on the Portenta H7
+
+static const uint32_t TIMER_CLOCK_HZ = 200000000U;  // Same assumption as the firmware
+
+static uint64_t s_now_ns = 0;
+
+// ----- NVIC -----
+typedef void (*IsrFunc)();
+
+struct IrqLine {
+  uint32_t vector;
+  uint8_t  priority;
+  bool     enabled;
+  bool     pending;
+};
+
+static IrqLine s_irq[SIM_NUM_IRQS] = {};
+volatile uint32_t g_sim_primask = 0;
+volatile uint32_t g_sim_faultmask = 0;
+
+static void dispatch_irq(IRQn_Type irq) {
+  IrqLine& l = s_irq[irq];
+  l.pending = false;
+  if (l.vector == 0) return;
+  // Vectors are stored as 32-bit addresses like on the target; the sim is
+  // linked non-PIE so code addresses fit.
+  ((IsrFunc)(uintptr_t)l.vector)();
+}
+
+void NVIC_SetVector(int irq, uint32_t vector) {
+  if (irq >= 0 && irq < SIM_NUM_IRQS) s_irq[irq].vector = vector;
+}
+
+void HAL_NVIC_SetPriority(IRQn_Type irq, uint32_t preempt, uint32_t) {
+  if (irq >= 0 && irq < SIM_NUM_IRQS) s_irq[irq].priority = (uint8_t)preempt;
+}
+
+void HAL_NVIC_EnableIRQ(IRQn_Type irq) {
+  if (irq < 0 || irq >= SIM_NUM_IRQS) return;
+  s_irq[irq].enabled = true;
+  sim_deliver_pending_irqs();
+}
+
+void HAL_NVIC_DisableIRQ(IRQn_Type irq) {
+  if (irq >= 0 && irq < SIM_NUM_IRQS) s_irq[irq].enabled = false;
+}
+
+void sim_raise_irq(IRQn_Type irq) {
+  if (irq < 0 || irq >= SIM_NUM_IRQS) return;
+  s_irq[irq].pending = true;
+  sim_deliver_pending_irqs();
+}
+
+int sim_irq_priority(IRQn_Type irq) {
+  return (irq >= 0 && irq < SIM_NUM_IRQS) ? s_irq[irq].priority : -1;
+}
+
+void sim_deliver_pending_irqs() {
+  if (g_sim_primask || g_sim_faultmask) return;
+  // Highest priority (lowest number) first, like the NVIC
+  for (;;) {
+    int best = -1;
+    for (int i = 0; i < SIM_NUM_IRQS; ++i) {
+      if (s_irq[i].pending && s_irq[i].enabled &&
+          (best < 0 || s_irq[i].priority < s_irq[best].priority)) best = i;
+    }
+    if (best < 0) return;
+    dispatch_irq(best);
+  }
+}
+
+uint32_t HAL_GetTick(void) { return (uint32_t)(s_now_ns / 1000000ULL); }
+uint32_t HAL_RCC_GetPCLK1Freq(void) { return TIMER_CLOCK_HZ / 2U; }
+
+uint64_t sim_now_ns() { return s_now_ns; }
+
+void sim_advance_ns(uint64_t dt_ns) {
+  s_now_ns += dt_ns;
+  s_dwt.CYCCNT += (uint32_t)((dt_ns * (SystemCoreClock / 1000000U)) / 1000U);
+}
+
+// ----- DMA -----
+// Streams move one element per request. Only the requests the sim raises
+// (timer update events, ADC conversions) are modelled.
+struct DmaState {
+  DMA_HandleTypeDef* h;
+  bool     active;
+  uint32_t src, dst;   // Current addresses
+  uint32_t src0, dst0; // Start addresses (circular reload)
+  uint32_t len;
+};
+
+static DmaState s_dma[8] = {};
+
+static DmaState* dma_state(void* instance) {
+  for (int i = 0; i < 8; ++i) {
+    if (instance == &s_dma_streams[i]) return &s_dma[i];
+  }
+  return nullptr;
+}
+
+static uint32_t dma_elem_size(const DMA_InitTypeDef& init) {
+  return (init.PeriphDataAlignment == DMA_PDATAALIGN_WORD) ? 4U :
+         (init.PeriphDataAlignment == DMA_PDATAALIGN_HALFWORD) ? 2U : 1U;
+}
+
+// One request on a running stream; `value` overrides the source for
+// peripheral-to-memory transfers (the peripheral's data register)
+static void dma_request(DmaState& d, const uint32_t* value) {
+  if (!d.active) return;
+  DMA_Stream_TypeDef* s = (DMA_Stream_TypeDef*)d.h->Instance;
+  const DMA_InitTypeDef& init = d.h->Init;
+  const uint32_t size = dma_elem_size(init);
+
+  uint32_t v = 0;
+  if (value) v = *value;
+  else memcpy(&v, (const void*)(uintptr_t)d.src, size);
+  memcpy((void*)(uintptr_t)d.dst, &v, size);
+
+  const bool to_periph = (init.Direction == DMA_MEMORY_TO_PERIPH);
+  if (to_periph) {
+    if (init.MemInc == DMA_MINC_ENABLE)    d.src += size;
+    if (init.PeriphInc == DMA_PINC_ENABLE) d.dst += size;
+  } else {
+    if (init.PeriphInc == DMA_PINC_ENABLE) d.src += size;
+    if (init.MemInc == DMA_MINC_ENABLE)    d.dst += size;
+  }
+
+  if (--s->NDTR == 0) {
+    if (init.Mode == DMA_CIRCULAR) {
+      s->NDTR = d.len;
+      d.src = d.src0;
+      d.dst = d.dst0;
+    } else {
+      d.active = false;
+    }
+  }
+}
+
+static void dma_request_line(uint32_t request, const uint32_t* value) {
+  for (int i = 0; i < 8; ++i) {
+    if (s_dma[i].active && s_dma[i].h->Init.Request == request) dma_request(s_dma[i], value);
+  }
+}
+
+HAL_StatusTypeDef HAL_DMA_Init(DMA_HandleTypeDef* h) {
+  DmaState* d = dma_state(h->Instance);
+  if (!d) return HAL_ERROR;
+  *d = DmaState{};
+  d->h = h;
+  return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_DMA_Start(DMA_HandleTypeDef* h, uint32_t src, uint32_t dst, uint32_t len) {
+  DmaState* d = dma_state(h->Instance);
+  if (!d || d->h != h || len == 0) return HAL_ERROR;
+  d->src = d->src0 = src;
+  d->dst = d->dst0 = dst;
+  d->len = len;
+  d->active = true;
+  ((DMA_Stream_TypeDef*)h->Instance)->NDTR = len;
+  return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_DMA_Abort(DMA_HandleTypeDef* h) {
+  DmaState* d = dma_state(h->Instance);
+  if (!d) return HAL_ERROR;
+  d->active = false;
+  ((DMA_Stream_TypeDef*)h->Instance)->NDTR = 0;
+  return HAL_OK;
+}
+
+// ----- GPIO -----
+struct AfRoute { GPIO_TypeDef** port; uint16_t pin; uint32_t af; TIM_TypeDef** tim; unsigned ch; };
+
+// Alternate functions XC_SW uses for timer outputs
+static const AfRoute s_af_routes[] = {
+  { &GPIOC, GPIO_PIN_7,  GPIO_AF2_TIM3,  &TIM3,  2 },
+  { &GPIOA, GPIO_PIN_9,  GPIO_AF1_TIM1,  &TIM1,  2 },
+  { &GPIOA, GPIO_PIN_10, GPIO_AF1_TIM1,  &TIM1,  3 },
+  { &GPIOF, GPIO_PIN_6,  GPIO_AF1_TIM16, &TIM16, 1 },
+};
+static bool s_af_active[sizeof(s_af_routes) / sizeof(s_af_routes[0])] = {};
+
+void HAL_GPIO_Init(GPIO_TypeDef* port, GPIO_InitTypeDef* init) {
+  for (size_t i = 0; i < sizeof(s_af_routes) / sizeof(s_af_routes[0]); ++i) {
+    const AfRoute& r = s_af_routes[i];
+    if (*r.port == port && (init->Pin & r.pin)) {
+      s_af_active[i] = (init->Mode == GPIO_MODE_AF_PP && init->Alternate == r.af);
+    }
+  }
+}
+
+GPIO_PinState HAL_GPIO_ReadPin(GPIO_TypeDef* port, uint16_t pin) {
+  for (size_t i = 0; i < sizeof(s_af_routes) / sizeof(s_af_routes[0]); ++i) {
+    const AfRoute& r = s_af_routes[i];
+    if (s_af_active[i] && *r.port == port && r.pin == pin) {
+      return sim_tim_output(*r.tim, r.ch, 1) ? GPIO_PIN_SET : GPIO_PIN_RESET;
+    }
+  }
+  return (port->ODR & pin) ? GPIO_PIN_SET : GPIO_PIN_RESET;
+}
+
+void HAL_GPIO_WritePin(GPIO_TypeDef* port, uint16_t pin, GPIO_PinState state) {
+  if (state == GPIO_PIN_SET) port->ODR |= pin;
+  else                       port->ODR &= ~(uint32_t)pin;
+}
+
+void HAL_SYSCFG_AnalogSwitchConfig(uint32_t, uint32_t) {}
+
+// ----- Timers -----
+static inline unsigned ch_index(uint32_t channel) { return channel >> 2; }   // TIM_CHANNEL_x -> 0..3
+
+static inline uint32_t oc_mode(const TIM_TypeDef* tim, unsigned idx) {
+  const uint32_t reg = (idx < 2) ? tim->CCMR1 : tim->CCMR2;
+  const unsigned sh  = (idx & 1U) ? 8U : 0U;
+  return ((reg >> (4U + sh)) & 7U) | (((reg >> (16U + sh)) & 1U) << 3);
+}
+
+static IRQn_Type tim_irq(const TIM_TypeDef* tim) {
+  if (tim == TIM3)  return TIM3_IRQn;
+  if (tim == TIM6)  return TIM6_DAC_IRQn;
+  if (tim == TIM7)  return TIM7_IRQn;
+  if (tim == TIM16) return TIM16_IRQn;
+  return -1;
+}
+
+static uint32_t tim_update_request(const TIM_TypeDef* tim) {
+  if (tim == TIM3) return DMA_REQUEST_TIM3_UP;
+  if (tim == TIM7) return DMA_REQUEST_TIM7_UP;
+  return 0xFFFFFFFFU;
+}
+
+static void tim_base_config(TIM_HandleTypeDef* h) {
+  TIM_TypeDef* t = h->Instance;
+  t->PSC = h->Init.Prescaler;
+  t->ARR = h->Init.Period;
+  t->CR1 = (t->CR1 & TIM_CR1_CEN) | (h->Init.CounterMode & TIM_CR1_CMS) | h->Init.AutoReloadPreload;
+}
+
+// Prescaled counter ticks since time 0
+static inline uint64_t tim_ticks(const TIM_TypeDef* tim) {
+  return (s_now_ns * (TIMER_CLOCK_HZ / 1000000U)) / 1000U / ((uint64_t)tim->PSC + 1U);
+}
+
+uint64_t sim_tim_cycles(const TIM_TypeDef* tim) {
+  if (!(tim->CR1 & TIM_CR1_CEN)) return 0;
+  const uint64_t period = (tim->CR1 & TIM_CR1_CMS) ? 2ULL * tim->ARR : (uint64_t)tim->ARR + 1U;
+  return (period > 0) ? tim_ticks(tim) / period : 0;
+}
+
+int sim_tim_output(const TIM_TypeDef* tim, unsigned channel, int idle_level) {
+  if (channel < 1 || channel > 4) return idle_level;
+  const unsigned idx = channel - 1U;
+  if (!(tim->CR1 & TIM_CR1_CEN) || !(tim->CCER & (TIM_CCER_CC1E << (4U * idx)))) return idle_level;
+
+  // Counter position from sim time
+  const uint64_t ticks = tim_ticks(tim);
+  const uint32_t arr   = tim->ARR;
+  uint32_t cnt;
+  if (tim->CR1 & TIM_CR1_CMS) {
+    const uint64_t p = (arr > 0) ? ticks % (2ULL * arr) : 0;
+    cnt = (uint32_t)((p <= arr) ? p : 2ULL * arr - p);
+  } else {
+    cnt = (uint32_t)(ticks % ((uint64_t)arr + 1U));
+  }
+
+  const uint32_t ccr = *(&tim->CCR1 + idx);
+  int ref;
+  switch (oc_mode(tim, idx)) {
+    case 4:  ref = 0; break;                    // Forced inactive
+    case 5:  ref = 1; break;                    // Forced active
+    case 6:  ref = (cnt < ccr) ? 1 : 0; break;  // PWM1
+    case 7:  ref = (cnt < ccr) ? 0 : 1; break;  // PWM2
+    default: ref = 0; break;
+  }
+  const int inverted = (tim->CCER >> (4U * idx + 1U)) & 1U;
+  return ref ^ inverted;
+}
+
+void sim_tim_update_event(TIM_TypeDef* tim) {
+  if (!(tim->CR1 & TIM_CR1_CEN)) return;
+  if (tim->DIER & TIM_DIER_UDE) dma_request_line(tim_update_request(tim), nullptr);
+  tim->SR |= TIM_SR_UIF;
+  if (tim->DIER & TIM_DIER_UIE) sim_raise_irq(tim_irq(tim));
+}
+
+HAL_StatusTypeDef HAL_TIM_Base_Init(TIM_HandleTypeDef* h) {
+  tim_base_config(h);
+  return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_TIM_Base_Start(TIM_HandleTypeDef* h) {
+  h->Instance->CR1 |= TIM_CR1_CEN;
+  return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_TIM_Base_Start_IT(TIM_HandleTypeDef* h) {
+  h->Instance->DIER |= TIM_DIER_UIE;
+  h->Instance->CR1  |= TIM_CR1_CEN;
+  return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_TIM_Base_Stop_IT(TIM_HandleTypeDef* h) {
+  h->Instance->DIER &= ~TIM_DIER_UIE;
+  h->Instance->CR1  &= ~TIM_CR1_CEN;
+  return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_TIM_PWM_Init(TIM_HandleTypeDef* h) {
+  tim_base_config(h);
+  return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_TIM_OnePulse_Init(TIM_HandleTypeDef* h, uint32_t mode) {
+  tim_base_config(h);
+  h->Instance->CR1 |= (mode & TIM_CR1_OPM);
+  return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_TIM_PWM_ConfigChannel(TIM_HandleTypeDef* h, TIM_OC_InitTypeDef* oc, uint32_t channel) {
+  TIM_TypeDef* t = h->Instance;
+  const unsigned idx = ch_index(channel);
+  if (idx > 3) return HAL_ERROR;
+
+  volatile uint32_t& ccmr = (idx < 2) ? t->CCMR1 : t->CCMR2;
+  const unsigned sh = (idx & 1U) ? 8U : 0U;
+  ccmr = (ccmr & ~(TIM_CCMR1_OC1M << sh)) | (oc->OCMode << sh);
+
+  *(&t->CCR1 + idx) = oc->Pulse;
+  t->CCER = (t->CCER & ~(TIM_OCPOLARITY_LOW << (4U * idx))) | (oc->OCPolarity << (4U * idx));
+  return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_TIM_PWM_Start(TIM_HandleTypeDef* h, uint32_t channel) {
+  h->Instance->CCER |= TIM_CCER_CC1E << (4U * ch_index(channel));
+  h->Instance->CR1  |= TIM_CR1_CEN;
+  return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_TIM_PWM_Stop(TIM_HandleTypeDef* h, uint32_t channel) {
+  h->Instance->CCER &= ~(TIM_CCER_CC1E << (4U * ch_index(channel)));
+  return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_TIMEx_MasterConfigSynchronization(TIM_HandleTypeDef* h, TIM_MasterConfigTypeDef* cfg) {
+  MODIFY_REG(h->Instance->CR2, TIM_CR2_MMS, cfg->MasterOutputTrigger);
+  return HAL_OK;
+}
+
+// ----- ADC -----
+// Channel binding only: the window lives in LTRx/HTRx, as on the part,
+// so the firmware may rewrite it mid-scan
+struct AdcWatchdog { bool enabled; uint32_t channel; };
+
+struct AdcState {
+  ADC_HandleTypeDef* h;
+  uint32_t    rank_channel[16];
+  uint8_t     nranks;
+  bool        running;
+  AdcWatchdog awd[3];   // AWD1..AWD3
+};
+
+static AdcState s_adc_state[3] = {};
+
+static AdcState* adc_state(const ADC_TypeDef* adc) {
+  for (int i = 0; i < 3; ++i) {
+    if (adc == &s_adc[i]) return &s_adc_state[i];
+  }
+  return nullptr;
+}
+
+static volatile uint32_t& adc_awd_low(ADC_TypeDef* adc, int n) {
+  return (n == 0) ? adc->LTR1 : (n == 1) ? adc->LTR2 : adc->LTR3;
+}
+
+static volatile uint32_t& adc_awd_high(ADC_TypeDef* adc, int n) {
+  return (n == 0) ? adc->HTR1 : (n == 1) ? adc->HTR2 : adc->HTR3;
+}
+
+static uint32_t adc_dma_request(const ADC_TypeDef* adc) {
+  if (adc == ADC1) return DMA_REQUEST_ADC1;
+  if (adc == ADC2) return DMA_REQUEST_ADC2;
+  return DMA_REQUEST_ADC3;
+}
+
+HAL_StatusTypeDef HAL_ADC_Init(ADC_HandleTypeDef* h) {
+  AdcState* a = adc_state(h->Instance);
+  if (!a) return HAL_ERROR;
+  *a = AdcState{};
+  a->h = h;
+  return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_ADCEx_Calibration_Start(ADC_HandleTypeDef*, uint32_t, uint32_t) { return HAL_OK; }
+
+HAL_StatusTypeDef HAL_ADC_ConfigChannel(ADC_HandleTypeDef* h, ADC_ChannelConfTypeDef* cfg) {
+  AdcState* a = adc_state(h->Instance);
+  const uint32_t rank = cfg->Rank / 6U;   // ADC_REGULAR_RANK_n == 6 * n
+  if (!a || rank < 1 || rank > 16) return HAL_ERROR;
+  a->rank_channel[rank - 1] = cfg->Channel;
+  if (rank > a->nranks) a->nranks = (uint8_t)rank;
+  return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_ADC_Start_DMA(ADC_HandleTypeDef* h, uint32_t* buf, uint32_t len) {
+  AdcState* a = adc_state(h->Instance);
+  if (!a || !h->DMA_Handle) return HAL_ERROR;
+  if (HAL_DMA_Start(h->DMA_Handle, (uint32_t)(uintptr_t)&h->Instance->DR,
+                    (uint32_t)(uintptr_t)buf, len) != HAL_OK) return HAL_ERROR;
+  h->Instance->IER |= ADC_IT_OVR;   // As the real HAL does
+  a->running = true;
+  return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_ADC_Stop_DMA(ADC_HandleTypeDef* h) {
+  AdcState* a = adc_state(h->Instance);
+  if (!a) return HAL_ERROR;
+  a->running = false;
+  if (h->DMA_Handle) HAL_DMA_Abort(h->DMA_Handle);
+  return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_ADC_AnalogWDGConfig(ADC_HandleTypeDef* h, ADC_AnalogWDGConfTypeDef* cfg) {
+  AdcState* a = adc_state(h->Instance);
+  if (!a || cfg->WatchdogNumber < 1 || cfg->WatchdogNumber > 3) return HAL_ERROR;
+  if (a->running) return HAL_ERROR;   // Same restriction as the real HAL
+
+  AdcWatchdog& w = a->awd[cfg->WatchdogNumber - 1];
+  w.enabled = true;
+  w.channel = cfg->Channel;
+  adc_awd_low(h->Instance, cfg->WatchdogNumber - 1)  = cfg->LowThreshold;   // 12-bit, no shift
+  adc_awd_high(h->Instance, cfg->WatchdogNumber - 1) = cfg->HighThreshold;
+
+  const uint32_t flag = ADC_FLAG_AWD1 << (cfg->WatchdogNumber - 1);
+  h->Instance->ISR &= ~flag;
+  if (cfg->ITMode == ENABLE) h->Instance->IER |= flag;
+  else                       h->Instance->IER &= ~flag;
+  return HAL_OK;
+}
+
+void sim_adc_convert(ADC_TypeDef* adc, const uint16_t* raw_for_channel, size_t nch) {
+  AdcState* a = adc_state(adc);
+  if (!a || !a->running) return;
+
+  bool irq = false;
+  for (uint8_t r = 0; r < a->nranks; ++r) {
+    const uint32_t ch  = a->rank_channel[r];
+    const uint32_t raw = (ch < nch) ? raw_for_channel[ch] : 0U;
+    adc->DR = raw;
+
+    for (int n = 0; n < 3; ++n) {
+      const AdcWatchdog& w = a->awd[n];
+      if (!w.enabled || w.channel != ch) continue;
+      if (raw >= adc_awd_low(adc, n) && raw <= adc_awd_high(adc, n)) continue;
+      const uint32_t flag = ADC_FLAG_AWD1 << n;
+      adc->ISR |= flag;
+      if (adc->IER & flag) irq = true;
+    }
+
+    const uint32_t v = raw;
+    dma_request_line(adc_dma_request(adc), &v);
+  }
+  adc->ISR |= ADC_FLAG_EOS;
+
+  if (irq) sim_raise_irq(adc == ADC3 ? ADC3_IRQn : ADC_IRQn);
+}
+
+// ----- Flash -----
+#define SIM_FLASH_BANK_SIZE  (FLASH_SECTOR_TOTAL * FLASH_SECTOR_SIZE)
+#define SIM_FLASH_WORD       (FLASH_NB_32BITWORD_IN_FLASHWORD * 4U)
+
+alignas(SIM_FLASH_WORD) uint8_t sim_flash_bank2[SIM_FLASH_BANK_SIZE];
+static bool s_flash_unlocked = false;
+
+// mbed linker script symbols: the sim image lies below .bss, where the
+// flash array is, and has no .data copy behind it
+extern "C" const uint8_t __data_start__[1] = {0};
+extern "C" const uint8_t __data_end__[1] __attribute__((alias("__data_start__")));
+
+// The part ships erased
+static const bool s_flash_init = [] {
+  memset(sim_flash_bank2, 0xFF, sizeof(sim_flash_bank2));
+  return true;
+}();
+
+HAL_StatusTypeDef HAL_FLASH_Unlock(void) { s_flash_unlocked = true;  return HAL_OK; }
+HAL_StatusTypeDef HAL_FLASH_Lock(void)   { s_flash_unlocked = false; return HAL_OK; }
+
+// The erase is over by the time anyone polls for it
+SimFlashStatus::operator uint32_t() {
+  uint32_t& cr = s_flash.CR2;
+  if (cr & FLASH_CR_START) {
+    cr &= ~FLASH_CR_START;
+    if (!s_flash_unlocked || !(cr & FLASH_CR_SER)) {
+      bits |= FLASH_SR_PGSERR;
+    } else {
+      const uint32_t sector = (cr & FLASH_CR_SNB) >> FLASH_CR_SNB_Pos;
+      memset(sim_flash_bank2 + sector * FLASH_SECTOR_SIZE, 0xFF, FLASH_SECTOR_SIZE);
+      bits |= FLASH_SR_EOP;
+    }
+  }
+  return bits;
+}
+
+SimFlashClear& SimFlashClear::operator=(uint32_t v) {
+  s_flash.SR2.bits &= ~v;
+  return *this;
+}
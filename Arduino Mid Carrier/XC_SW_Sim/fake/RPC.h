@@ -0,0 +1,16 @@
+// Host stand-in for the mbed RPC bridge: bindings are accepted and dropped
+#ifndef FAKE_RPC_H
+#define FAKE_RPC_H
+
+#include <string>
+#include <vector>
+
+struct FakeRPC {
+  void begin() {}
+  template <typename F> void bind(const char*, F) {}
+  template <typename... A> void send(const char*, A...) {}
+  template <typename... A> int call(const char*, A...) { return 0; }
+};
+extern FakeRPC RPC;
+
+#endif // FAKE_RPC_H
@@ -0,0 +1,5 @@
+// Host stand-in: SerialRPC is only included, never used, by XC_SW
+#ifndef FAKE_SERIAL_RPC_H
+#define FAKE_SERIAL_RPC_H
+#include "RPC.h"
+#endif // FAKE_SERIAL_RPC_H
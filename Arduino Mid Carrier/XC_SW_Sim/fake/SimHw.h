@@ -0,0 +1,43 @@
+// Harness-side control of the fake hardware. Firmware code never includes
+// this; the sim main loop uses it to move time forward and to play the
+// role of the peripherals' hardware events.
+#ifndef SIM_HW_H
+#define SIM_HW_H
+
+#include "Arduino.h"
+#include "stm32h7xx_hal.h"
+
+// ----- Time -----
+uint64_t sim_now_ns();
+void     sim_advance_ns(uint64_t dt_ns);
+
+// ----- Pins -----
+void sim_set_pin_input(uint8_t pin, int level);   // What digitalRead() returns
+int  sim_pin_output(uint8_t pin);                 // Last digitalWrite()
+void sim_set_analog(uint8_t pin, int raw);        // What analogRead() returns
+
+// ----- Timers -----
+// Level of a timer channel's output pin (1..4) at the current sim time,
+// from PSC/ARR/CCRx, the counter mode, OCxM and CCxP. A disabled channel
+// reads as `idle_level`.
+int  sim_tim_output(const TIM_TypeDef* tim, unsigned channel, int idle_level);
+
+// Counter periods completed at the current sim time; center-aligned, the
+// count steps as the counter passes 0 (where OCxREF with CCRx = 1 rises)
+uint64_t sim_tim_cycles(const TIM_TypeDef* tim);
+
+// Hardware update event: service DMA streams on that timer's UP request
+// (when UDE is set), raise UIF and, if UIE is set, the timer's interrupt.
+void sim_tim_update_event(TIM_TypeDef* tim);
+
+// ----- ADC -----
+// One triggered conversion of every configured rank. `raw_for_channel`
+// is indexed by ADC channel number. Runs the analog watchdogs and, if the
+// ADC has a DMA transfer running, writes the frame into its buffer.
+void sim_adc_convert(ADC_TypeDef* adc, const uint16_t* raw_for_channel, size_t nch);
+
+// ----- Interrupts -----
+void sim_raise_irq(IRQn_Type irq);
+int  sim_irq_priority(IRQn_Type irq);
+
+#endif // SIM_HW_H
@@ -0,0 +1,388 @@
+// Host stand-in for the STM32H7 HAL, just wide enough for XC_SW.
+// Peripheral registers are plain structs in RAM; FakeHal.cpp implements the
+// HAL calls against them and models the timer outputs, DMA requests and ADC
+// analog watchdogs that the sim harness drives (see SimHw.h).
+#ifndef FAKE_STM32H7XX_HAL_H
+#define FAKE_STM32H7XX_HAL_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+typedef enum { HAL_OK = 0, HAL_ERROR, HAL_BUSY, HAL_TIMEOUT } HAL_StatusTypeDef;
+
+#define ENABLE   1U
+#define DISABLE  0U
+
+#ifndef MODIFY_REG
+#define SET_BIT(REG, BIT)                    ((REG) |= (BIT))
+#define CLEAR_BIT(REG, BIT)                  ((REG) &= ~(BIT))
+#define READ_BIT(REG, BIT)                   ((REG) & (BIT))
+#define MODIFY_REG(REG, CLEARMASK, SETMASK)  ((REG) = (((REG) & (~(CLEARMASK))) | (SETMASK)))
+#endif
+
+// ----- Cortex-M core -----
+typedef int IRQn_Type;
+enum {
+  ADC_IRQn      = 18,
+  DMA1_Stream0_IRQn = 11,
+  TIM3_IRQn     = 29,
+  TIM6_DAC_IRQn = 54,
+  TIM7_IRQn     = 55,
+  TIM16_IRQn    = 117,
+  HSEM2_IRQn    = 126,
+  ADC3_IRQn     = 127,
+  SIM_NUM_IRQS  = 160
+};
+
+typedef struct { volatile uint32_t CTRL, CYCCNT, CPICNT, EXCCNT, SLEEPCNT, LSUCNT, FOLDCNT, PCSR; } DWT_Type;
+typedef struct { volatile uint32_t DHCSR, DCRSR, DCRDR, DEMCR; } CoreDebug_Type;
+extern DWT_Type*       DWT;
+extern CoreDebug_Type* CoreDebug;
+#define CoreDebug_DEMCR_TRCENA_Msk  (1UL << 24)
+#define DWT_CTRL_CYCCNTENA_Msk      (1UL << 0)
+
+typedef struct { volatile uint32_t CPUID, ICSR, VTOR, AIRCR, SCR, CCR; } SCB_Type;
+extern SCB_Type* SCB;
+#define SCB_CCR_BFHFNMIGN_Msk       (1UL << 8)
+
+extern uint32_t SystemCoreClock;
+
+void     HAL_NVIC_SetPriority(IRQn_Type irq, uint32_t preempt, uint32_t sub);
+void     HAL_NVIC_EnableIRQ(IRQn_Type irq);
+void     HAL_NVIC_DisableIRQ(IRQn_Type irq);
+uint32_t HAL_GetTick(void);
+uint32_t HAL_RCC_GetPCLK1Freq(void);
+
+// ----- GPIO -----
+typedef struct { volatile uint32_t MODER, OTYPER, OSPEEDR, PUPDR, IDR, ODR, BSRR, LCKR, AFR[2]; } GPIO_TypeDef;
+extern GPIO_TypeDef *GPIOA, *GPIOB, *GPIOC, *GPIOE, *GPIOF;
+
+typedef struct { uint32_t Pin, Mode, Pull, Speed, Alternate; } GPIO_InitTypeDef;
+typedef enum { GPIO_PIN_RESET = 0, GPIO_PIN_SET } GPIO_PinState;
+
+#define GPIO_PIN_0   0x0001U
+#define GPIO_PIN_1   0x0002U
+#define GPIO_PIN_2   0x0004U
+#define GPIO_PIN_6   0x0040U
+#define GPIO_PIN_7   0x0080U
+#define GPIO_PIN_9   0x0200U
+#define GPIO_PIN_10  0x0400U
+#define GPIO_PIN_11  0x0800U
+
+#define GPIO_MODE_INPUT            0x0U
+#define GPIO_MODE_OUTPUT_PP        0x1U
+#define GPIO_MODE_AF_PP            0x2U
+#define GPIO_MODE_ANALOG           0x3U
+#define GPIO_NOPULL                0x0U
+#define GPIO_PULLUP                0x1U
+#define GPIO_PULLDOWN              0x2U
+#define GPIO_SPEED_FREQ_LOW        0x0U
+#define GPIO_SPEED_FREQ_HIGH       0x2U
+#define GPIO_SPEED_FREQ_VERY_HIGH  0x3U
+#define GPIO_AF1_TIM1              0x1U
+#define GPIO_AF1_TIM2              0x1U
+#define GPIO_AF1_TIM16             0x1U
+#define GPIO_AF2_TIM3              0x2U
+
+void          HAL_GPIO_Init(GPIO_TypeDef* port, GPIO_InitTypeDef* init);
+GPIO_PinState HAL_GPIO_ReadPin(GPIO_TypeDef* port, uint16_t pin);
+void          HAL_GPIO_WritePin(GPIO_TypeDef* port, uint16_t pin, GPIO_PinState state);
+
+#define __HAL_RCC_GPIOA_CLK_ENABLE()   ((void)0)
+#define __HAL_RCC_GPIOB_CLK_ENABLE()   ((void)0)
+#define __HAL_RCC_GPIOC_CLK_ENABLE()   ((void)0)
+#define __HAL_RCC_GPIOE_CLK_ENABLE()   ((void)0)
+#define __HAL_RCC_GPIOF_CLK_ENABLE()   ((void)0)
+#define __HAL_RCC_SYSCFG_CLK_ENABLE()  ((void)0)
+
+#define SYSCFG_SWITCH_PA1       0x1U
+#define SYSCFG_SWITCH_PA1_OPEN  0x1U
+#define SYSCFG_SWITCH_PC2       0x4U
+#define SYSCFG_SWITCH_PC2_OPEN  0x4U
+void HAL_SYSCFG_AnalogSwitchConfig(uint32_t switches, uint32_t state);
+
+// ----- Timers -----
+typedef struct {
+  volatile uint32_t CR1, CR2, SMCR, DIER, SR, EGR, CCMR1, CCMR2, CCER, CNT, PSC, ARR,
+                    RCR, CCR1, CCR2, CCR3, CCR4, BDTR, DCR, DMAR, OR;
+} TIM_TypeDef;
+extern TIM_TypeDef *TIM1, *TIM2, *TIM3, *TIM6, *TIM7, *TIM15, *TIM16;
+
+typedef struct { uint32_t Prescaler, CounterMode, Period, ClockDivision, RepetitionCounter, AutoReloadPreload; } TIM_Base_InitTypeDef;
+struct __DMA_HandleTypeDef;
+typedef struct { TIM_TypeDef* Instance; TIM_Base_InitTypeDef Init; struct __DMA_HandleTypeDef* hdma[7]; } TIM_HandleTypeDef;
+typedef struct { uint32_t OCMode, Pulse, OCPolarity, OCNPolarity, OCFastMode, OCIdleState, OCNIdleState; } TIM_OC_InitTypeDef;
+typedef struct { uint32_t MasterOutputTrigger, MasterOutputTrigger2, MasterSlaveMode; } TIM_MasterConfigTypeDef;
+
+#define TIM_CR1_CEN      (1UL << 0)
+#define TIM_CR1_UDIS     (1UL << 1)
+#define TIM_CR1_OPM      (1UL << 3)
+#define TIM_CR1_CMS      (3UL << 5)
+#define TIM_CR1_ARPE     (1UL << 7)
+#define TIM_CR2_MMS      (7UL << 4)
+#define TIM_DIER_UIE     (1UL << 0)
+#define TIM_DIER_UDE     (1UL << 8)
+#define TIM_SR_UIF       (1UL << 0)
+#define TIM_EGR_UG       (1UL << 0)
+#define TIM_CCMR1_OC1M   0x00010070UL
+#define TIM_CCMR1_OC2M   0x01007000UL
+#define TIM_CCMR1_OC2PE  (1UL << 11)
+#define TIM_CCMR1_OC2M_Pos 12U
+#define TIM_CCER_CC1E    (1UL << 0)
+#define TIM_CCER_CC2E    (1UL << 4)
+#define TIM_BDTR_MOE     (1UL << 15)
+
+#define TIM_COUNTERMODE_UP              0x00000000U
+#define TIM_COUNTERMODE_CENTERALIGNED1  0x00000020U
+#define TIM_CLOCKDIVISION_DIV1          0x00000000U
+#define TIM_AUTORELOAD_PRELOAD_DISABLE  0x00000000U
+#define TIM_AUTORELOAD_PRELOAD_ENABLE   TIM_CR1_ARPE
+#define TIM_OCMODE_FORCED_INACTIVE      0x00000040U
+#define TIM_OCMODE_FORCED_ACTIVE        0x00000050U
+#define TIM_OCMODE_PWM1                 0x00000060U
+#define TIM_OCMODE_PWM2                 0x00000070U
+#define TIM_OCPOLARITY_HIGH             0x00000000U
+#define TIM_OCPOLARITY_LOW              0x00000002U
+#define TIM_OCFAST_DISABLE              0x00000000U
+#define TIM_OCIDLESTATE_RESET           0x00000000U
+#define TIM_CHANNEL_1                   0x00000000U
+#define TIM_CHANNEL_2                   0x00000004U
+#define TIM_CHANNEL_3                   0x00000008U
+#define TIM_CHANNEL_4                   0x0000000CU
+#define TIM_TRGO_RESET                  0x00000000U
+#define TIM_TRGO_UPDATE                 0x00000020U
+#define TIM_TRGO_OC2REF                 0x00000050U
+#define TIM_TRGO_OC4REF                 0x00000070U
+#define TIM_TRGO2_RESET                 0x00000000U
+#define TIM_MASTERSLAVEMODE_DISABLE     0x00000000U
+#define TIM_FLAG_UPDATE                 TIM_SR_UIF
+#define TIM_IT_UPDATE                   TIM_DIER_UIE
+#define TIM_DMA_UPDATE                  TIM_DIER_UDE
+#define TIM_OPMODE_SINGLE               TIM_CR1_OPM
+
+#define __HAL_TIM_SET_COMPARE(h, ch, v)   (*(&(h)->Instance->CCR1 + ((ch) >> 2)) = (v))
+#define __HAL_TIM_GET_COMPARE(h, ch)      (*(&(h)->Instance->CCR1 + ((ch) >> 2)))
+#define __HAL_TIM_GET_AUTORELOAD(h)       ((h)->Instance->ARR)
+#define __HAL_TIM_SET_AUTORELOAD(h, v)    ((h)->Instance->ARR = (v))
+#define __HAL_TIM_SET_PRESCALER(h, v)     ((h)->Instance->PSC = (v))
+#define __HAL_TIM_GET_COUNTER(h)          ((h)->Instance->CNT)
+#define __HAL_TIM_SET_COUNTER(h, v)       ((h)->Instance->CNT = (v))
+#define __HAL_TIM_GET_FLAG(h, f)          (((h)->Instance->SR & (f)) == (f))
+#define __HAL_TIM_CLEAR_FLAG(h, f)        ((h)->Instance->SR = ~(uint32_t)(f))
+#define __HAL_TIM_CLEAR_IT(h, f)          ((h)->Instance->SR = ~(uint32_t)(f))
+#define __HAL_TIM_ENABLE_IT(h, f)         ((h)->Instance->DIER |= (f))
+#define __HAL_TIM_DISABLE_IT(h, f)        ((h)->Instance->DIER &= ~(f))
+#define __HAL_TIM_ENABLE_DMA(h, f)        ((h)->Instance->DIER |= (f))
+#define __HAL_TIM_DISABLE_DMA(h, f)       ((h)->Instance->DIER &= ~(f))
+#define __HAL_TIM_ENABLE(h)               ((h)->Instance->CR1 |= TIM_CR1_CEN)
+#define __HAL_TIM_DISABLE(h)              ((h)->Instance->CR1 &= ~TIM_CR1_CEN)
+#define __HAL_TIM_MOE_ENABLE(h)           ((h)->Instance->BDTR |= TIM_BDTR_MOE)
+
+#define __HAL_RCC_TIM1_CLK_ENABLE()   ((void)0)
+#define __HAL_RCC_TIM2_CLK_ENABLE()   ((void)0)
+#define __HAL_RCC_TIM3_CLK_ENABLE()   ((void)0)
+#define __HAL_RCC_TIM6_CLK_ENABLE()   ((void)0)
+#define __HAL_RCC_TIM7_CLK_ENABLE()   ((void)0)
+#define __HAL_RCC_TIM15_CLK_ENABLE()  ((void)0)
+#define __HAL_RCC_TIM16_CLK_ENABLE()  ((void)0)
+
+HAL_StatusTypeDef HAL_TIM_Base_Init(TIM_HandleTypeDef* h);
+HAL_StatusTypeDef HAL_TIM_Base_Start(TIM_HandleTypeDef* h);
+HAL_StatusTypeDef HAL_TIM_Base_Start_IT(TIM_HandleTypeDef* h);
+HAL_StatusTypeDef HAL_TIM_Base_Stop_IT(TIM_HandleTypeDef* h);
+HAL_StatusTypeDef HAL_TIM_PWM_Init(TIM_HandleTypeDef* h);
+HAL_StatusTypeDef HAL_TIM_PWM_ConfigChannel(TIM_HandleTypeDef* h, TIM_OC_InitTypeDef* oc, uint32_t channel);
+HAL_StatusTypeDef HAL_TIM_PWM_Start(TIM_HandleTypeDef* h, uint32_t channel);
+HAL_StatusTypeDef HAL_TIM_PWM_Stop(TIM_HandleTypeDef* h, uint32_t channel);
+HAL_StatusTypeDef HAL_TIM_OnePulse_Init(TIM_HandleTypeDef* h, uint32_t mode);
+HAL_StatusTypeDef HAL_TIMEx_MasterConfigSynchronization(TIM_HandleTypeDef* h, TIM_MasterConfigTypeDef* cfg);
+
+// ----- DMA -----
+typedef struct { volatile uint32_t CR, NDTR, PAR, M0AR, M1AR, FCR; } DMA_Stream_TypeDef;
+extern DMA_Stream_TypeDef *DMA1_Stream0, *DMA1_Stream1, *DMA1_Stream2, *DMA1_Stream3,
+                          *DMA2_Stream0, *DMA2_Stream1, *DMA2_Stream2, *DMA2_Stream3;
+
+typedef struct {
+  uint32_t Request, Direction, PeriphInc, MemInc, PeriphDataAlignment, MemDataAlignment,
+           Mode, Priority, FIFOMode, FIFOThreshold, MemBurst, PeriphBurst;
+} DMA_InitTypeDef;
+typedef struct __DMA_HandleTypeDef { void* Instance; DMA_InitTypeDef Init; void* Parent; } DMA_HandleTypeDef;
+
+#define DMA_REQUEST_ADC1         9U
+#define DMA_REQUEST_ADC2         10U
+#define DMA_REQUEST_TIM3_UP      27U
+#define DMA_REQUEST_TIM7_UP      70U
+#define DMA_REQUEST_ADC3         115U
+#define DMA_PERIPH_TO_MEMORY     0x00000000U
+#define DMA_MEMORY_TO_PERIPH     0x00000040U
+#define DMA_PINC_DISABLE         0x00000000U
+#define DMA_PINC_ENABLE          0x00000200U
+#define DMA_MINC_DISABLE         0x00000000U
+#define DMA_MINC_ENABLE          0x00000400U
+#define DMA_PDATAALIGN_HALFWORD  0x00000800U
+#define DMA_PDATAALIGN_WORD      0x00001000U
+#define DMA_MDATAALIGN_HALFWORD  0x00002000U
+#define DMA_MDATAALIGN_WORD      0x00004000U
+#define DMA_NORMAL               0x00000000U
+#define DMA_CIRCULAR             0x00000100U
+#define DMA_PRIORITY_HIGH        0x00020000U
+#define DMA_PRIORITY_VERY_HIGH   0x00030000U
+#define DMA_FIFOMODE_DISABLE     0x00000000U
+#define DMA_IT_TC                0x00000010U
+#define DMA_IT_HT                0x00000008U
+#define DMA_IT_TE                0x00000004U
+#define DMA_IT_DME               0x00000002U
+
+#define __HAL_DMA_GET_COUNTER(h)      (((DMA_Stream_TypeDef*)(h)->Instance)->NDTR)
+#define __HAL_DMA_DISABLE_IT(h, f)    (((DMA_Stream_TypeDef*)(h)->Instance)->CR &= ~(f))
+#define __HAL_LINKDMA(p, f, d)        do { (p)->f = &(d); (d).Parent = (p); } while (0)
+#define __HAL_RCC_DMA1_CLK_ENABLE()   ((void)0)
+#define __HAL_RCC_DMA2_CLK_ENABLE()   ((void)0)
+
+HAL_StatusTypeDef HAL_DMA_Init(DMA_HandleTypeDef* h);
+HAL_StatusTypeDef HAL_DMA_Start(DMA_HandleTypeDef* h, uint32_t src, uint32_t dst, uint32_t len);
+HAL_StatusTypeDef HAL_DMA_Abort(DMA_HandleTypeDef* h);
+
+// ----- ADC -----
+typedef struct {
+  volatile uint32_t ISR, IER, CR, CFGR, CFGR2, SMPR1, SMPR2, PCSEL, LTR1, HTR1, RES0, RES1,
+                    SQR1, SQR2, SQR3, SQR4, DR, RES2, RES3, JSQR, RES4[4], OFR1, OFR2, OFR3, OFR4,
+                    RES5[4], JDR1, JDR2, JDR3, JDR4, RES6[4], AWD2CR, AWD3CR, RES7, RES8,
+                    LTR2, HTR2, LTR3, HTR3, DIFSEL, CALFACT, CALFACT2;
+} ADC_TypeDef;
+extern ADC_TypeDef *ADC1, *ADC2, *ADC3;
+
+typedef struct { uint32_t Ratio, RightBitShift, TriggeredMode, OversamplingStopReset; } ADC_OversamplingTypeDef;
+typedef struct {
+  uint32_t ClockPrescaler, Resolution, ScanConvMode, EOCSelection, LowPowerAutoWait,
+           ContinuousConvMode, NbrOfConversion, DiscontinuousConvMode, NbrOfDiscConversion,
+           ExternalTrigConv, ExternalTrigConvEdge, ConversionDataManagement, Overrun,
+           LeftBitShift, OversamplingMode;
+  ADC_OversamplingTypeDef Oversampling;
+} ADC_InitTypeDef;
+typedef struct { ADC_TypeDef* Instance; ADC_InitTypeDef Init; DMA_HandleTypeDef* DMA_Handle; } ADC_HandleTypeDef;
+typedef struct { uint32_t Channel, Rank, SamplingTime, SingleDiff, OffsetNumber, Offset, OffsetRightShift, OffsetSignedSaturation; } ADC_ChannelConfTypeDef;
+typedef struct { uint32_t WatchdogNumber, WatchdogMode, Channel, ITMode, HighThreshold, LowThreshold; } ADC_AnalogWDGConfTypeDef;
+
+#define ADC_CLOCK_ASYNC_DIV4               0x00080000U
+#define ADC_RESOLUTION_12B                 0x00000014U
+#define ADC_SCAN_DISABLE                   0x00000000U
+#define ADC_SCAN_ENABLE                    0x00000001U
+#define ADC_EOC_SINGLE_CONV                0x00000004U
+#define ADC_EOC_SEQ_CONV                   0x00000008U
+#define ADC_EXTERNALTRIG_T3_TRGO           0x00000010U
+#define ADC_EXTERNALTRIG_T6_TRGO           0x00000034U
+#define ADC_EXTERNALTRIGCONVEDGE_RISING    0x00000400U
+#define ADC_CONVERSIONDATA_DMA_CIRCULAR    0x00000003U
+#define ADC_OVR_DATA_OVERWRITTEN           0x00001000U
+#define ADC_LEFTBITSHIFT_NONE              0x00000000U
+#define ADC_RIGHTBITSHIFT_NONE             0x00000000U
+#define ADC_RIGHTBITSHIFT_1                0x00200000U
+#define ADC_RIGHTBITSHIFT_2                0x00400000U
+#define ADC_RIGHTBITSHIFT_3                0x00600000U
+#define ADC_RIGHTBITSHIFT_4                0x00800000U
+#define ADC_RIGHTBITSHIFT_5                0x00A00000U
+#define ADC_RIGHTBITSHIFT_6                0x00C00000U
+#define ADC_RIGHTBITSHIFT_7                0x00E00000U
+#define ADC_RIGHTBITSHIFT_8                0x01000000U
+#define ADC_RIGHTBITSHIFT_9                0x01200000U
+#define ADC_RIGHTBITSHIFT_10               0x01400000U
+#define ADC_TRIGGEREDMODE_SINGLE_TRIGGER   0x00000000U
+#define ADC_REGOVERSAMPLING_CONTINUED_MODE 0x00000000U
+#define ADC_CALIB_OFFSET                   0x00000000U
+#define ADC_SINGLE_ENDED                   0x00000000U
+#define ADC_REGULAR_RANK_1                 0x00000006U
+#define ADC_REGULAR_RANK_2                 0x0000000CU
+#define ADC_REGULAR_RANK_3                 0x00000012U
+#define ADC_SAMPLETIME_8CYCLES_5           0x00000002U
+#define ADC_SAMPLETIME_16CYCLES_5          0x00000003U
+#define ADC_OFFSET_NONE                    0x00000000U
+#define ADC_CHANNEL_0                      0x00000000U
+#define ADC_CHANNEL_1                      0x00000001U
+#define ADC_CHANNEL_2                      0x00000002U
+#define ADC_ANALOGWATCHDOG_1               0x00000001U
+#define ADC_ANALOGWATCHDOG_2               0x00000002U
+#define ADC_ANALOGWATCHDOG_3               0x00000003U
+#define ADC_ANALOGWATCHDOG_SINGLE_REG      0x00000001U
+#define ADC_FLAG_EOS                       0x00000008U
+#define ADC_FLAG_OVR                       0x00000010U
+#define ADC_FLAG_AWD1                      0x00000080U
+#define ADC_FLAG_AWD2                      0x00000100U
+#define ADC_FLAG_AWD3                      0x00000200U
+#define ADC_IT_OVR                         ADC_FLAG_OVR
+#define ADC_IT_AWD1                        ADC_FLAG_AWD1
+#define ADC_IT_AWD2                        ADC_FLAG_AWD2
+#define ADC_IT_AWD3                        ADC_FLAG_AWD3
+
+#define __HAL_ADC_ENABLE_IT(h, f)       ((h)->Instance->IER |= (f))
+#define __HAL_ADC_DISABLE_IT(h, f)      ((h)->Instance->IER &= ~(f))
+#define __HAL_ADC_GET_IT_SOURCE(h, f)   (((h)->Instance->IER & (f)) == (f))
+#define __HAL_ADC_GET_FLAG(h, f)        (((h)->Instance->ISR & (f)) == (f))
+#define __HAL_ADC_CLEAR_FLAG(h, f)      ((h)->Instance->ISR &= ~(uint32_t)(f))   // ISR bits are rc_w1
+#define __HAL_RCC_ADC12_CLK_ENABLE()    ((void)0)
+#define __HAL_RCC_ADC3_CLK_ENABLE()     ((void)0)
+
+HAL_StatusTypeDef HAL_ADC_Init(ADC_HandleTypeDef* h);
+HAL_StatusTypeDef HAL_ADCEx_Calibration_Start(ADC_HandleTypeDef* h, uint32_t mode, uint32_t single_diff);
+HAL_StatusTypeDef HAL_ADC_ConfigChannel(ADC_HandleTypeDef* h, ADC_ChannelConfTypeDef* cfg);
+HAL_StatusTypeDef HAL_ADC_Start_DMA(ADC_HandleTypeDef* h, uint32_t* buf, uint32_t len);
+HAL_StatusTypeDef HAL_ADC_Stop_DMA(ADC_HandleTypeDef* h);
+HAL_StatusTypeDef HAL_ADC_AnalogWDGConfig(ADC_HandleTypeDef* h, ADC_AnalogWDGConfTypeDef* cfg);
+
+// ----- Flash -----
+// Bank 2 only (where XC_SW keeps its parameter store), as RAM reading back
+// 0xFF when erased. Stores to it land as they are; a sector erase set up in
+// CR2 runs when SR2 is next read.
+extern uint8_t sim_flash_bank2[];
+
+#define FLASH_BANK2_BASE                 ((uint32_t)(uintptr_t)sim_flash_bank2)
+#define FLASH_SECTOR_SIZE                0x00020000UL
+#define FLASH_SECTOR_TOTAL               8U
+#define FLASH_NB_32BITWORD_IN_FLASHWORD  8U
+#define FLASH_BANK_2                     0x02U
+#define FLASH_SECTOR_7                   7U
+#define FLASH_VOLTAGE_RANGE_3            0x20U
+
+#define FLASH_CR_PG          (1UL << 1)
+#define FLASH_CR_SER         (1UL << 2)
+#define FLASH_CR_PSIZE       (3UL << 4)
+#define FLASH_CR_START       (1UL << 7)
+#define FLASH_CR_SNB_Pos     8U
+#define FLASH_CR_SNB         (7UL << FLASH_CR_SNB_Pos)
+#define FLASH_SR_BSY         (1UL << 0)
+#define FLASH_SR_QW          (1UL << 2)
+#define FLASH_SR_EOP         (1UL << 16)
+#define FLASH_SR_WRPERR      (1UL << 17)
+#define FLASH_SR_PGSERR      (1UL << 18)
+#define FLASH_SR_STRBERR     (1UL << 19)
+#define FLASH_SR_INCERR      (1UL << 21)
+#define FLASH_SR_OPERR       (1UL << 22)
+#define FLASH_SR_SNECCERR    (1UL << 25)
+#define FLASH_SR_DBECCERR    (1UL << 26)
+#define FLASH_CCR_CLR_EOP       FLASH_SR_EOP
+#define FLASH_CCR_CLR_WRPERR    FLASH_SR_WRPERR
+#define FLASH_CCR_CLR_PGSERR    FLASH_SR_PGSERR
+#define FLASH_CCR_CLR_STRBERR   FLASH_SR_STRBERR
+#define FLASH_CCR_CLR_INCERR    FLASH_SR_INCERR
+#define FLASH_CCR_CLR_OPERR     FLASH_SR_OPERR
+#define FLASH_CCR_CLR_SNECCERR  FLASH_SR_SNECCERR
+#define FLASH_CCR_CLR_DBECCERR  FLASH_SR_DBECCERR
+
+struct SimFlashStatus {
+  uint32_t bits;
+  operator uint32_t();   // Runs a started erase first
+};
+struct SimFlashClear {
+  SimFlashClear& operator=(uint32_t v);   // Clears those SR2 bits
+};
+typedef struct {
+  uint32_t       CR2;
+  SimFlashStatus SR2;
+  SimFlashClear  CCR2;
+} FLASH_TypeDef;
+extern FLASH_TypeDef* FLASH;
+
+HAL_StatusTypeDef HAL_FLASH_Unlock(void);
+HAL_StatusTypeDef HAL_FLASH_Lock(void);
+
+#endif // FAKE_STM32H7XX_HAL_H
@@ -84,6 +84,11 @@ SIGNAL_MAP = {
 SIGNAL_ID_TO_NAME = {v: k for k, v in SIGNAL_MAP.items()}
 LATEST_VALUES = {device_id: {} for device_id in DEVICES}
 
+# Latest complete on-device scope capture per device, assembled from the
+# bridge's "scope_data" pages (SCOPE_PAGE_SAMPLES records each)
+SCOPE_CAPTURES = {}
+SCOPE_PENDING = {}
+
 
 # --- NEW: Updated Packet Signature Functions ---
 
@@ -123,6 +128,26 @@ def decode_json_packet(packet: bytes):
 
 
 
+def collect_scope_page(device_id: str, msg: dict) -> Optional[dict]:
+    """Add one "scope_data" page; returns the capture once all pages are in."""
+    pending = SCOPE_PENDING.get(device_id)
+    if not pending or pending["capture"] != msg.get("capture"):
+        pending = {"capture": msg.get("capture"), "pages": {}}
+        SCOPE_PENDING[device_id] = pending
+    pending["pages"][msg.get("page")] = msg
+
+    total = msg.get("total_pages", 0)
+    if len(pending["pages"]) < total:
+        return None
+    del SCOPE_PENDING[device_id]
+
+    capture = {key: msg.get(key) for key in ("capture", "trigger", "samples", "pre", "dt_ms")}
+    capture["received"] = time.time()
+    for key in ("curr_act", "curr_set", "volt_act"):
+        capture[key] = [v for i in range(total) for v in pending["pages"][i].get(key, [])]
+    return capture
+
+
 # --- UDP Listener and API Endpoints ---
 
 # This thread listens for UDP broadcast updates on the fixed local port
@@ -195,6 +220,21 @@ def udp_listener_thread():
                     msg = json.loads(data.decode())
                     if msg.get("type") == "log":
                         socketio.emit("log_entry", msg)
+                    elif msg.get("type") == "scope_data":
+                        capture = collect_scope_page(device_id, msg)
+                        if capture:
+                            SCOPE_CAPTURES[device_id] = capture
+                            print(f"[UDP] Scope capture {capture['capture']} from {device_id} "
+                                  f"({capture['samples']} samples)")
+                            socketio.emit(
+                                "scope_capture",
+                                {
+                                    "device": device_id,
+                                    "device_label": device_label(device_id),
+                                    "capture": capture["capture"],
+                                    "trigger": capture["trigger"],
+                                },
+                            )
                 except Exception:
                     pass
 
@@ -396,6 +436,24 @@ def waveform_page():
     return render_template("waveform.html", devices=DEVICES)
 
 
+@app.route("/scope")
+def scope_page():
+    """Latest on-device scope capture: measured vs commanded current."""
+    return render_template("scope.html", devices=DEVICES)
+
+
+@app.route("/api/scope", methods=["GET"])
+def api_scope():
+    """Latest complete scope capture received from a device."""
+    device_id = request.args.get("device")
+    if device_id not in DEVICES:
+        return jsonify({"error": "unknown device"}), 400
+    capture = SCOPE_CAPTURES.get(device_id)
+    if not capture:
+        return jsonify({"error": "no capture received"}), 404
+    return jsonify(capture)
+
+
 
 
 